@@ -0,0 +1,116 @@
+// Copyright 2023 Markus Anders
+// This file is part of dejavu 2.0.
+// See LICENSE for extended copyright information.
+
+// Microbenchmark for backtracking in the IR tree (see ir::controller::move_to_parent), using the loop of the paired
+// depth-first search (see dfs_ir::do_paired_dfs): starting from the leaf of the base, the search backtracks one level
+// at a time, and on each level individualizes vertices of the color of the base vertex (at most 32), and reverts again.
+// Graphs are disjoint unions of small graphs, which have long bases, and where each individualization only refines a
+// small part of the coloring.
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "../dejavu.h"
+
+using dejavu::ir::refinement;
+using dejavu::ds::coloring;
+typedef std::chrono::high_resolution_clock Clock;
+
+// disjoint union of copies of a graph on k vertices, given by its edges
+static void union_graph(dejavu::static_graph& g, int copies, int k, const std::vector<std::pair<int, int>>& edges,
+                        int degree) {
+    g.initialize_graph(copies * k, copies * static_cast<int>(edges.size()));
+    for(int v = 0; v < copies * k; ++v) g.add_vertex(0, degree);
+    for(int i = 0; i < copies; ++i) {
+        for(const auto& [v, w] : edges) g.add_edge(i * k + std::min(v, w), i * k + std::max(v, w));
+    }
+}
+
+static std::vector<std::pair<int, int>> cycle_edges(int k) {
+    std::vector<std::pair<int, int>> edges;
+    for(int v = 0; v < k; ++v) edges.emplace_back(v, (v + 1) % k);
+    return edges;
+}
+
+static std::vector<std::pair<int, int>> hypercube_edges(int d) {
+    std::vector<std::pair<int, int>> edges;
+    for(int v = 0; v < (1 << d); ++v) {
+        for(int i = 0; i < d; ++i) if(v < (v ^ (1 << i))) edges.emplace_back(v, v ^ (1 << i));
+    }
+    return edges;
+}
+
+static void benchmark(const char* name, dejavu::static_graph& g1) {
+    dejavu::sgraph* g = g1.get_sgraph();
+    refinement R;
+    coloring c;
+    g->initialize_coloring(&c, g1.get_coloring());
+    dejavu::ir::controller state(&R, &c);
+    state.reserve();
+
+    // record the base
+    state.mode_write_base();
+    std::vector<int> base;
+    while(c.cells != g->v_size) {
+        base.push_back(c.lab[c.cells - 1]);
+        state.move_to_child(g, base.back());
+    }
+    state.compare_to_this();
+    state.use_trace_early_out(true);
+
+    double total = 0, backtrack = 0;
+    long children = 0, backtracks = 0;
+    for(int rep = 0; rep < 5; ++rep) {
+        double rep_backtrack = 0;
+        const auto start = Clock::now();
+        for(int level = static_cast<int>(base.size()) - 1; level >= 0; --level) {
+            auto t = Clock::now();
+            state.move_to_parent();
+            rep_backtrack += std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+            if(rep == 0) ++backtracks;
+
+            const int col    = c.vertex_to_col[base[level]];
+            const int col_sz = c.ptn[col] + 1;
+            for(int i = 0; i < std::min(col_sz, 32); ++i) {
+                const int v = state.leaf_color.lab[col + i];
+                if(v == base[level]) continue;
+                state.T->reset_trace_equal();
+                state.move_to_child(g, v);
+                t = Clock::now();
+                state.move_to_parent();
+                rep_backtrack += std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+                if(rep == 0) ++children;
+                if(rep == 0) ++backtracks;
+            }
+        }
+        const double rep_total = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if(rep == 0 || rep_total < total) {
+            total     = rep_total;
+            backtrack = rep_backtrack;
+        }
+
+        // walk down the base again
+        for(const int v : base) state.move_to_child(g, v);
+    }
+
+    std::cout << std::left << std::setw(16) << name << std::right << std::setw(8) << g->v_size << " vertices"
+              << std::setw(6) << base.size() << " levels" << std::setw(8) << children << " children"
+              << std::fixed << std::setprecision(3) << std::setw(10) << total << "ms total"
+              << std::setw(10) << backtrack << "ms backtracking (" << std::setprecision(1)
+              << 1e6 * backtrack / static_cast<double>(backtracks) << "ns each)" << std::endl;
+}
+
+int main() {
+    struct instance { const char* name; int copies; int k; std::vector<std::pair<int, int>> edges; int degree; };
+    const instance instances[] = {{"4096 x C8",  4096, 8,   cycle_edges(8),      2},
+                                  {"256 x C128", 256,  128, cycle_edges(128),    2},
+                                  {"2048 x Q4",  2048, 16,  hypercube_edges(4),  4},
+                                  {"128 x Q8",   128,  256, hypercube_edges(8),  8}};
+    for(const auto& inst : instances) {
+        dejavu::static_graph g;
+        union_graph(g, inst.copies, inst.k, inst.edges, inst.degree);
+        benchmark(inst.name, g);
+    }
+    return 0;
+}
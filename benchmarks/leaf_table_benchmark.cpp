@@ -0,0 +1,119 @@
+// Copyright 2023 Markus Anders
+// This file is part of dejavu 2.0.
+// See LICENSE for extended copyright information.
+
+// Microbenchmark for the hash table of stored leaves (see ds::hash_table and ir::shared_leaves), compared to the
+// std::unordered_multimap which was used before. Keys are random 64-bit hashes. Lookups of missing keys probe
+// consecutive keys h, h+1, ..., as done when resolving collisions of leaf hashes (see
+// random_ir::add_leaf_to_storage_and_group).
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include "../dejavu.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+template<class F>
+static double time_ms(F&& f) {
+    double best = 1e100;
+    for(int rep = 0; rep < 5; ++rep) {
+        const auto start = Clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+static void print_row(const char* name, double t_map, double t_table) {
+    std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << t_map << "ms" << std::setw(10) << t_table << "ms (x" << std::setprecision(2)
+              << t_map / t_table << ")" << std::endl;
+}
+
+static void benchmark(const int n, std::mt19937_64& rng) {
+    std::vector<uint64_t> keys(n), missing(n);
+    for(auto& k : keys)    k = rng();
+    for(auto& k : missing) k = rng();
+    std::vector<uint64_t> lookup_order = keys;
+    std::shuffle(lookup_order.begin(), lookup_order.end(), rng);
+    int value = 0;
+    volatile long sink = 0;
+
+    std::cout << n << " leaves" << std::setw(30) << "multimap" << std::setw(12) << "table" << std::endl;
+
+    const double insert_map = time_ms([&]() {
+        std::unordered_multimap<unsigned long, int*> map;
+        map.reserve(20);
+        for(const auto k : keys) if(!map.contains(k)) map.insert({k, &value});
+        sink = sink + static_cast<long>(map.size());
+    });
+    const double insert_table = time_ms([&]() {
+        dejavu::ds::hash_table<int> table;
+        for(const auto k : keys) table.insert(k, &value);
+        sink = sink + table.size();
+    });
+    print_row("insert", insert_map, insert_table);
+
+    std::unordered_multimap<unsigned long, int*> map;
+    map.reserve(20);
+    dejavu::ds::hash_table<int> table;
+    for(const auto k : keys) {
+        map.insert({k, &value});
+        table.insert(k, &value);
+    }
+
+    const double hit_map = time_ms([&]() {
+        long found = 0;
+        for(const auto k : lookup_order) found += map.find(k) != map.end();
+        sink = sink + found;
+    });
+    const double hit_table = time_ms([&]() {
+        long found = 0;
+        for(const auto k : lookup_order) found += table.find(k) != nullptr;
+        sink = sink + found;
+    });
+    print_row("lookup (hit)", hit_map, hit_table);
+
+    const double miss_map = time_ms([&]() {
+        long found = 0;
+        for(const auto k : missing) {
+            for(int offset = 0; offset < 3; ++offset) found += map.find(k + offset) != map.end();
+        }
+        sink = sink + found;
+    });
+    const double miss_table = time_ms([&]() {
+        long found = 0;
+        for(const auto k : missing) {
+            for(int offset = 0; offset < 3; ++offset) found += table.find(k + offset) != nullptr;
+        }
+        sink = sink + found;
+    });
+    print_row("lookup (miss, 3 probes)", miss_map, miss_table);
+
+    // concurrent lookups, only possible using the table
+    const int threads = std::max(2, std::min(8, static_cast<int>(std::thread::hardware_concurrency())));
+    const double hit_table_mt = time_ms([&]() {
+        std::vector<std::thread> workers;
+        for(int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                long found = 0;
+                for(int i = t; i < n; i += threads) found += table.find(lookup_order[i]) != nullptr;
+                sink = sink + found;
+            });
+        }
+        for(auto& w : workers) w.join();
+    });
+    std::cout << "    " << std::left << std::setw(24) << ("lookup (hit), " + std::to_string(threads) + " threads")
+              << std::right << std::setw(22) << hit_table_mt << "ms" << std::endl;
+    std::cout << "    memory of table: " << table.memory() / 1024 << " KiB" << std::endl;
+}
+
+int main() {
+    std::mt19937_64 rng(1);
+    for(const int n : {1000, 100000, 1000000}) benchmark(n, rng);
+    return 0;
+}
@@ -0,0 +1,337 @@
+// Copyright 2023 Markus Anders
+// This file is part of dejavu 2.0.
+// See LICENSE for extended copyright information.
+
+// Microbenchmark for the vectorized kernels of color refinement (see simd.h), as well as refinement and certification
+// using bit matrices, on dense regular graphs. Also compares the sorting algorithms used in color refinement on
+// sparse graphs (see worklist_t::sort).
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <set>
+#include <algorithm>
+#include "../dejavu.h"
+
+dejavu::ir::refinement test_r;
+dejavu::sgraph dej_test_graph;
+
+using dejavu::simd::instruction_set;
+typedef std::chrono::high_resolution_clock Clock;
+
+static const char* instruction_set_name(instruction_set set) {
+    switch(set) {
+        case dejavu::simd::is_avx512: return "avx512";
+        case dejavu::simd::is_avx2:   return "avx2";
+        default:                      return "scalar";
+    }
+}
+
+// circulant graph with a random connection set of size deg
+static void circulant_graph(dejavu::static_graph& g, int n, int deg, std::mt19937& rng) {
+    std::set<int> connection;
+    while(static_cast<int>(connection.size()) < deg) {
+        const int d = 1 + static_cast<int>(rng() % (n - 1));
+        connection.insert(d);
+        connection.insert(n - d);
+    }
+    deg = static_cast<int>(connection.size());
+    g.initialize_graph(n, n * deg / 2);
+    for(int v = 0; v < n; ++v) g.add_vertex(0, deg);
+    for(int v = 0; v < n; ++v) {
+        for(const int d : connection) if(v < (v + d) % n) g.add_edge(v, (v + d) % n);
+    }
+}
+
+template<class F>
+static double time_ms(F&& f) {
+    double best = 1e100;
+    for(int rep = 0; rep < 5; ++rep) {
+        const auto start = Clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+    return best;
+}
+
+// scalar neighbour counting, as in dense-dense refinement
+static void count_scalar(const int* e, int len, int* counts) {
+    for(int i = 0; i < len; ++i) ++counts[e[i]];
+}
+
+#ifdef DEJAVU_SIMD_X86
+// neighbour counting using gather/scatter, with conflict detection for repeated indices
+__attribute__((target("avx512f,avx512cd")))
+static void count_avx512(const int* e, int len, int* counts) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one  = _mm512_set1_epi32(1);
+    int i = 0;
+    for(; i + 16 <= len; i += 16) {
+        const __m512i idx = _mm512_loadu_si512(e + i);
+        const __m512i conflicts = _mm512_conflict_epi32(idx);
+        if(_mm512_test_epi32_mask(conflicts, conflicts)) {
+            count_scalar(e + i, 16, counts);
+            continue;
+        }
+        const __m512i val = _mm512_mask_i32gather_epi32(zero, 0xFFFF, idx, counts, 4);
+        _mm512_i32scatter_epi32(counts, idx, _mm512_add_epi32(val, one), 4);
+    }
+    count_scalar(e + i, len - i, counts);
+}
+#endif
+
+static void benchmark(const std::string& name, dejavu::static_graph& graph) {
+    dejavu::sgraph* g = graph.get_sgraph();
+    g->dense = !(g->e_size < g->v_size || g->e_size / g->v_size < g->v_size / (g->e_size / g->v_size));
+    const int n = g->v_size;
+    const int test_vertices = std::min(n, 4);
+
+    std::vector<instruction_set> sets = {dejavu::simd::is_scalar};
+    const instruction_set supported = dejavu::simd::detect_instruction_set();
+    if(supported >= dejavu::simd::is_avx2)   sets.push_back(dejavu::simd::is_avx2);
+    if(supported >= dejavu::simd::is_avx512) sets.push_back(dejavu::simd::is_avx512);
+
+    dejavu::ir::refinement R;
+    dejavu::coloring root, c;
+    g->initialize_coloring(&root, graph.get_coloring());
+    R.refine_coloring_first(g, &root);
+
+    // coloring after individualizing a vertex, which contains singletons as well as larger cells
+    c.copy_any(&root);
+    dejavu::ir::refinement::individualize_vertex(&c, 0);
+    R.refine_coloring(g, &c, c.vertex_to_col[0]);
+
+    std::cout << name << " (n=" << n << ", m=" << g->e_size / 2 << ", cells after individualization="
+              << c.cells << ")" << std::endl;
+
+    std::vector<int> out(n);
+    double scalar_kernel = 0, scalar_refine = 0;
+    int scalar_cells = -1;
+    for(const auto set : sets) {
+        const auto collect = dejavu::simd::collect_non_singleton(set);
+        long hits = 0;
+        const double kernel = time_ms([&]() {
+            for(int v = 0; v < n; ++v) hits += collect(g->e + g->v[v], g->d[v], c.vertex_to_col, c.ptn, out.data());
+        });
+
+        R.h_instruction_set = set;
+        int cells = 0;
+        const double refine = time_ms([&]() {
+            cells = 0;
+            for(int v = 0; v < test_vertices; ++v) {
+                dejavu::coloring work;
+                work.copy_any(&root);
+                dejavu::ir::refinement::individualize_vertex(&work, v);
+                R.refine_coloring(g, &work, work.vertex_to_col[v]);
+                cells += work.cells;
+            }
+        });
+
+        if(set == dejavu::simd::is_scalar) {
+            scalar_kernel = kernel;
+            scalar_refine = refine;
+            scalar_cells  = cells;
+        }
+        std::cout << "  " << std::setw(8) << instruction_set_name(set) << " collect " << std::setw(8)
+                  << std::fixed << std::setprecision(3) << kernel << "ms (x" << std::setprecision(2)
+                  << scalar_kernel / kernel << ")   refine " << std::setprecision(3) << std::setw(8) << refine
+                  << "ms (x" << std::setprecision(2) << scalar_refine / refine << ")"
+                  << (cells == scalar_cells ? "" : "   MISMATCH") << std::endl;
+    }
+
+    // refinement and certification using the bit matrix of the graph (the rotation v -> v + 1 is an automorphism
+    // of circulant graphs)
+    std::vector<int> rotation(n);
+    for(int v = 0; v < n; ++v) rotation[v] = (v + 1) % n;
+    R.h_instruction_set = dejavu::simd::is_scalar;
+    bool certified = false;
+    const double certify = time_ms([&]() { certified = R.certify_automorphism(g, rotation.data()); });
+    if(R.build_bit_matrix(g)) {
+        int cells = 0;
+        const double refine = time_ms([&]() {
+            cells = 0;
+            for(int v = 0; v < test_vertices; ++v) {
+                dejavu::coloring work;
+                work.copy_any(&root);
+                dejavu::ir::refinement::individualize_vertex(&work, v);
+                R.refine_coloring(g, &work, work.vertex_to_col[v]);
+                cells += work.cells;
+            }
+        });
+        bool certified_bit_matrix = false;
+        const double certify_bit_matrix = time_ms([&]() {
+            certified_bit_matrix = R.certify_automorphism(g, rotation.data());
+        });
+        R.clear_bit_matrix();
+        std::cout << "  " << std::setw(8) << "bits" << " refine  " << std::setw(8) << std::setprecision(3) << refine
+                  << "ms (x" << std::setprecision(2) << scalar_refine / refine << ")   certify "
+                  << std::setprecision(3) << certify_bit_matrix << "ms (x" << std::setprecision(2)
+                  << certify / certify_bit_matrix << ")"
+                  << (cells == scalar_cells && certified == certified_bit_matrix ? "" : "   MISMATCH") << std::endl;
+    }
+
+    std::vector<int> counts(n, 0);
+    const double count = time_ms([&]() { for(int v = 0; v < n; ++v) count_scalar(g->e + g->v[v], g->d[v], counts.data()); });
+    std::cout << "  " << std::setw(8) << "scalar" << " count   " << std::setw(8) << std::setprecision(3) << count
+              << "ms" << std::endl;
+#ifdef DEJAVU_SIMD_X86
+    if(supported >= dejavu::simd::is_avx512) {
+        const double count512 = time_ms([&]() {
+            for(int v = 0; v < n; ++v) count_avx512(g->e + g->v[v], g->d[v], counts.data());
+        });
+        std::cout << "  " << std::setw(8) << "avx512" << " count   " << std::setw(8) << count512 << "ms (x"
+                  << std::setprecision(2) << count / count512 << ")" << std::endl;
+    }
+#endif
+}
+
+// random regular graph of even order, as the union of a cycle and deg - 2 random perfect matchings
+static void random_regular_graph(dejavu::static_graph& g, int n, int deg, std::mt19937& rng) {
+    std::set<std::pair<int, int>> edges;
+    for(int v = 0; v < n; ++v) edges.emplace(std::min(v, (v + 1) % n), std::max(v, (v + 1) % n));
+    std::vector<int> perm(n);
+    for(int v = 0; v < n; ++v) perm[v] = v;
+    for(int matching = 0; matching < deg - 2;) {
+        std::shuffle(perm.begin(), perm.end(), rng);
+        std::vector<std::pair<int, int>> pairs;
+        for(int i = 0; i < n; i += 2) {
+            // swap in another vertex until the pair is a new edge
+            for(int attempt = 0; attempt < 64 && i + 2 < n; ++attempt) {
+                if(!edges.count({std::min(perm[i], perm[i + 1]), std::max(perm[i], perm[i + 1])})) break;
+                std::swap(perm[i + 1], perm[i + 2 + static_cast<int>(rng() % (n - i - 2))]);
+            }
+            const auto edge = std::make_pair(std::min(perm[i], perm[i + 1]), std::max(perm[i], perm[i + 1]));
+            if(edges.count(edge)) break;
+            pairs.push_back(edge);
+        }
+        if(static_cast<int>(pairs.size()) != n / 2) continue;
+        edges.insert(pairs.begin(), pairs.end());
+        ++matching;
+    }
+    g.initialize_graph(n, static_cast<int>(edges.size()));
+    for(int v = 0; v < n; ++v) g.add_vertex(0, deg);
+    for(auto& [v1, v2] : edges) g.add_edge(v1, v2);
+}
+
+// sorting distinct keys in [0, n), as done for colors and neighbour counts in color refinement
+static void benchmark_sort() {
+    std::mt19937 rng(1);
+    const int n = 1000000;
+    std::vector<int> keys(n);
+    for(int i = 0; i < n; ++i) keys[i] = i;
+    std::cout << "sorting distinct keys < " << n << std::endl;
+    for(const int sz : {16, 64, 128, 192, 256, 1024, 16384}) {
+        const int reps = std::max(1, 1000000 / sz);
+        std::vector<std::vector<int>> in(16);
+        for(auto& arr : in) {
+            std::shuffle(keys.begin(), keys.end(), rng);
+            arr.assign(keys.begin(), keys.begin() + sz);
+        }
+        dejavu::ds::worklist arr(sz);
+        const auto sort = [&](const int radix_min) {
+            for(int rep = 0; rep < reps; ++rep) {
+                arr.reset();
+                for(const int k : in[rep % 16]) arr.push_back(k);
+                arr.sort(n, radix_min);
+            }
+        };
+        const double comparison = time_ms([&]() { sort(INT32_MAX); }) * 1e6 / reps;
+        const double radix      = time_ms([&]() { sort(0); }) * 1e6 / reps;
+        std::cout << "  " << std::setw(6) << sz << " elements   std::sort " << std::setw(9) << std::fixed
+                  << std::setprecision(0) << comparison << "ns   radix " << std::setw(9) << radix << "ns (x"
+                  << std::setprecision(2) << comparison / radix << ")" << std::endl;
+    }
+}
+
+// two hubs, joined through k pairs of vertices of distinct colors: the hubs split k color classes at once
+static void hub_graph(dejavu::static_graph& g, int k) {
+    g.initialize_graph(2 * k + 2, 3 * k);
+    g.add_vertex(0, k);
+    g.add_vertex(0, k);
+    for(int i = 0; i < k; ++i) {
+        g.add_vertex(i + 1, 2);
+        g.add_vertex(i + 1, 2);
+    }
+    for(int i = 0; i < k; ++i) {
+        g.add_edge(0, 2 + 2 * i);
+        g.add_edge(1, 3 + 2 * i);
+        g.add_edge(2 + 2 * i, 3 + 2 * i);
+    }
+}
+
+// color refinement of sparse graphs with and without radix sort, after individualizing a vertex (mostly singleton
+// refinement), as well as starting with all color classes of the initial coloring (mostly sparse refinement)
+static void benchmark_sparse(const std::string& name, dejavu::static_graph& graph) {
+    dejavu::sgraph* g = graph.get_sgraph();
+    const int n = g->v_size;
+
+    dejavu::ir::refinement R;
+    dejavu::coloring root;
+    g->initialize_coloring(&root, graph.get_coloring());
+    R.refine_coloring_first(g, &root);
+    std::cout << name << " (n=" << n << ", m=" << g->e_size / 2 << ")" << std::endl;
+
+    const int radix_min = R.h_radix_sort_min;
+    for(const bool individualize : {true, false}) {
+        double comparison_refine = 0;
+        int comparison_cells = -1;
+        for(const bool radix : {false, true}) {
+            R.h_radix_sort_min = radix ? radix_min : INT32_MAX;
+            int cells = 0;
+            const double refine = time_ms([&]() {
+                dejavu::coloring work;
+                work.copy_any(&root);
+                if(individualize) {
+                    const int col = dejavu::ir::refinement::individualize_vertex(&work, 0);
+                    R.refine_coloring(g, &work, col);
+                } else {
+                    R.refine_coloring(g, &work);
+                }
+                cells = work.cells;
+            });
+            if(!radix) {
+                comparison_refine = refine;
+                comparison_cells  = cells;
+            }
+            std::cout << "  " << std::setw(13) << (individualize ? "individualize" : "all classes") << " "
+                      << std::setw(9) << (radix ? "radix" : "std::sort") << " refine " << std::setw(9) << std::fixed
+                      << std::setprecision(3) << refine << "ms (x" << std::setprecision(2) << comparison_refine / refine
+                      << ")" << (cells == comparison_cells ? "" : "   MISMATCH") << std::endl;
+        }
+    }
+}
+
+int main() {
+    std::mt19937 rng(1);
+
+    benchmark_sort();
+
+    // sparse graphs: on random regular graphs, refinement only sorts a handful of elements at a time, while on hub
+    // graphs, refinement sorts many color classes at once
+    for(const int n : {100000, 1000000}) {
+        dejavu::static_graph g;
+        random_regular_graph(g, n, 3, rng);
+        benchmark_sparse("random 3-regular", g);
+    }
+    for(const int k : {1000, 100000}) {
+        dejavu::static_graph g;
+        hub_graph(g, k);
+        benchmark_sparse("hubs", g);
+    }
+
+    // dense graphs, where color refinement uses dense-sparse and dense-dense refinement
+    for(const int n : {2001, 8001}) {
+        dejavu::static_graph g;
+        circulant_graph(g, n, 3 * static_cast<int>(sqrt(n)), rng);
+        benchmark("circulant, degree ~3 sqrt(n)", g);
+    }
+
+    // very dense graphs, where color refinement only uses dense-dense refinement
+    for(const int n : {1001, 4001}) {
+        dejavu::static_graph g;
+        circulant_graph(g, n, n / 2, rng);
+        benchmark("circulant, degree ~n/2", g);
+    }
+    return 0;
+}
@@ -20,6 +20,15 @@ namespace dejavu {
 
         public:
             bool h_use_deviation_pruning = true; /**< use pruning using deviation maps */
+            int  h_checkpoint_stride     = 1;    /**< only nodes on every `h_checkpoint_stride`-th level (and nodes on
+                                                   *  the base) keep their coloring, all other nodes are base-only
+                                                   *  (unless they are stored as a delta) */
+            bool   h_use_delta           = true; /**< nodes are stored as a delta to their parent whenever the delta
+                                                   *  is small, see \a h_delta_max_ratio */
+            double h_delta_max_ratio     = 0.5;  /**< deltas are used if they cover at most this fraction of vertices */
+            bool   h_spill               = false; /**< nodes keep their coloring in a memory-mapped file (see
+                                                    *  \a ir::shared_tree::create_spilled_coloring), except for nodes
+                                                    *  on the base */
 
             // TODO some of this should go into shared_tree
             // statistics
@@ -28,11 +37,28 @@ namespace dejavu {
             int s_total_automorphism_prune = 0; /**< how many nodes were pruned using automorphism pruning */
             int s_total_leaves             = 0; /**< how many of the computed nodes were leaves */
             int s_deviation_prune          = 0; /**< how many nodes were pruned using deviation maps */
+            long s_delta_nodes             = 0; /**< how many nodes were stored as a delta */
+            long s_delta_size              = 0; /**< total size of these deltas, in number of vertices */
+            long s_delta_rejected          = 0; /**< how many nodes were not stored as a delta, since it was too large */
+            long s_spilled_nodes           = 0; /**< how many nodes keep their coloring in a memory-mapped file */
 
             bfs_ir(timed_print& printer, groups::automorphism_workspace& automorphism,
                    groups::schreier_workspace& schreier) :
                    gl_printer(printer), gl_automorphism(automorphism), gl_schreier(schreier) {}
 
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(s_total_prune);
+                ar.value(s_total_kept);
+                ar.value(s_total_automorphism_prune);
+                ar.value(s_total_leaves);
+                ar.value(s_deviation_prune);
+                ar.value(s_delta_nodes);
+                ar.value(s_delta_size);
+                ar.value(s_delta_rejected);
+                ar.value(s_spilled_nodes);
+            }
+
             void do_a_level(sgraph* g, dejavu_hook* hook, ir::shared_tree& ir_tree, ir::controller& local_state,
                             std::function<ir::type_selector_hook> *selector) {
                 int current_level = ir_tree.get_finished_up_to();
@@ -45,15 +71,16 @@ namespace dejavu {
 
                 assert(ir_tree.get_current_level_size() > 0);
 
-                queue_up_level(selector, ir_tree, current_level);
+                queue_up_level(g, local_state, selector, ir_tree, current_level);
                 work_on_todo(g, hook, &ir_tree, local_state);
                 ir_tree.set_finished_up_to(current_level + 1);
             }
 
             static int next_level_estimate(ir::shared_tree& ir_tree, std::function<ir::type_selector_hook> *selector) {
                 const int base_pos = ir_tree.get_finished_up_to();
-                const auto start_node = ir_tree.get_level(base_pos);
+                auto start_node = ir_tree.get_level(base_pos);
                 assert(start_node != nullptr);
+                while(!start_node->get_save()->has_coloring()) start_node = start_node->get_next(); // base is stored
                 const auto level_size = ir_tree.get_level_size(base_pos);
                 auto next_node_save = start_node->get_save();
                 auto c = next_node_save->get_coloring();
@@ -62,7 +89,60 @@ namespace dejavu {
                 return level_size * (c->ptn[col] + 1);
             }
 
-            static void queue_up_level(std::function<ir::type_selector_hook> *selector, ir::shared_tree& ir_tree,
+            /**
+             * @return whether nodes on the given level of the IR tree keep their coloring (i.e., are checkpoints)
+             */
+            [[nodiscard]] bool is_checkpoint_level(const int level) const {
+                return level % h_checkpoint_stride == 0;
+            }
+
+            /**
+             * @return how many levels nodes on the given level of the IR tree are away from their checkpoint
+             */
+            [[nodiscard]] int checkpoint_distance(const int level) const {
+                return level % h_checkpoint_stride;
+            }
+
+            /**
+             * @return fraction of nodes stored as a delta so far, if deltas are used
+             */
+            [[nodiscard]] double delta_ratio() const {
+                const long s_delta_considered = s_delta_nodes + s_delta_rejected;
+                return (h_use_delta && s_delta_considered > 0) ? 1.0 * s_delta_nodes / s_delta_considered : 0.0;
+            }
+
+            /**
+             * @param level a level of the IR tree
+             * @param v_size number of vertices of the graph
+             * @param spill whether colorings are spilled (see \a h_spill)
+             * @return estimated memory used by a node on the given level, in number of vertices
+             */
+            [[nodiscard]] double node_memory_estimate(const int level, const int v_size, const bool spill = false) const {
+                const double mem_no_delta = (is_checkpoint_level(level) && !spill) ? v_size : level;
+                const double mem_delta    = s_delta_nodes > 0 ? level + 1.0 * s_delta_size / s_delta_nodes : 0.0;
+                return delta_ratio() * mem_delta + (1 - delta_ratio()) * mem_no_delta;
+            }
+
+            /**
+             * @param level a level of the IR tree
+             * @param v_size number of vertices of the graph
+             * @return estimated disk space used by a node on the given level if colorings are spilled, in number of
+             * vertices
+             */
+            [[nodiscard]] double node_spill_estimate(const int level, const int v_size) const {
+                return is_checkpoint_level(level) ? (1 - delta_ratio()) * 2.0 * v_size : 0.0;
+            }
+
+            /**
+             * @param level a level of the IR tree
+             * @return estimated number of levels which have to be recomputed when loading a node on the given level
+             */
+            [[nodiscard]] double recompute_estimate(const int level) const {
+                return (1 - delta_ratio()) * checkpoint_distance(level);
+            }
+
+            static void queue_up_level(sgraph* g, ir::controller& local_state,
+                                       std::function<ir::type_selector_hook> *selector, ir::shared_tree& ir_tree,
                                        int base_pos) {
                 auto start_node = ir_tree.get_level(base_pos);
                 assert(start_node != nullptr);
@@ -77,7 +157,9 @@ namespace dejavu {
 
                 do {
                     auto next_node_save = next_node->get_save();
-                    auto c = next_node_save->get_coloring();
+                    if(!next_node_save->has_coloring()) local_state.load_reduced_state(*next_node_save, g);
+                    auto c = next_node_save->has_coloring()? next_node_save->get_coloring() :
+                                                             local_state.get_coloring();
                     auto this_base_pos    = next_node_save->get_base_position();
                     int col = (*selector)(c, this_base_pos);
                     if(!reserve && col >= 0) {
@@ -133,7 +215,7 @@ namespace dejavu {
                 // do efficient loading if parent is the same as previous load
                 if(next_node_save != last_load || g->v_size < 1000) { // TODO heuristic to check how much has changed
                     local_state.use_reversible(false); // potentially loads more efficiently
-                    local_state.load_reduced_state(*next_node_save);
+                    local_state.load_reduced_state(*next_node_save, g);
                 } else {
                     local_state.move_to_parent();
                     local_state.load_reduced_state_without_coloring(*next_node_save); // TODO <- this should be unecessary, right?
@@ -198,8 +280,36 @@ namespace dejavu {
 
                 if(local_state.T->trace_equal() && cert) {
                     ++s_total_kept;
-                    auto new_save = new ir::limited_save();
-                    local_state.save_reduced_state(*new_save);
+                    auto new_save = ir_tree->create_save(local_state.s_base_pos);
+                    // store a delta to the parent if it is small enough
+                    bool use_delta = false;
+                    if(h_use_delta && !is_base && !next_node_save->is_base_only()) {
+                        const int delta_size = local_state.recorded_delta_size();
+                        use_delta = delta_size <= h_delta_max_ratio * g->v_size;
+                        if(use_delta) {
+                            ++s_delta_nodes;
+                            s_delta_size += delta_size;
+                        } else {
+                            ++s_delta_rejected;
+                        }
+                    }
+
+                    if(use_delta) {
+                        local_state.save_reduced_state_delta(*new_save, next_node_save);
+                    } else if(is_base || is_checkpoint_level(local_state.s_base_pos)) {
+                        // nodes on the base always keep their coloring in memory, since other nodes are compared to
+                        // them -- if spilling fails, we fall back to keeping the coloring in memory as well
+                        int* storage = (h_spill && !is_base) ?
+                                ir_tree->create_spilled_coloring(local_state.s_base_pos, g->v_size) : nullptr;
+                        if(storage != nullptr) {
+                            local_state.save_reduced_state_spilled(*new_save, storage);
+                            ++s_spilled_nodes;
+                        } else {
+                            local_state.save_reduced_state(*new_save);
+                        }
+                    } else {
+                        local_state.save_reduced_state_base_only(*new_save, next_node_save->get_checkpoint());
+                    }
                     ir_tree->add_node(local_state.s_base_pos, new_save, node, is_base);
                     if(local_state.s_base_pos > 1) ir_tree->record_add_invariant(v, local_state.T->get_hash());
                 } else {
@@ -233,6 +343,7 @@ namespace dejavu {
             void work_on_todo(sgraph* g, dejavu_hook* hook, ir::shared_tree* ir_tree, ir::controller& local_state) {
                 ir::limited_save* last_load = nullptr;
                 int s_count_nodes = 0;
+                local_state.use_delta_recording(h_use_delta);
                 while(!ir_tree->queue_missing_node_empty()) {
                     ++s_count_nodes;
                     if((s_count_nodes & 0x00000FFF) == 0)
@@ -242,6 +353,7 @@ namespace dejavu {
                     compute_node(g, hook, ir_tree, local_state, todo.first, todo.second, last_load);
                     last_load = todo.first->get_save();
                 }
+                local_state.use_delta_recording(false);
             }
         };
     }
@@ -56,6 +56,7 @@ namespace dejavu::ds {
          */
         void dealloc() {
             if (alloc_pt) free(alloc_pt);
+            alloc_pt = nullptr;
             lab = nullptr;
             ptn = nullptr;
             vertex_to_col = nullptr;
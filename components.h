@@ -8,6 +8,7 @@
 #include "graph.h"
 #include "coloring.h"
 #include "ds.h"
+#include "refinement.h"
 
 namespace dejavu::ir {
 
@@ -20,7 +21,7 @@ namespace dejavu::ir {
      * components - 1
      * @returns number of components
      */
-    static int quotient_components(sgraph *g, int* colmap, ds::worklist *vertex_to_component) {
+    [[maybe_unused]] static int quotient_components(sgraph *g, int* colmap, ds::worklist *vertex_to_component) {
         coloring c;
         g->initialize_coloring(&c, colmap); // TODO certainly possible without a coloring, just keep a
                                             // TODO color_to_component array
@@ -92,18 +93,334 @@ namespace dejavu::ir {
         return current_component;
     }
 
+
     /**
      * \brief Decomposes graphs and manages decomposition information
      *
+     * Besides splitting a graph into components that can be solved independently, the decomposer can detect components
+     * which are isomorphic to each other (see \ref isomorphic_components). Of each class of isomorphic components, only
+     * a single representative is kept in the decomposition. Automorphisms of the representative are then replicated to
+     * all its copies using \ref lift_automorphism, and the copies themselves are permuted by \ref swap_copies.
      */
     class graph_decomposer {
         int num_components = 0;
+        int domain_size    = 0;
+        bool decomposed    = false;
         std::vector<sgraph>  components_graph;
         std::vector<int*>    components_coloring;
         std::vector<int>     backward_translation;
         std::vector<int>     component_to_backward_translation;
 
+        // isomorphic copies of components
+        std::vector<int>     component_copies;           /**< number of copies of a component (including itself)  */
+        std::vector<int>     component_to_copy_vertices; /**< start of the copies of a component in `copy_vertices`*/
+        std::vector<int>     copy_vertices;              /**< vertex `v` of copy `j` of component `i` is stored at
+                                                           *  `component_to_copy_vertices[i] + j * size + v`         */
+        ds::worklist         lift_p;                     /**< workspace to write lifted automorphisms to            */
+        ds::worklist         lift_supp;                  /**< support of the lifted automorphism                    */
+
+        // workspace for walks of components
+        refinement           walk_refinement;
+        std::vector<int>     walk_order;                 /**< vertices of the component, ordered by color           */
+        std::vector<int>     walk_local;                 /**< maps vertices of the graph to `walk_order` positions  */
+        std::vector<int>     walk_record;                /**< records cells individualized by the recorded walk     */
+        std::vector<int>     walk_leaf;                  /**< leaf of the last walk, in vertices of the graph       */
+        std::vector<int>     walk_leaf_rep;              /**< leaf of the recorded walk                             */
+        std::vector<int>     walk_phi;                   /**< isomorphism between two components                    */
+        ds::markset          walk_set;
+
+        /**
+         * Walks the IR tree of the connected component consisting of the vertices \p vertices. The walk always
+         * individualizes the first vertex of the first non-trivial cell, and stores the leaf it ends up in
+         * `walk_leaf`.
+         *
+         * If \p record is set, the walk is recorded. Otherwise, the walk is compared to the recorded walk.
+         *
+         * @param g the graph
+         * @param c vertex coloring of \p g
+         * @param vertex_to_cc maps vertices to their connected component
+         * @param vertices vertices of the connected component
+         * @param sz number of vertices of the connected component
+         * @param record whether to record the walk, or to compare to the recorded walk
+         * @return whether the walk was recorded, or did not deviate from the recorded walk
+         */
+        bool component_walk(sgraph *g, coloring &c, const std::vector<int> &vertex_to_cc, const int *vertices,
+                            const int sz, bool record) {
+            const int component = vertex_to_cc[vertices[0]];
+
+            // the walk is performed on the component with vertices ordered by color, so that cells of isomorphic
+            // components appear in the same order
+            walk_order.assign(vertices, vertices + sz);
+            std::sort(walk_order.begin(), walk_order.end(), [&c](const int v1, const int v2) {
+                return c.vertex_to_col[v1] < c.vertex_to_col[v2] ||
+                       (c.vertex_to_col[v1] == c.vertex_to_col[v2] && v1 < v2);
+            });
+
+            int edges = 0;
+            for(int i = 0; i < sz; ++i) {
+                const int v = walk_order[i];
+                walk_local[v] = i;
+                edges += g->d[v];
+            }
+
+            sgraph walk_g;
+            walk_g.initialize(sz, edges);
+            walk_g.v_size = sz;
+            int epos = 0;
+            for(int i = 0; i < sz; ++i) {
+                const int v = walk_order[i];
+                walk_g.v[i] = epos;
+                for(int j = g->v[v]; j < g->v[v] + g->d[v]; ++j) {
+                    const int neighbour = g->e[j];
+                    if(vertex_to_cc[neighbour] == component) walk_g.e[epos++] = walk_local[neighbour];
+                }
+                walk_g.d[i] = epos - walk_g.v[i];
+            }
+            walk_g.e_size = epos;
+            walk_g.dense  = !(walk_g.e_size < walk_g.v_size ||
+                              walk_g.e_size / walk_g.v_size < walk_g.v_size / (walk_g.e_size / walk_g.v_size));
+
+            std::vector<int> walk_col;
+            walk_col.reserve(sz);
+            for(int i = 0; i < sz; ++i) walk_col.push_back(c.vertex_to_col[walk_order[i]]);
+
+            coloring walk_c;
+            walk_g.initialize_coloring(&walk_c, walk_col.data());
+            walk_refinement.refine_coloring_first(&walk_g, &walk_c);
+
+            int step = 0;
+            if(record) {
+                walk_record.clear();
+                walk_record.push_back(walk_c.cells);
+            } else if(walk_record[step++] != walk_c.cells) {
+                return false;
+            }
+
+            int pos = 0;
+            while(walk_c.cells < sz) {
+                while(walk_c.ptn[pos] == 0) ++pos;
+                if(record) {
+                    walk_record.push_back(pos);
+                    walk_record.push_back(walk_c.ptn[pos]);
+                } else if(walk_record[step++] != pos || walk_record[step++] != walk_c.ptn[pos]) {
+                    return false;
+                }
+
+                const int init_color_class = refinement::individualize_vertex(&walk_c, walk_c.lab[pos]);
+                walk_refinement.refine_coloring_first(&walk_g, &walk_c, init_color_class);
+
+                if(record) {
+                    walk_record.push_back(walk_c.cells);
+                } else if(walk_record[step++] != walk_c.cells) {
+                    return false;
+                }
+            }
+
+            walk_leaf.clear();
+            for(int i = 0; i < sz; ++i) walk_leaf.push_back(walk_order[walk_c.lab[i]]);
+            return true;
+        }
+
+        /**
+         * Certifies that the map from `walk_leaf_rep` to `walk_leaf` is an isomorphism between the two respective
+         * components, which fixes all vertices outside of the two components. In particular, neighbours with singleton
+         * colors must be fixed.
+         *
+         * @param g the graph
+         * @param c vertex coloring of \p g
+         * @param vertex_to_cc maps vertices to their connected component
+         * @return whether the map is an isomorphism, stored in `walk_phi` if so
+         */
+        bool certify_isomorphism(sgraph *g, coloring &c, const std::vector<int> &vertex_to_cc) {
+            const int sz = static_cast<int>(walk_leaf_rep.size());
+            const int component_rep = vertex_to_cc[walk_leaf_rep[0]];
+            for(int i = 0; i < sz; ++i) walk_phi[walk_leaf_rep[i]] = walk_leaf[i];
+
+            for(int i = 0; i < sz; ++i) {
+                const int v     = walk_leaf_rep[i];
+                const int phi_v = walk_leaf[i];
+                if(c.vertex_to_col[v] != c.vertex_to_col[phi_v] || g->d[v] != g->d[phi_v]) return false;
+
+                walk_set.reset();
+                for(int j = g->v[phi_v]; j < g->v[phi_v] + g->d[phi_v]; ++j) walk_set.set(g->e[j]);
+                for(int j = g->v[v]; j < g->v[v] + g->d[v]; ++j) {
+                    const int neighbour     = g->e[j];
+                    const int phi_neighbour = vertex_to_cc[neighbour] == component_rep? walk_phi[neighbour] :
+                                                                                         neighbour;
+                    if(!walk_set.get(phi_neighbour)) return false;
+                }
+            }
+            return true;
+        }
+
     public:
+        /**
+         * Compute the connected components of graph \p g colored with vertex coloring \p colmap, where vertices of
+         * singleton colors are disregarded. Components are then grouped into classes using cheap invariants (size,
+         * color histogram, and hashes of neighbouring colors). Each class of candidate isomorphic components is
+         * confirmed using a single paired walk of the IR trees of the components, which is then certified.
+         *
+         * Of a confirmed class, only a representative is assigned a component in \p vertex_to_component, whereas its
+         * copies are recorded internally. If a class can not be confirmed, all of its components are merged into a
+         * single component instead.
+         *
+         * @param g the graph
+         * @param colmap the vertex coloring
+         * @param vertex_to_component map from vertex to component, where components are enumerated from 0 to number of
+         * components - 1, and vertices which are not part of any component are mapped to -1
+         * @returns number of components
+         */
+        int isomorphic_components(sgraph *g, int* colmap, ds::worklist *vertex_to_component) {
+            const int n = g->v_size;
+            domain_size = n;
+
+            coloring c;
+            g->initialize_coloring(&c, colmap);
+
+            // compute connected components, disregarding vertices of singleton colors
+            std::vector<int> vertex_to_cc(n, -1);
+            ds::worklist wl(n);
+            int num_cc = 0;
+            for(int v = 0; v < n; ++v) {
+                if(vertex_to_cc[v] >= 0 || c.ptn[c.vertex_to_col[v]] == 0) continue;
+                vertex_to_cc[v] = num_cc;
+                wl.push_back(v);
+                while(!wl.empty()) {
+                    const int k = wl.pop_back();
+                    for(int j = g->v[k]; j < g->v[k] + g->d[k]; ++j) {
+                        const int neighbour = g->e[j];
+                        if(vertex_to_cc[neighbour] < 0 && c.ptn[c.vertex_to_col[neighbour]] > 0) {
+                            vertex_to_cc[neighbour] = num_cc;
+                            wl.push_back(neighbour);
+                        }
+                    }
+                }
+                ++num_cc;
+            }
+
+            // list vertices of each connected component, in ascending order
+            std::vector<int> cc_start(num_cc + 1, 0);
+            for(int v = 0; v < n; ++v) if(vertex_to_cc[v] >= 0) ++cc_start[vertex_to_cc[v] + 1];
+            for(int i = 0; i < num_cc; ++i) cc_start[i + 1] += cc_start[i];
+            std::vector<int> cc_vertices(cc_start[num_cc]);
+            std::vector<int> cc_fill(cc_start.begin(), cc_start.end() - 1);
+            for(int v = 0; v < n; ++v) if(vertex_to_cc[v] >= 0) cc_vertices[cc_fill[vertex_to_cc[v]]++] = v;
+
+            // fingerprint connected components: size, number of edges, and a hash of colors and neighbouring colors
+            std::vector<std::tuple<int, int, unsigned long, int>> fingerprints;
+            fingerprints.reserve(num_cc);
+            for(int i = 0; i < num_cc; ++i) {
+                int edges = 0;
+                unsigned long fingerprint = 0;
+                for(int k = cc_start[i]; k < cc_start[i + 1]; ++k) {
+                    const int v   = cc_vertices[k];
+                    const int col = c.vertex_to_col[v];
+                    edges += g->d[v];
+                    fingerprint += hash(col + hash(g->d[v]));
+                    for(int j = g->v[v]; j < g->v[v] + g->d[v]; ++j) {
+                        const int neighbour = g->e[j];
+                        // neighbours of singleton color are fixed, so we hash the vertex itself
+                        fingerprint += vertex_to_cc[neighbour] < 0 ? hash(hash(col) ^ hash(neighbour + n)) :
+                                                                    hash(hash(col) + c.vertex_to_col[neighbour]);
+                    }
+                }
+                fingerprints.emplace_back(cc_start[i + 1] - cc_start[i], edges, fingerprint, i);
+            }
+            std::sort(fingerprints.begin(), fingerprints.end());
+
+            // classes of equal fingerprints are confirmed to be isomorphic, if possible
+            walk_local.resize(n);
+            walk_phi.resize(n);
+            walk_set.initialize(n);
+            num_components = 0;
+            component_copies.clear();
+            component_to_copy_vertices.clear();
+            copy_vertices.clear();
+
+            for(int i = 0; i < n; ++i) (*vertex_to_component)[i] = -1;
+
+            for(int i = 0; i < num_cc;) {
+                int j = i + 1;
+                while(j < num_cc && std::get<0>(fingerprints[i]) == std::get<0>(fingerprints[j]) &&
+                      std::get<1>(fingerprints[i]) == std::get<1>(fingerprints[j]) &&
+                      std::get<2>(fingerprints[i]) == std::get<2>(fingerprints[j])) ++j;
+
+                const int  rep      = std::get<3>(fingerprints[i]);
+                const int  sz       = std::get<0>(fingerprints[i]);
+                const int* rep_vert = cc_vertices.data() + cc_start[rep];
+                bool confirmed = j - i > 1;
+
+                if(confirmed) {
+                    component_walk(g, c, vertex_to_cc, rep_vert, sz, true);
+                    walk_leaf_rep = walk_leaf;
+                    component_to_copy_vertices.push_back(static_cast<int>(copy_vertices.size()));
+                    copy_vertices.insert(copy_vertices.end(), rep_vert, rep_vert + sz);
+
+                    for(int k = i + 1; k < j && confirmed; ++k) {
+                        const int other = std::get<3>(fingerprints[k]);
+                        confirmed = component_walk(g, c, vertex_to_cc, cc_vertices.data() + cc_start[other], sz,
+                                                   false) && certify_isomorphism(g, c, vertex_to_cc);
+                        if(confirmed) for(int l = 0; l < sz; ++l) copy_vertices.push_back(walk_phi[rep_vert[l]]);
+                    }
+
+                    if(!confirmed) {
+                        copy_vertices.resize(component_to_copy_vertices.back());
+                        component_to_copy_vertices.pop_back();
+                    }
+                }
+
+                if(confirmed) {
+                    // only the representative is solved, copies are handled through the isomorphisms
+                    for(int l = 0; l < sz; ++l) (*vertex_to_component)[rep_vert[l]] = num_components;
+                    component_copies.push_back(j - i);
+                } else {
+                    // merge the whole class into a single component
+                    for(int k = i; k < j; ++k) {
+                        const int other = std::get<3>(fingerprints[k]);
+                        for(int l = cc_start[other]; l < cc_start[other + 1]; ++l)
+                            (*vertex_to_component)[cc_vertices[l]] = num_components;
+                    }
+                    component_to_copy_vertices.push_back(static_cast<int>(copy_vertices.size()));
+                    component_copies.push_back(1);
+                }
+                ++num_components;
+                i = j;
+            }
+
+            if(has_copies()) {
+                lift_p.allocate(n);
+                lift_supp.allocate(n);
+                for(int i = 0; i < n; ++i) lift_p[i] = i;
+            }
+
+            return num_components;
+        }
+
+        /**
+         * @return whether some component of the decomposition has isomorphic copies
+         */
+        [[nodiscard]] bool has_copies() const {
+            for(const int copies : component_copies) if(copies > 1) return true;
+            return false;
+        }
+
+        /**
+         * @return whether the graph was split up by the last call to \ref decompose
+         */
+        [[nodiscard]] bool is_decomposed() const {
+            return decomposed;
+        }
+
+        /**
+         * Returns the number of isomorphic copies of component \p i, including component \p i itself.
+         *
+         * @param i number of component
+         * @return number of copies of component \p i
+         */
+        [[nodiscard]] int get_copies(int i) const {
+            return i < static_cast<int>(component_copies.size()) ? component_copies[i] : 1;
+        }
+
         /**
          * Maps back vertex \p vertex of component \p component
          * @param component
@@ -115,10 +432,64 @@ namespace dejavu::ir {
             assert(component < num_components);
             assert(component_to_backward_translation[component] + vertex <
                    static_cast<int>(backward_translation.size()));
-            return (num_components <= 1? vertex :
+            return (!decomposed? vertex :
                     backward_translation[component_to_backward_translation[component] + vertex]);
         }
 
+        /**
+         * Replicates the automorphism \p p of component \p component to all isomorphic copies of the component. The
+         * resulting automorphisms of the decomposed graph are returned using \p hook.
+         *
+         * @param component the component
+         * @param p automorphism of the component
+         * @param nsupp size of the support of \p p, or -1 if the support is not provided
+         * @param supp support of \p p
+         * @param hook hook to return the automorphisms of the decomposed graph
+         */
+        void lift_automorphism(int component, const int* p, int nsupp, const int* supp, dejavu_hook* hook) {
+            const int  sz      = components_graph[component].v_size;
+            const int* copy_pt = copy_vertices.data() + component_to_copy_vertices[component];
+            const int  end     = nsupp >= 0 ? nsupp : sz;
+
+            for(int j = 0; j < component_copies[component]; ++j, copy_pt += sz) {
+                for(int i = 0; i < end; ++i) {
+                    const int v = nsupp >= 0 ? supp[i] : i;
+                    if(p[v] == v) continue;
+                    lift_p[copy_pt[v]] = copy_pt[p[v]];
+                    lift_supp.push_back(copy_pt[v]);
+                }
+                if(hook) (*hook)(domain_size, lift_p.get_array(), lift_supp.cur_pos, lift_supp.get_array());
+                for(int i = 0; i < lift_supp.cur_pos; ++i) lift_p[lift_supp[i]] = lift_supp[i];
+                lift_supp.reset();
+            }
+        }
+
+        /**
+         * Returns automorphisms of the decomposed graph swapping the first copy of component \p component with each of
+         * the other copies, using \p hook. Together with the lifted automorphisms of the component, these generate the
+         * wreath product of the automorphism group of the component with the symmetric group on its copies.
+         *
+         * @param component the component
+         * @param hook hook to return the automorphisms of the decomposed graph
+         */
+        void swap_copies(int component, dejavu_hook* hook) {
+            const int  sz    = components_graph[component].v_size;
+            const int* first = copy_vertices.data() + component_to_copy_vertices[component];
+
+            for(int j = 1; j < component_copies[component]; ++j) {
+                const int* other = first + j * sz;
+                for(int v = 0; v < sz; ++v) {
+                    lift_p[first[v]] = other[v];
+                    lift_p[other[v]] = first[v];
+                    lift_supp.push_back(first[v]);
+                    lift_supp.push_back(other[v]);
+                }
+                if(hook) (*hook)(domain_size, lift_p.get_array(), lift_supp.cur_pos, lift_supp.get_array());
+                for(int i = 0; i < lift_supp.cur_pos; ++i) lift_p[lift_supp[i]] = lift_supp[i];
+                lift_supp.reset();
+            }
+        }
+
         /**
          * Decompose the given graph into components, as defined by \p vertex_to_component. Rearranges \p g and stores
          * decomposition information internally.
@@ -131,7 +502,8 @@ namespace dejavu::ir {
         void decompose(sgraph *g, int* colmap, ds::worklist& vertex_to_component, int new_num_components) {
             // set up forward / backward maps
             num_components = new_num_components; // new_num_components
-            if(num_components <= 1) return;
+            if(num_components <= 1 && !has_copies()) return;
+            decomposed = true;
 
             std::vector<int> vertices_in_component;
             vertices_in_component.resize(num_components);
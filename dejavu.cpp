@@ -25,6 +25,18 @@ int commandline_mode(int argc, char **argv) {
 
     bool true_random = false;
     bool true_random_seed = false;
+    bool pipeline_sifting = false;
+    bool autotune = false;
+    int  threads = 1;
+    int  cache_levels = 2;
+    int  bfs_stride = 1;
+    bool bfs_delta = true;
+    long leaf_memory = 128;
+    std::string bfs_spill_directory;
+    int  compact_trace = 0;
+    std::string checkpoint_file;
+    int  checkpoint_interval = 600;
+    std::string resume_file;
 
     int error_bound = 10;
 
@@ -41,37 +53,76 @@ int commandline_mode(int argc, char **argv) {
 
         if (arg == "__HELP" || arg == "_H") {
             std::cout << "Usage: dejavu [file] [options]" << std::endl;
-            std::cout << "Computes the automorphism group of undirected graph described in FILE." << std::endl;
-            std::cout << "FILE is expected to be in DIMACS format." << std::endl;
+            std::cout << "Computes the automorphism group of the graph described in FILE." << std::endl;
+            std::cout << "FILE is expected to be in DIMACS format. Edge lines may carry an edge color as a third "
+                         "field ('e v1 v2 color'), and arcs are given as 'a v1 v2'." << std::endl;
+            std::cout << "If FILE is a formula in DIMACS CNF format, symmetries of the formula are computed, and "
+                         "generators are written as permutations of literals." << std::endl;
             std::cout << "Options:" << std::endl;
-            std::cout << "    "  << std::left << std::setw(20) <<
+            std::cout << "    "  << std::left << std::setw(27) <<
             "--err [n]" << std::setw(16) <<
             "Sets the error to be bounded by 1/2^N, assuming uniform random numbers" << std::endl;
-            std::cout << "    " << std::left << std::setw(20) <<
+            std::cout << "    " << std::left << std::setw(27) <<
             "--silent" << std::setw(16) <<
             "Does not print progress of the solver" << std::endl;
-            std::cout << "    " << std::left << std::setw(20) <<
+            std::cout << "    " << std::left << std::setw(27) <<
             "--gens" << std::setw(16) <<
             "Prints found generators line-by-line to console" << std::endl;
-            std::cout << "    " << std::left << std::setw(20) <<
+            std::cout << "    " << std::left << std::setw(27) <<
             "--gens-file [f]" << std::setw(16) <<
            "Writes found generators line-by-line to file F" << std::endl;
-            std::cout << "    " << std::left << std::setw(20) <<
+            std::cout << "    " << std::left << std::setw(27) <<
             "--grp-sz" << std::setw(16) <<
             "Prints group size to console (even if --silent)" << std::endl;
-            std::cout << "    "  << std::left << std::setw(20) <<
+            std::cout << "    "  << std::left << std::setw(27) <<
             "--pseudo-random" << std::setw(16) <<
             "Uses pseudo random numbers (default)" << std::endl;
-            std::cout << "    " << std::left << std::setw(20) <<
+            std::cout << "    " << std::left << std::setw(27) <<
             "--true-random" << std::setw(16) <<
             "Uses random device of OS" << std::endl;
-            std::cout << "    "  << std::left << std::setw(20) <<
+            std::cout << "    "  << std::left << std::setw(27) <<
             "--true-random-seed" << std::setw(16) <<
             "Seeds pseudo random with random device of OS" << std::endl;
-            std::cout << "    "  << std::left << std::setw(20) <<
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--threads [n]" << std::setw(16) <<
+            "Uses N threads in parallelized parts of the solver" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--pipeline-sifting" << std::setw(16) <<
+            "Sifts automorphisms on a dedicated thread" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--autotune" << std::setw(16) <<
+            "Calibrates color refinement kernels on the graph" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--cache-levels [n]" << std::setw(16) <<
+            "Caches color refinement on N levels of random search (default 2)" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--bfs-stride [n]" << std::setw(16) <<
+            "Keeps colorings of BFS nodes only on every N-th level (default 1)" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--no-bfs-delta" << std::setw(16) <<
+            "Never stores colorings of BFS nodes as deltas to their parent" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--bfs-spill [dir]" << std::setw(16) <<
+            "Spills colorings of large BFS levels to temporary files in DIR" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--compact-trace [n]" << std::setw(16) <<
+            "Only keeps hashes of blocks of N operations of the base trace" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--leaf-memory [n]" << std::setw(16) <<
+            "Memory budget for colorings of stored leaves in MB (default 128)" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--checkpoint [f]" << std::setw(16) <<
+            "Periodically writes checkpoints of the search to file F" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--checkpoint-interval [s]" << std::setw(16) <<
+            "Writes checkpoints at most every S seconds (default 600)" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
+            "--resume [f]" << std::setw(16) <<
+            "Resumes the search from the checkpoint in file F" << std::endl;
+            std::cout << "    "  << std::left << std::setw(27) <<
             "--permute" << std::setw(16) <<
             "Randomly permutes the given graph" << std::endl;
-            std::cout << "    "  << std::left << std::setw(20) <<
+            std::cout << "    "  << std::left << std::setw(27) <<
             "--permute-seed [n]" << std::setw(16) <<
             "Seed for the previous option with N" << std::endl;
             return 0;
@@ -127,6 +178,108 @@ int commandline_mode(int argc, char **argv) {
                 return 1;
             }
             true_random_seed = true;
+        } else if (arg == "__THREADS") {
+            if (i + 1 < argc) {
+                i++;
+                threads = atoi(argv[i]);
+            } else {
+                std::cerr << "--threads option requires one argument." << std::endl;
+                return 1;
+            }
+            if (threads < 1) {
+                std::cerr << "--threads option requires a positive number." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__PIPELINE_SIFTING") {
+            pipeline_sifting = true;
+        } else if (arg == "__AUTOTUNE") {
+            autotune = true;
+        } else if (arg == "__CACHE_LEVELS") {
+            if (i + 1 < argc) {
+                i++;
+                cache_levels = atoi(argv[i]);
+            } else {
+                std::cerr << "--cache-levels option requires one argument." << std::endl;
+                return 1;
+            }
+            if (cache_levels < 0) {
+                std::cerr << "--cache-levels option requires a non-negative number." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__BFS_STRIDE") {
+            if (i + 1 < argc) {
+                i++;
+                bfs_stride = atoi(argv[i]);
+            } else {
+                std::cerr << "--bfs-stride option requires one argument." << std::endl;
+                return 1;
+            }
+            if (bfs_stride < 1) {
+                std::cerr << "--bfs-stride option requires a positive number." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__NO_BFS_DELTA") {
+            bfs_delta = false;
+        } else if (arg == "__BFS_SPILL") {
+            if (i + 1 < argc) {
+                i++;
+                bfs_spill_directory = argv[i];
+            } else {
+                std::cerr << "--bfs-spill option requires one argument." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__COMPACT_TRACE") {
+            if (i + 1 < argc) {
+                i++;
+                compact_trace = atoi(argv[i]);
+            } else {
+                std::cerr << "--compact-trace option requires one argument." << std::endl;
+                return 1;
+            }
+            if (compact_trace < 0) {
+                std::cerr << "--compact-trace option requires a non-negative number." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__LEAF_MEMORY") {
+            if (i + 1 < argc) {
+                i++;
+                leaf_memory = atol(argv[i]);
+            } else {
+                std::cerr << "--leaf-memory option requires one argument." << std::endl;
+                return 1;
+            }
+            if (leaf_memory < 0) {
+                std::cerr << "--leaf-memory option requires a non-negative number." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__CHECKPOINT") {
+            if (i + 1 < argc) {
+                i++;
+                checkpoint_file = argv[i];
+            } else {
+                std::cerr << "--checkpoint option requires one argument." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__CHECKPOINT_INTERVAL") {
+            if (i + 1 < argc) {
+                i++;
+                checkpoint_interval = atoi(argv[i]);
+            } else {
+                std::cerr << "--checkpoint-interval option requires one argument." << std::endl;
+                return 1;
+            }
+            if (checkpoint_interval < 0) {
+                std::cerr << "--checkpoint-interval option requires a non-negative number." << std::endl;
+                return 1;
+            }
+        } else if (arg == "__RESUME") {
+            if (i + 1 < argc) {
+                i++;
+                resume_file = argv[i];
+            } else {
+                std::cerr << "--resume option requires one argument." << std::endl;
+                return 1;
+            }
         } else if (arg == "__PERMUTE") {
             permute_graph = true;
         }  else if (arg == "__PERMUTE_SEED") {
@@ -182,8 +335,19 @@ int commandline_mode(int argc, char **argv) {
         if(print) std::cout << (true_random?"true_random=true, ":"") << (true_random_seed?"true_random_seed=true":"");
         if(print) std::cout << "permutation_seed=" << permute_seed << ", ";
     }
-    parse_dimacs(filename, &g, &colmap, !print, permute_seed);
-    if(print) std::cout << ", n=" << g.v_size << ", " << "m=" << g.e_size/2 << std::endl << std::endl;
+    // formulas in CNF are read as literal-clause graphs
+    const bool cnf = is_dimacs_cnf(filename);
+    if(cnf && permute_graph) {
+        std::cerr << "--permute is not supported for formulas in CNF." << std::endl;
+        return 1;
+    }
+    int variables = 0;
+    if(cnf) variables = parse_dimacs_cnf(filename, &g, &colmap, !print);
+    else if(!parse_dimacs(filename, &g, &colmap, !print, permute_seed)) return 1;
+    if(variables < 0) return 1;
+    if(print) std::cout << ", n=" << g.v_size << ", " << "m=" << g.e_size/2;
+    if(print && cnf) std::cout << ", variables=" << variables;
+    if(print) std::cout << std::endl << std::endl;
 
     // manage hooks
     auto empty_hook_func = dejavu_hook(empty_hook);
@@ -191,13 +355,15 @@ int commandline_mode(int argc, char **argv) {
     std::ofstream output_file;
     dejavu::hooks::ostream_hook file_hook(output_file);
     dejavu::hooks::ostream_hook cout_hook(std::cout);
+    dejavu::hooks::literal_ostream_hook literal_file_hook(output_file, variables);
+    dejavu::hooks::literal_ostream_hook literal_cout_hook(std::cout, variables);
     dejavu_hook* hook;
 
-    // write automorphism to file or cout
-    if(write_auto_stdout) hooks.add_hook(cout_hook.get_hook());
+    // write automorphism to file or cout, for formulas in terms of literals
+    if(write_auto_stdout) hooks.add_hook(cnf ? literal_cout_hook.get_hook() : cout_hook.get_hook());
     if(write_auto_file) {
         output_file.open(write_auto_file_name);
-        hooks.add_hook(file_hook.get_hook());
+        hooks.add_hook(cnf ? literal_file_hook.get_hook() : file_hook.get_hook());
     }
 
     // debug hook
@@ -222,6 +388,17 @@ int commandline_mode(int argc, char **argv) {
     d.set_print(print);
     if (true_random_seed) d.randomize_seed();
     d.set_true_random(true_random);
+    d.set_pipeline_sifting(pipeline_sifting);
+    d.set_threads(threads);
+    d.set_autotune_refinement(autotune);
+    d.set_refinement_cache(cache_levels, 0x4000000);
+    d.set_bfs_checkpoint_stride(bfs_stride);
+    d.set_bfs_delta(bfs_delta);
+    d.set_leaf_memory(leaf_memory * 1024 * 1024);
+    d.set_bfs_spill(bfs_spill_directory);
+    d.set_compact_trace(compact_trace);
+    d.set_checkpoint(checkpoint_file, checkpoint_interval);
+    d.set_resume(resume_file);
     d.automorphisms(&g, colmap, hook);
 
     long dejavu_solve_time = (std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - timer).count());
@@ -45,9 +45,24 @@ namespace dejavu {
         int  h_random_seed = 0; /**< is true randomness is not used, here is the seed to be used */
         bool h_silent = false; /**< don't print solver progress */
         int  h_bfs_memory_limit = 0x20000000;
+        int  h_bfs_checkpoint_stride = 1; /**< BFS only keeps colorings of nodes on every n-th level */
+        bool h_bfs_delta = true; /**< BFS keeps colorings of nodes as deltas to their parent, if the delta is small */
+        std::string h_bfs_spill_directory; /**< BFS may spill colorings of nodes to files in this directory */
+        long h_bfs_spill_limit = 0; /**< limit for disk space used by spilled colorings in bytes */
         bool h_decompose = true; /**< use non-uniform component decomposition */
+        bool h_pipeline_sifting = false; /**< sift automorphisms of random search on a dedicated thread */
+        int  h_threads = 1; /**< number of threads to use for parallelized parts of the solver */
+        bool h_autotune_refinement = false; /**< calibrate the kernels of color refinement on each graph */
+        int  h_refinement_cache_levels = 2; /**< random search caches refinement on this many levels of the IR tree */
+        long h_refinement_cache_memory = 0x4000000; /**< memory budget of the refinement cache in bytes */
+        long h_leaf_memory = 0x8000000; /**< memory budget for colorings of leaves stored by random search in bytes */
+        int  h_compact_trace = 0; /**< if positive, the comparison trace only keeps hashes of blocks of this many
+                                    *  operations */
         int  h_base_max_diff     = 5; /**< only allow a base that is at most `h_base_max_diff` times larger than the
                                         *  previous base */
+        std::string h_checkpoint_file;     /**< checkpoints of the search are written to this file, none if empty  */
+        int  h_checkpoint_interval = 600; /**< minimum time between checkpoints in seconds                         */
+        std::string h_resume_file;         /**< search is resumed from the checkpoint in this file, none if empty  */
         //int h_limit_fail        = 0; /**< limit for the amount of backtracking allowed */
 
         //bool h_cert_original = true; /**< certify all automorphisms on the original graph, and skip non-certified */
@@ -59,6 +74,106 @@ namespace dejavu {
 
         bool s_deterministic_termination = true; /**< did the last run terminate deterministically? */
         big_number s_grp_sz; /**< size of the automorphism group computed in last run */
+        long s_hash_collisions   = 0; /**< leaves with equal hash, told apart by their upper hash in last run   */
+        long s_cert_failures     = 0; /**< leaves with equal hash which were not automorphic in last run       */
+        long s_strong_invariants = 0; /**< strong invariants written after failed certifications in last run */
+        bool s_resumed = false;       /**< did the last run continue the search of a checkpoint?               */
+
+        static constexpr int checkpoint_version = 1; /**< version of the format of checkpoint files */
+
+        /**
+         * \brief Part of a checkpoint which does not belong to the search on a component
+         */
+        struct checkpoint_header {
+            uint64_t fingerprint = 0;  /**< fingerprint of the input, see \a checkpoint_fingerprint */
+            int component        = 0;  /**< component on which search was performed                   */
+            big_number grp_sz;         /**< group size, excluding the component                        */
+            bool deterministic   = true;
+            long hash_collisions = 0;
+            long cert_failures   = 0;
+            long strong_invariants = 0;
+            std::vector<int> automorphisms; /**< automorphisms returned after preprocessing which generate all the
+                                              *  ones returned so far, each stored as the size of its support,
+                                              *  followed by pairs of a vertex and its image */
+
+            template<class A>
+            void serialize(A& ar) {
+                std::string magic = "dejavu-checkpoint";
+                int version = checkpoint_version;
+                ar.value(magic);
+                ar.value(version);
+                ar.value(fingerprint);
+                if constexpr (A::reading) {
+                    if(magic != "dejavu-checkpoint" || version != checkpoint_version) ar.fail();
+                }
+                ar.value(component);
+                grp_sz.serialize(ar);
+                ar.value(deterministic);
+                ar.value(hash_collisions);
+                ar.value(cert_failures);
+                ar.value(strong_invariants);
+                ar.values(automorphisms);
+            }
+
+            void record_automorphism(int n, const int *p, int nsupp, const int *supp) {
+                const auto pos = automorphisms.size();
+                automorphisms.push_back(0);
+                for(int i = 0; i < (supp != nullptr ? nsupp : n); ++i) {
+                    const int v = supp != nullptr ? supp[i] : i;
+                    if(p[v] == v) continue;
+                    automorphisms.push_back(v);
+                    automorphisms.push_back(p[v]);
+                    ++automorphisms[pos];
+                }
+            }
+
+            void replay_automorphisms(int n, dejavu_hook* hook) const {
+                std::vector<int> p(n), supp;
+                for(int i = 0; i < n; ++i) p[i] = i;
+                for(size_t pos = 0; pos < automorphisms.size();) {
+                    const int nsupp = automorphisms[pos++];
+                    supp.clear();
+                    for(int j = 0; j < nsupp; ++j, pos += 2) {
+                        supp.push_back(automorphisms[pos]);
+                        p[automorphisms[pos]] = automorphisms[pos + 1];
+                    }
+                    (*hook)(n, p.data(), nsupp, supp.data());
+                    for(const int v : supp) p[v] = v;
+                }
+            }
+        };
+
+        /**
+         * Fingerprint of the input graph and of the settings a checkpoint depends on, such that a checkpoint is only
+         * used to resume the search on the same input.
+         */
+        [[nodiscard]] uint64_t checkpoint_fingerprint(const sgraph* g, const int* colmap) const {
+            const auto bytes = [](const int* arr, const int n) {
+                return std::pair(reinterpret_cast<const char*>(arr), static_cast<size_t>(n) * sizeof(int));
+            };
+            std::vector<std::pair<const char*, size_t>> ranges = {bytes(g->v, g->v_size), bytes(g->d, g->v_size),
+                                                                  bytes(g->e, g->e_size), bytes(colmap, g->v_size)};
+            if(g->ec != nullptr) ranges.push_back(bytes(g->ec, g->e_size));
+            ds::binary_writer settings;
+            settings.value(g->v_size);
+            settings.value(g->e_size);
+            settings.value(h_decompose);
+            settings.value(h_compact_trace);
+            settings.value(ir::hash_128);
+
+            uint64_t h = ds::binary_writer::checksum(settings.data().data(), settings.size());
+            for(const auto& [data, n] : ranges) h = ds::binary_writer::checksum(data, n, h);
+            return h;
+        }
+
+        /**
+         * Prints the counters of the color refinement kernels, if dejavu is compiled with `DEJAVU_PROFILE_REFINEMENT`.
+         */
+        void print_refinement_profile() const {
+            if constexpr (ir::profile_refinement) {
+                if(!h_silent) ir::refinement_profile::global().print(std::cout);
+            }
+        }
     public:
         /**
          * Assuming uniform random numbers, error probability is below `1/2^error_bound`, default value is 10. Thus, the
@@ -118,6 +233,147 @@ namespace dejavu {
             h_decompose = use_decompose;
         }
 
+        /**
+         * Whether automorphisms found by random search are sifted into the Schreier structure on a dedicated thread,
+         * such that search does not wait on Schreier-Sims (default is false).
+         *
+         * @param use_pipeline_sifting (`=true`) whether to use a sifting thread
+         */
+        [[maybe_unused]] void set_pipeline_sifting(bool use_pipeline_sifting = true) {
+            h_pipeline_sifting = use_pipeline_sifting;
+        }
+
+        /**
+         * Number of threads to use in the parallelized parts of the solver (default is 1). The computed results do not
+         * depend on the number of threads.
+         *
+         * @param threads the number of threads
+         */
+        [[maybe_unused]] void set_threads(int threads = 1) {
+            assert(threads >= 1);
+            h_threads = std::max(threads, 1);
+        }
+
+        /**
+         * Whether to calibrate which kernels color refinement uses on each graph (default is false). Before solving,
+         * dives of individualization-refinement are timed using different dispatch thresholds, and the fastest
+         * thresholds are kept for the rest of the solve. Since the result depends on timings, the computed generators
+         * may differ between runs.
+         *
+         * @param autotune (`=true`) whether to calibrate color refinement
+         */
+        [[maybe_unused]] void set_autotune_refinement(bool autotune = true) {
+            h_autotune_refinement = autotune;
+        }
+
+        /**
+         * Sets on which levels of the IR tree breadth-first search keeps the colorings of nodes (default is 1, i.e.,
+         * on every level). On all other levels, nodes only keep their base, and colorings are recomputed from the
+         * nearest ancestor keeping its coloring whenever needed. Larger strides trade time for memory, which allows
+         * breadth-first search on wider levels of the IR tree. Does not change the computed generators.
+         *
+         * @param stride nodes on every \p stride-th level keep their coloring
+         */
+        [[maybe_unused]] void set_bfs_checkpoint_stride(int stride) {
+            h_bfs_checkpoint_stride = std::max(stride, 1);
+        }
+
+        /**
+         * Whether breadth-first search keeps the colorings of nodes as a delta to the coloring of their parent, i.e.,
+         * only the cells changed by individualization and refinement (default is true). Deltas are only used if they
+         * are small, which is the case whenever refinement only splits few cells. Does not change the computed
+         * generators.
+         *
+         * @param delta whether to use deltas
+         */
+        [[maybe_unused]] void set_bfs_delta(bool delta = true) {
+            h_bfs_delta = delta;
+        }
+
+        /**
+         * Allows breadth-first search to spill the colorings of nodes to disk (disabled by default). Whenever the next
+         * level of breadth-first search would exceed the memory limit, colorings of its nodes are instead written
+         * sequentially to a memory-mapped temporary file, as long as the estimated size of the file stays within
+         * \p limit. The file is deleted once the level is discarded. Without spilling, the solver falls back to
+         * random search for such levels.
+         *
+         * @param directory directory in which temporary files are created, an empty string disables spilling
+         * @param limit limit for disk space used by a level, in bytes
+         */
+        [[maybe_unused]] void set_bfs_spill(const std::string& directory, long limit = 0x400000000L) {
+            h_bfs_spill_directory = directory;
+            h_bfs_spill_limit     = std::max(limit, 0L);
+        }
+
+        /**
+         * Configures the cache of color refinement used by random search (default is 2 levels and 64 MB). Random walks
+         * revisit the first levels of the IR tree many times, so the cells computed by color refinement on these
+         * levels are cached and reused. The least recently used results are evicted once the memory budget is
+         * exhausted. Does not change the computed generators.
+         *
+         * @param levels number of levels of the IR tree to cache, 0 disables the cache
+         * @param memory memory budget in bytes
+         */
+        [[maybe_unused]] void set_refinement_cache(int levels, long memory) {
+            h_refinement_cache_levels = std::max(levels, 0);
+            h_refinement_cache_memory = std::max(memory, 0L);
+        }
+
+        /**
+         * Sets the memory budget for colorings of leaves stored by random search (default is 128 MB). Leaves store
+         * their coloring dense while less than half of the budget is used, and compressed afterwards. Once the budget
+         * is exhausted, leaves only store their base, and colorings are recomputed by walking to the leaf whenever
+         * needed. Leaves which are hit frequently are promoted to store their coloring, replacing leaves which were
+         * not hit recently. Does not change the computed generators.
+         *
+         * @param memory memory budget in bytes
+         */
+        [[maybe_unused]] void set_leaf_memory(long memory) {
+            h_leaf_memory = std::max(memory, 0L);
+        }
+
+        /**
+         * Whether to only keep hashes of blocks of the trace of the base, to which all other walks in the IR tree are
+         * compared (default is 0, i.e., the full trace is kept). On large graphs with long bases, the full trace can
+         * use memory comparable to the graph itself, which is reduced by a factor of roughly \p stride / 2. However,
+         * deviations from the trace are detected slightly later, and may occasionally go unnoticed, which costs some
+         * pruning and thus running time. May change the computed generators.
+         *
+         * @param stride number of operations per block, or 0 to keep the full trace
+         */
+        [[maybe_unused]] void set_compact_trace(int stride) {
+            h_compact_trace = std::max(stride, 0);
+        }
+
+        /**
+         * Periodically writes a checkpoint of the search to \p file (disabled by default), from which the search can
+         * be resumed later on (see \a set_resume). Checkpoints are written in between the routines of the search,
+         * i.e., random search, levels of breadth-first search, and restarts, whenever at least \p interval seconds
+         * passed since the last checkpoint. A checkpoint contains the root of the IR tree, the current base, the
+         * levels of breadth-first search, stored leaves, the Schreier structure, the state of the random number
+         * generator, as well as statistics steering the restarts. The file is replaced atomically, and removed once
+         * the solver finishes.
+         *
+         * @param file the file, an empty string disables checkpoints
+         * @param interval minimum time between checkpoints in seconds, 0 writes a checkpoint whenever possible
+         */
+        [[maybe_unused]] void set_checkpoint(const std::string& file, int interval = 600) {
+            h_checkpoint_file     = file;
+            h_checkpoint_interval = std::max(interval, 0);
+        }
+
+        /**
+         * Resumes the search from a checkpoint written by a previous run on the same graph (see \a set_checkpoint).
+         * Automorphisms returned by the previous run are returned again, and the search continues with the state of
+         * the checkpoint, such that finished levels of breadth-first search are not computed again. If the file can
+         * not be read, or was written for a different graph or different settings, the search starts from scratch.
+         *
+         * @param file the file, an empty string disables resuming
+         */
+        [[maybe_unused]] void set_resume(const std::string& file) {
+            h_resume_file = file;
+        }
+
         /**
          * Use 'true random' number generation to set the seed.
          *
@@ -152,6 +408,42 @@ namespace dejavu {
             return s_deterministic_termination;
         }
 
+        /**
+         * How often did random search find a stored leaf with the same hash, which was told apart by the upper 64 bits
+         * of the hash without certification? Only happens if dejavu is compiled with `DEJAVU_HASH_128`.
+         * @return number of hash collisions in the last run
+         */
+        [[maybe_unused]] [[nodiscard]] long get_hash_collisions() const {
+            return s_hash_collisions;
+        }
+
+        /**
+         * How often did random search find a stored leaf with the same hash, which did not lead to an automorphism?
+         * @return number of failed certifications in the last run
+         */
+        [[maybe_unused]] [[nodiscard]] long get_certification_failures() const {
+            return s_cert_failures;
+        }
+
+        /**
+         * How often did random search write a strong invariant (which takes time linear in the size of the graph) to
+         * resolve failed certifications?
+         * @return number of strong invariants written in the last run
+         */
+        [[maybe_unused]] [[nodiscard]] long get_strong_invariants() const {
+            return s_strong_invariants;
+        }
+
+        /**
+         * Did the last run continue the search stored in the checkpoint given to \a set_resume? This is not the case
+         * if the checkpoint could not be read, or if the search of the checkpoint could not be restored, in which case
+         * the search started from scratch.
+         * @return whether the last run resumed from a checkpoint
+         */
+        [[maybe_unused]] [[nodiscard]] bool get_resumed() const {
+            return s_resumed;
+        }
+
         /**
          * Compute the automorphisms of the graph \p g. Automorphisms are returned using the function pointer \p hook.
          *
@@ -183,6 +475,11 @@ namespace dejavu {
             enum termination_strategy {t_prep, t_inproc, t_dfs, t_bfs, t_det_schreier, t_rand_schreier};
             termination_strategy s_term = t_prep;
             s_grp_sz.set(1.0, 0);
+            s_hash_collisions   = 0;
+            s_cert_failures     = 0;
+            s_strong_invariants = 0;
+            s_resumed           = false;
+            if constexpr (ir::profile_refinement) ir::refinement_profile::global().reset();
 
             // want to print progress with a timer, initialize module
             timed_print m_printer;
@@ -196,8 +493,41 @@ namespace dejavu {
                 for(int i = 0; i < g->v_size; ++i) colmap[i] = 0;
             }
 
+            // checkpoints of the search, and resuming from a checkpoint
+            const bool h_checkpoint = !h_checkpoint_file.empty();
+            const auto h_checkpoint_period = std::chrono::seconds(h_checkpoint_interval);
+            auto s_last_checkpoint = std::chrono::steady_clock::now();
+            checkpoint_header m_checkpoint; /*< written to checkpoints, records automorphisms returned so far */
+            ds::binary_reader m_resume;     /*< checkpoint from which the search is resumed */
+            bool s_resuming = false;        /*< still restoring the state of the checkpoint? */
+            if(h_checkpoint || !h_resume_file.empty()) {
+                m_checkpoint.fingerprint = checkpoint_fingerprint(g, colmap);
+                if(!h_resume_file.empty()) {
+                    checkpoint_header resume_header;
+                    m_resume.read_file(h_resume_file);
+                    resume_header.serialize(m_resume);
+                    s_resuming = m_resume.good() && resume_header.fingerprint == m_checkpoint.fingerprint;
+                    if(s_resuming) m_checkpoint = std::move(resume_header);
+                    else m_printer.print("resume failed, starting from scratch");
+                }
+            }
+
+            // automorphisms returned after preprocessing are recorded, such that they can be returned again whenever
+            // the search is resumed from a checkpoint -- of the automorphisms found by random search, only those which
+            // changed the Schreier structure are recorded, since they generate all the others
+            const int s_input_size = g->v_size;
+            bool s_recording   = false;
+            bool s_record_only = false; /*< record an automorphism without returning it (again) */
+            dejavu_hook* user_hook = hook;
+            dejavu_hook recording_hook = [&](int n, const int *p, int nsupp, const int *supp) {
+                if(s_recording) m_checkpoint.record_automorphism(n, p, nsupp, supp);
+                if(!s_record_only) (*user_hook)(n, p, nsupp, supp);
+            };
+            if(h_checkpoint && hook != nullptr) hook = &recording_hook;
+
             // first, we try to preprocess
             preprocessor m_prep(&m_printer); /*< initializes the preprocessor */
+            m_prep.h_threads = h_threads;
 
             // preprocess the graph using sassy
             m_printer.print("preprocessing");
@@ -205,8 +535,16 @@ namespace dejavu {
             s_grp_sz.multiply(m_prep.grp_sz); /*< group size needed if the
                                                *  early out below is used */
 
+            // return the automorphisms of the checkpoint again, group size and statistics are restored once the
+            // search reaches the component of the checkpoint
+            if(s_resuming && user_hook != nullptr) m_checkpoint.replay_automorphisms(s_input_size, user_hook);
+            s_recording = true;
+
             // early-out if preprocessor finished solving the graph
-            if(g->v_size <= 1) return;
+            if(g->v_size <= 1) {
+                print_refinement_profile();
+                return;
+            }
 
             // if the preprocessor changed the vertex set of the graph, need to use reverse translation
             dejavu_hook dhook = preprocessor::_dejavu_hook;
@@ -215,25 +553,64 @@ namespace dejavu {
             // attempt to split into multiple quotient components than can be handled individually
             ir::graph_decomposer m_decompose;
             int s_num_components = 1;
-            if(h_decompose) {
+            if(h_decompose && g->ec == nullptr) { // components do not carry edge colors or arcs
                 // place to store the result of component computation
                 worklist vertex_to_component(g->v_size);
-                // compute the quotient components
-                s_num_components = ir::quotient_components(g, colmap, &vertex_to_component);
-                // make the decomposition according to the quotient components
+                // compute the components, of which isomorphic copies are only kept once
+                s_num_components = m_decompose.isomorphic_components(g, colmap, &vertex_to_component);
+                // make the decomposition according to the components
                 m_decompose.decompose(g, colmap, vertex_to_component, s_num_components);
+                if(m_decompose.is_decomposed()) m_printer.timer_print("decompose", s_num_components,
+                                                                      m_decompose.has_copies());
             }
 
+            // component whose checkpoint turned out to be corrupt, which is then searched again from scratch
+            int s_retry_component = -1;
+
             // run the solver for each of the components separately (tends to be just one component, though)
             for(int i = 0; i < s_num_components; ++i) {
+                // components before the component of the checkpoint are finished already
+                if(s_resuming && i < m_checkpoint.component) continue;
+                const bool s_resume_component = s_resuming && i == m_checkpoint.component;
+                if(s_resume_component) {
+                    s_grp_sz                    = m_checkpoint.grp_sz;
+                    s_deterministic_termination = m_checkpoint.deterministic;
+                    s_hash_collisions           = m_checkpoint.hash_collisions;
+                    s_cert_failures             = m_checkpoint.cert_failures;
+                    s_strong_invariants         = m_checkpoint.strong_invariants;
+                }
+
+                // automorphisms of a component with isomorphic copies are replicated to the copies, which in turn
+                // are written in terms of the graph before decomposition
+                const int s_copies = m_decompose.get_copies(i);
+                dejavu_hook copies_hook = [&m_decompose, &dhook, i](int, const int *p, int nsupp, const int *supp) {
+                    m_decompose.lift_automorphism(i, p, nsupp, supp, &dhook);
+                };
+
                 // if we have multiple components, we need to lift the symmetry back to the original graph
                 // we do so using the lifting routine of the preprocessor
-                if(s_num_components > 1) {
+                if(m_decompose.is_decomposed()) {
                     g      = m_decompose.get_component(i);     // graph of current component
                     colmap = m_decompose.get_colmap(i);        // vertex coloring of current component
-                    m_prep.inject_decomposer(&m_decompose, i); // set translation to current component
+                    if(s_copies > 1) {
+                        m_prep.inject_decomposer(nullptr, 0);  // copies are lifted to the decomposed graph
+                        hook = &copies_hook;
+
+                        // automorphisms permuting the copies, contributing a factor of `s_copies!` to the group size
+                        // (already contained in the checkpoint, if resuming)
+                        if(!s_resume_component && i != s_retry_component) {
+                            m_decompose.swap_copies(i, &dhook);
+                            for(int j = 2; j <= s_copies; ++j) s_grp_sz.multiply(j);
+                        }
+                    } else {
+                        m_prep.inject_decomposer(&m_decompose, i); // set translation to current component
+                        hook = &dhook;
+                    }
                 }
 
+                // components consisting of a single vertex have no further automorphisms
+                if(g->v_size <= 1) continue;
+
                 // print that we are solving now...
                 m_printer.h_silent = h_silent || (g->v_size <= 128 && i != 0);
                 if(!m_printer.h_silent)
@@ -243,6 +620,8 @@ namespace dejavu {
 
                 // flag to denote which color refinement version is used
                 g->dense = !(g->e_size < g->v_size || g->e_size / g->v_size < g->v_size / (g->e_size / g->v_size));
+                g->dense_dense_factor = 1.0;
+                g->dense_cell_factor  = 1.0;
 
                 // settings of heuristics
                 int h_budget          = 1;  /*< budget of current restart iteration    */
@@ -276,12 +655,23 @@ namespace dejavu {
                 // local modules and workspace, to be used by other modules
                 ir::cell_selector_factory m_selectors; /*< cell selector creation */
                 ir::refinement        m_refinement;    /*< workspace for color refinement and other utilities */
+                m_refinement.h_threads = h_threads;
+                if(h_autotune_refinement) {
+                    coloring calibration_coloring;
+                    g->initialize_coloring(&calibration_coloring, colmap);
+                    m_refinement.calibrate_dispatch(g, &calibration_coloring); /*< fixes kernels for this graph */
+                    std::stringstream factors;
+                    factors << std::setprecision(2) << g->dense_dense_factor << "/" << g->dense_cell_factor;
+                    m_printer.timer_print("calibrate", g->dense ? "dense" : "sparse", factors.str());
+                }
+                if(g->dense) m_refinement.build_bit_matrix(g); /*< adjacency matrix for very dense graphs */
                 groups::domain_compressor m_compress;/*< can compress a workspace of vertices to a subset of vertices */
                 groups::automorphism_workspace automorphism(g->v_size); /*< workspace to keep an automorphism */
                 groups::schreier_workspace     schreierw(g->v_size);    /*< workspace for Schreier-Sims */
 
                 // shared, global modules
                 ir::shared_tree sh_tree(g->v_size);      /*< BFS levels, shared leaves, ...           */
+                sh_tree.stored_leaves.h_memory_budget = h_leaf_memory;
                 groups::compressed_schreier sh_schreier; /*< Schreier structure to sift automorphisms */
                 sh_schreier.set_error_bound(h_error_bound);
 
@@ -292,7 +682,21 @@ namespace dejavu {
                 search_strategy::dfs_ir      m_dfs(m_printer, automorphism); /*< depth-first search */
                 search_strategy::bfs_ir      m_bfs(m_printer, automorphism, schreierw); /*< breadth-first search */
                 search_strategy::random_ir   m_rand(m_printer, schreierw, automorphism, rng); /*< randomized search */
+                m_rand.h_pipeline_sifting = h_pipeline_sifting;
+                dejavu_hook record_group_change = [&](int n, const int *p, int nsupp, const int *supp) {
+                    const bool prev_recording = s_recording;
+                    s_recording   = true;
+                    s_record_only = true;
+                    (*hook)(n, p, nsupp, supp);
+                    s_recording   = prev_recording;
+                    s_record_only = false;
+                };
+                if(h_checkpoint && user_hook != nullptr) m_rand.h_group_hook = &record_group_change;
+                m_bfs.h_checkpoint_stride = h_bfs_checkpoint_stride;
+                m_bfs.h_use_delta         = h_bfs_delta;
+                sh_tree.h_spill_directory = h_bfs_spill_directory;
                 search_strategy::inprocessor m_inprocess; /*< inprocessing */
+                m_inprocess.h_threads = h_threads;
 
                 // initialize a coloring using colors of preprocessed graph
                 coloring local_coloring;
@@ -300,6 +704,13 @@ namespace dejavu {
                 g->initialize_coloring(&local_coloring, colmap);
                 const bool s_regular = local_coloring.cells == 1; /*< is this graph regular? */
 
+                // the (equitable) coloring of the component is discrete, so the component has no automorphisms --
+                // this happens for copies of rigid components, which only contribute the swaps of the copies
+                if(local_coloring.cells == g->v_size) {
+                    m_printer.timer_print("discrete", g->v_size, s_copies);
+                    continue;
+                }
+
                 // set up a local state for IR computations
                 ir::controller local_state(&m_refinement,      &local_coloring); /*< controls movement in IR tree*/
                 ir::controller local_state_left(&m_refinement, &local_coloring_left);
@@ -307,6 +718,8 @@ namespace dejavu {
                 // set deviation counter relative to graph size
                 local_state.set_increase_deviation(std::min(static_cast<int>(floor(3 * sqrt(g->v_size))), 128));
                 local_state.reserve(); // reserve some space
+                local_state.set_refinement_cache(h_refinement_cache_levels, h_refinement_cache_memory);
+                local_state.use_compact_trace(h_compact_trace);
 
                 // save root state for random and BFS search, as well as restarts
                 ir::limited_save root_save;
@@ -314,6 +727,57 @@ namespace dejavu {
                 int s_last_base_size = g->v_size + 1;      /*< v_size + 1 is larger than any actual base_vertex*/
                 int dfs_level = -1; /*< level up to which depth-first search was performed */
 
+                // state steering the restarts, which is written to checkpoints as of the beginning of the current
+                // restart iteration
+                auto restart_locals = [&](auto& ar) {
+                    ar.value(h_budget);
+                    ar.value(h_budget_inc_fact);
+                    ar.value(s_restarts);
+                    ar.value(s_inproc_success);
+                    ar.value(s_cost);
+                    ar.value(s_long_base);
+                    ar.value(s_short_base);
+                    ar.value(s_prunable);
+                    ar.value(s_random_budget_bias);
+                    ar.value(h_used_shallow_inprocess);
+                    ar.value(h_used_shallow_inprocess_quadratic);
+                    ar.value(s_inprocessed);
+                    ar.value(s_consecutive_discard);
+                    ar.value(s_last_bfs_pruned);
+                    ar.value(s_any_bfs_pruned);
+                    s_last_tree_sz.serialize(ar);
+                    ar.values(base_vertex);
+                    ar.values(base_sizes);
+                    ar.value(s_last_base_size);
+                    ar.value(dfs_level);
+                };
+                ds::binary_writer s_restart_snapshot;
+                std::vector<int>  s_resume_base; /*< base of the checkpoint */
+
+                // resume from the checkpoint: the restart iteration of the checkpoint is repeated up to the point
+                // where the checkpoint was written, recomputing the base and the comparison trace, but restoring the
+                // results of the search
+                if(s_resume_component) {
+                    root_save.serialize(m_resume, [](long) -> ir::limited_save* { return nullptr; },
+                                        [](int) -> int* { return nullptr; });
+                    std::string snapshot;
+                    m_resume.value(snapshot);
+                    ds::binary_reader restart_reader(std::move(snapshot));
+                    restart_locals(restart_reader);
+                    m_inprocess.serialize(m_resume);
+                    m_resume.values(s_resume_base);
+                    s_resuming = m_resume.good() && restart_reader.good();
+                    if(!s_resuming) {
+                        m_printer.print("resume failed, checkpoint is corrupt");
+                        s_retry_component = i;
+                        --i; /*< search the component again, from scratch */
+                        continue;
+                    }
+                    local_state.load_reduced_state(root_save);
+                    m_printer.timer_print("resume", s_restarts + 1, static_cast<int>(s_resume_base.size()));
+                }
+                bool s_resume_failed = false; /*< checkpoint turned out to be corrupt during the restart loop */
+
                 // now that we are set up, let's start solving the graph
                 // loop for restarts
                 while (true) {
@@ -321,6 +785,11 @@ namespace dejavu {
                     const bool s_hard = h_budget   > 256; /* graph is "hard" (was 10000)*/
                     const bool s_easy = s_restarts == -1; /* graph is "easy" */
 
+                    if(h_checkpoint) {
+                        s_restart_snapshot.clear();
+                        restart_locals(s_restart_snapshot);
+                    }
+
                     ++s_restarts; /*< increase the restart counter */
                     if (s_restarts > 0) {
                         // now, we manage the restart....
@@ -348,6 +817,14 @@ namespace dejavu {
                     auto selector = m_selectors.get_selector_hook();
                     m_printer.timer_print("sel", local_state.s_base_pos, local_state.T->get_position());
 
+                    // the base should be the base of the checkpoint -- if not, the search of the checkpoint can not be
+                    // used, and we continue with a regular restart iteration (from the restored root)
+                    if(s_resuming && local_state.base_vertex != s_resume_base) {
+                        m_printer.print("resume failed, base differs from checkpoint");
+                        s_resuming = false;
+                        base_vertex.clear(); /*< repeats depth-first search */
+                    }
+
                     // statistics of this base
                     const int        base_size       = local_state.s_base_pos; /*< base length */
                     const big_number s_tree_estimate = m_selectors.get_ir_size_estimate(); /*< size estimate of tree */
@@ -389,9 +866,20 @@ namespace dejavu {
                     // we first perform a depth-first search, starting from the computed leaf in local_state
                     m_dfs.h_recent_cost_snapshot_limit  = s_long_base ? 0.33 : 0.25; // set up DFS heuristic
                     //m_dfs.h_recent_cost_snapshot_limit = 1.0;
-                    dfs_level = s_last_base_eq ? dfs_level : m_dfs.do_paired_dfs(hook, g, local_state_left, local_state,
-                                                                                 m_inprocess.inproc_maybe_individualize,
-                                                                                 base_size > 1 || s_restarts > 0);
+                    if(s_resuming) {
+                        m_resume.value(dfs_level);
+                        m_dfs.serialize(m_resume);
+                        m_resume.values(m_inprocess.inproc_maybe_individualize);
+                        if(!m_resume.good()) {
+                            s_resume_failed = true;
+                            break;
+                        }
+                    } else {
+                        dfs_level = s_last_base_eq ? dfs_level :
+                                    m_dfs.do_paired_dfs(hook, g, local_state_left, local_state,
+                                                        m_inprocess.inproc_maybe_individualize,
+                                                        base_size > 1 || s_restarts > 0);
+                    }
 
                     m_printer.timer_print("dfs", std::to_string(base_size) + "-" + std::to_string(dfs_level),
                                    "~" + std::to_string((int) m_dfs.s_grp_sz.mantissa) + "*10^" +
@@ -458,7 +946,56 @@ namespace dejavu {
                     h_rand_fail_lim_now = 4; /*< how many failures are allowed during random leaf search */
                     last_routine = restart;
 
+                    // state of the search, which is restored from or written to checkpoints
+                    auto search_locals = [&](auto& ar) {
+                        ar.value(s_cost);
+                        ar.value(s_last_bfs_pruned);
+                        ar.value(s_any_bfs_pruned);
+                        ar.value(h_rand_fail_lim_total);
+                        ar.value(h_rand_fail_lim_now);
+                        ar.value(s_path_fail1_avg);
+                        ar.value(last_routine);
+                        sh_schreier.serialize(ar, &m_compress);
+                        m_rand.serialize(ar);
+                        m_bfs.serialize(ar);
+                        rng.serialize(ar);
+                    };
+                    if(s_resuming) {
+                        search_locals(m_resume);
+                        sh_tree.serialize(m_resume, &root_save);
+                        s_resuming = false;
+                        if(!m_resume.good() || !m_resume.at_end()) {
+                            s_resume_failed = true;
+                            break;
+                        }
+                        s_resumed = true;
+                    }
+
                     while (!do_a_restart && !finished_symmetries) {
+                        // write a checkpoint, from which the search can be resumed later on
+                        if(h_checkpoint && std::chrono::steady_clock::now() - s_last_checkpoint >= h_checkpoint_period) {
+                            ds::binary_writer out;
+                            m_checkpoint.component = i;
+                            m_checkpoint.grp_sz    = s_grp_sz;
+                            m_checkpoint.deterministic     = s_deterministic_termination;
+                            m_checkpoint.hash_collisions   = s_hash_collisions;
+                            m_checkpoint.cert_failures     = s_cert_failures;
+                            m_checkpoint.strong_invariants = s_strong_invariants;
+                            m_checkpoint.serialize(out);
+                            root_save.serialize(out, [](const ir::limited_save*) { return 0L; });
+                            out.value(s_restart_snapshot.data());
+                            m_inprocess.serialize(out);
+                            out.values(base_vertex);
+                            out.value(dfs_level);
+                            m_dfs.serialize(out);
+                            out.values(m_inprocess.inproc_maybe_individualize);
+                            search_locals(out);
+                            sh_tree.serialize(out);
+                            if(out.write_file(h_checkpoint_file)) m_printer.timer_print("checkpoint", i + 1,
+                                                                                         static_cast<int>(out.size()));
+                            s_last_checkpoint = std::chrono::steady_clock::now();
+                        }
+
                         // What do we do next? Random search, BFS, or a restart?
                         // here are our decision heuristics (AKA dark magic)
 
@@ -485,7 +1022,9 @@ namespace dejavu {
                             // now that we have some data, we attempt to model how effective and costly random search
                             // and BFS is, to then make an informed decision of what to do next
                             const double reset_cost_rand = g->v_size;
-                            const double reset_cost_bfs = std::min(s_trace_cost1_avg, (double) g->v_size);
+                            // (base-only nodes are recomputed from their checkpoint)
+                            const double reset_cost_bfs = std::min(s_trace_cost1_avg, (double) g->v_size) +
+                                    s_trace_cost1_avg * m_bfs.recompute_estimate(sh_tree.get_finished_up_to());
                             double s_bfs_estimate  = (s_trace_cost1_avg + reset_cost_bfs) * (s_bfs_next_level_nodes);
                             double s_rand_estimate = (s_random_path_trace_cost + reset_cost_rand) * h_rand_fail_lim_now;
 
@@ -516,9 +1055,21 @@ namespace dejavu {
                                                        * lot! */
 
                         // let's stick to the memory limits...
-                        const long s_bfs_est_mem = (long) round(s_bfs_next_level_nodes * (1 - s_path_fail1_avg) *
-                                                                g->v_size);
-                        if (next_routine == bfs_ir && (s_bfs_est_mem > h_bfs_memory_limit)) next_routine = random_ir;
+                        const int  s_bfs_next_level = sh_tree.get_finished_up_to() + 1;
+                        const double s_bfs_node_mem = m_bfs.node_memory_estimate(s_bfs_next_level, g->v_size);
+                        const double s_bfs_est_nodes = s_bfs_next_level_nodes * (1 - s_path_fail1_avg);
+                        const long s_bfs_est_mem = (long) round(s_bfs_est_nodes * s_bfs_node_mem);
+                        m_bfs.h_spill = false;
+                        if (next_routine == bfs_ir && (s_bfs_est_mem > h_bfs_memory_limit)) {
+                            // ...but we may be able to spill the colorings of the next level to disk
+                            const long s_bfs_est_mem_spill = (long) round(s_bfs_est_nodes *
+                                                      m_bfs.node_memory_estimate(s_bfs_next_level, g->v_size, true));
+                            const double s_bfs_est_disk = s_bfs_est_nodes * sizeof(int) *
+                                                          m_bfs.node_spill_estimate(s_bfs_next_level, g->v_size);
+                            m_bfs.h_spill = sh_tree.can_spill() && s_bfs_est_mem_spill <= h_bfs_memory_limit &&
+                                            s_bfs_est_disk <= (double) h_bfs_spill_limit;
+                            if (!m_bfs.h_spill) next_routine = random_ir;
+                        }
 
                         // let's stick to the budget...
                         if (s_cost > h_budget) next_routine = restart; /*< we exceeded our budget, restart */
@@ -578,6 +1129,7 @@ namespace dejavu {
                                 m_rand.use_look_close(h_look_close);
                                 m_rand.h_sift_random     = !s_easy;
                                 m_rand.h_randomize_up_to = dfs_level;
+                                s_recording = false; /*< only changes of the Schreier structure are recorded */
                                 if (sh_tree.get_finished_up_to() == 0 || (s_long_base && !s_any_bfs_pruned)) {
                                     // random automorphisms, sampled from root of IR tree
                                     m_rand.random_walks(g, hook, selector, sh_tree, sh_schreier, local_state,
@@ -588,6 +1140,7 @@ namespace dejavu {
                                                                   local_state, local_state_left,
                                                                   h_rand_fail_lim_total);
                                 }
+                                s_recording = true;
                                 finished_symmetries = sh_schreier.any_abort_criterion();
                                 s_term = sh_schreier.deterministic_abort_criterion()? t_det_schreier : t_rand_schreier;
                                 s_cost += h_rand_fail_lim_now;
@@ -686,19 +1239,44 @@ namespace dejavu {
                     }
                 } // end of restart loop
 
+                // the checkpoint was corrupt, search the component again, from scratch
+                if(s_resume_failed) {
+                    m_printer.print("resume failed, checkpoint is corrupt");
+                    s_resuming        = false;
+                    s_retry_component = i;
+                    --i;
+                    continue;
+                }
+
                 // we are done with this component...
+                // ...how often did leaves of random search collide?
+                s_hash_collisions   += sh_tree.stored_leaves.s_collisions;
+                s_cert_failures     += sh_tree.stored_leaves.s_cert_failures;
+                s_strong_invariants += sh_tree.stored_leaves.s_strong_invariants;
+                if(sh_tree.stored_leaves.s_collisions + sh_tree.stored_leaves.s_cert_failures > 0) {
+                    m_printer.timer_print("collisions", "h" + std::to_string(sh_tree.stored_leaves.s_collisions) +
+                                          "/c" + std::to_string(sh_tree.stored_leaves.s_cert_failures),
+                                          "s" + std::to_string(sh_tree.stored_leaves.s_strong_invariants));
+                }
+
                 // ...did we solve it deterministically?
                 s_deterministic_termination = (s_term != t_rand_schreier) && s_deterministic_termination;
 
                 // let's add up the total group size from all the different modules.
-                s_grp_sz.multiply(m_inprocess.s_grp_sz);
-                s_grp_sz.multiply(m_dfs.s_grp_sz);
+                big_number s_component_grp_sz;
+                s_component_grp_sz.multiply(m_inprocess.s_grp_sz);
+                s_component_grp_sz.multiply(m_dfs.s_grp_sz);
 
                 // if we finished with BFS, group size in Schreier is redundant since we also found them with BFS
-                if(s_term != t_bfs) s_grp_sz.multiply(sh_schreier.get_group_size());
+                if(s_term != t_bfs) s_component_grp_sz.multiply(sh_schreier.get_group_size());
+
+                // each isomorphic copy of the component contributes the same group size
+                for(int j = 0; j < s_copies; ++j) s_grp_sz.multiply(s_component_grp_sz);
             } // end of loop for non-uniform components
+            if(h_checkpoint) std::remove(h_checkpoint_file.c_str()); /*< finished, checkpoint not needed anymore */
             m_printer.h_silent = h_silent;
             m_printer.timer_print("done", s_deterministic_termination, s_term);
+            print_refinement_profile();
         }
     };
 
@@ -784,6 +1362,60 @@ namespace dejavu {
             }
         };
 
+        /**
+         * \brief Writes to an ostream, in terms of literals
+         *
+         * Hook that writes all the given symmetries of a literal-clause graph (see \a parse_dimacs_cnf) to the given
+         * output stream, as permutations of literals in DIMACS notation. Clauses are omitted.
+         */
+        class literal_ostream_hook {
+        private:
+            dejavu_hook   my_hook;
+            std::ostream& my_ostream;
+            int           my_variables;
+            dejavu::ds::markset  test_set;
+
+            [[nodiscard]] int literal(const int v) const {
+                return (v & 1) ? -(v / 2 + 1) : (v / 2 + 1);
+            }
+
+            void hook_func(int n, const int *p, int nsupp, const int *supp) {
+                test_set.initialize(n);
+                test_set.reset();
+                bool moves_literals = false;
+                for(int i = 0; i < nsupp; ++i) {
+                    const int v_from = supp[i];
+                    if(v_from >= 2 * my_variables || test_set.get(v_from)) continue;
+                    int v_next = p[v_from];
+                    if(v_from == v_next) continue;
+                    test_set.set(v_from);
+                    moves_literals = true;
+                    my_ostream << "(" << literal(v_from);
+                    while(!test_set.get(v_next)) {
+                        test_set.set(v_next);
+                        my_ostream << " " << literal(v_next);
+                        v_next = p[v_next];
+                    }
+                    my_ostream << ")";
+                }
+                if(moves_literals) my_ostream << std::endl; // symmetries only permuting clauses are not written
+            }
+        public:
+            /**
+             * @param ostream the output stream
+             * @param variables number of variables of the formula, as returned by \a parse_dimacs_cnf
+             */
+            literal_ostream_hook(std::ostream& ostream, int variables) : my_ostream(ostream), my_variables(variables) {}
+
+            dejavu_hook* get_hook() {
+                my_hook = [this](auto && PH1, auto && PH2, auto && PH3, auto && PH4)
+                { return hook_func(std::forward<decltype(PH1)>(PH1), std::forward<decltype(PH2)>(PH2),
+                                   std::forward<decltype(PH3)>(PH3), std::forward<decltype(PH4)>(PH4));
+                };
+                return &my_hook;
+            }
+        };
+
         /**
          * \brief Certification on the original graph
          *
@@ -799,11 +1431,13 @@ namespace dejavu {
             dejavu_hook  my_hook;
             dejavu_hook* my_call_hook;
             markset scratch_set;
+            workspace edge_color_scratch;
 
             sgraph my_g;
 
             void hook_func(int n, const int *p, int nsupp, const int *supp) {
-                const bool certify = ir::certification::certify_automorphism_sparse(scratch_set, &my_g, p, nsupp, supp);
+                const bool certify = ir::certification::certify_automorphism_sparse(scratch_set, &my_g, p, nsupp, supp,
+                                                                                    &edge_color_scratch);
                 if(!certify) return;
                 (*my_call_hook)(n, p, nsupp, supp);
             }
@@ -812,12 +1446,14 @@ namespace dejavu {
                 my_g.copy_graph(g.get_sgraph());
                 my_call_hook = call_hook;
                 scratch_set.initialize(g.get_sgraph()->v_size);
+                edge_color_scratch.resize(g.get_sgraph()->v_size);
             }
 
             explicit strong_certification_hook(sgraph& g, dejavu_hook* call_hook) {
                 my_g.copy_graph(&g);
                 my_call_hook = call_hook;
                 scratch_set.initialize(g.v_size);
+                edge_color_scratch.resize(g.v_size);
             }
 
             dejavu_hook* get_hook() {
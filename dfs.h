@@ -52,7 +52,10 @@ namespace dejavu {
                                              bool recurse=false) {
                 if(!recurse) {
                     const bool is_diffed_pre = state_right.update_diff_vertices_last_individualization(state_left);
-                    if (!is_diffed_pre || state_right.get_diff_diverge()) return 2;
+                    // diverging colorings can not be mapped onto each other, so the node can be pruned...
+                    if (state_right.get_diff_diverge()) return 2;
+                    // ...but without any difference to follow, we can not decide whether there is an automorphism
+                    if (!is_diffed_pre) return 0;
                 }
 
                 while (state_right.c->cells < g->v_size) {
@@ -116,6 +119,17 @@ namespace dejavu {
 
             groups::orbit orbs;
 
+            /**
+             * Stores or restores the result of the last search, i.e., the group size and orbits.
+             */
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(cost_snapshot);
+                ar.value(s_termination);
+                s_grp_sz.serialize(ar);
+                orbs.serialize(ar);
+            }
+
             int do_paired_dfs(dejavu_hook* hook, sgraph *g, ir::controller &state_left, ir::controller& state_right,
                               std::vector<std::pair<int, int>>& computed_orbits, bool prune = true) {
                 if(h_recent_cost_snapshot_limit < 0) return state_right.s_base_pos;
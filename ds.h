@@ -10,8 +10,24 @@
 #include <cstring>
 #include <functional>
 #include <cassert>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <mutex>
+#include <string>
+#include <fstream>
+#include <cstdio>
 #include "coloring.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define DEJAVU_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace dejavu {
 
     /**
@@ -33,6 +49,31 @@ namespace dejavu {
             std::sort(arr, arr + sz);
         }
 
+        /**
+         * Least-significant-digit radix sort for non-negative integer keys, using one counting sort pass per byte of
+         * \p bound. Beats \a sort_t for arrays of a few hundred elements or more, since the number of passes only
+         * depends on \p bound.
+         *
+         * @tparam T Template parameter for the type of array elements, must be an integer type.
+         * @param arr Array of elements of type \p T, all elements must be in `[0, bound)`.
+         * @param buf Scratch space of at least length \p sz.
+         * @param sz Length of the array \p arr.
+         * @param bound Upper bound on the elements of \p arr.
+         */
+        template<class T>
+        void inline sort_radix_t(T *arr, T *buf, int sz, T bound) {
+            T *in  = arr;
+            T *out = buf;
+            for (int shift = 0; shift < static_cast<int>(sizeof(T) * 8) && (bound - 1) >> shift; shift += 8) {
+                int bucket[257] = {0};
+                for (int i = 0; i < sz; ++i) ++bucket[((in[i] >> shift) & 255) + 1];
+                for (int i = 0; i < 256; ++i) bucket[i + 1] += bucket[i];
+                for (int i = 0; i < sz; ++i) out[bucket[(in[i] >> shift) & 255]++] = in[i];
+                std::swap(in, out);
+            }
+            if (in != arr) memcpy(arr, in, sz * sizeof(T));
+        }
+
         /**
          * \brief Stack datastructure
          *
@@ -103,6 +144,8 @@ namespace dejavu {
                 //if(arr) free(arr);
                 if(arr) delete[] arr;
                 arr = nullptr;
+                if(buf) delete[] buf;
+                buf = nullptr;
             }
 
         public:
@@ -131,6 +174,22 @@ namespace dejavu {
                 cur_pos = other->cur_pos;
             }
 
+            /**
+             * Stores or restores the array, including \a cur_pos. All elements of the array are stored, which
+             * therefore must be initialized.
+             */
+            template<class A>
+            void serialize(A& ar) {
+                int sz = arr_sz;
+                ar.value(sz);
+                ar.value(cur_pos);
+                if constexpr (A::reading) {
+                    if(!ar.good() || sz < 0) return;
+                    if(sz != arr_sz || arr == nullptr) alloc(sz);
+                }
+                ar.values(arr, sz);
+            }
+
             /**
              * Allocates the internal array with size \p size. The allocated memory is not
              * initialized. Initializes the internal position \a cur_pos of the array at 0.
@@ -239,6 +298,22 @@ namespace dejavu {
                 sort_t<T>(arr, cur_pos);
             }
 
+            /**
+             * Sort the internal array up to position \a cur_pos, where all elements are integers in `[0, bound)`.
+             * Uses \a sort_radix_t from \p radix_min elements onwards, and \a sort_t otherwise.
+             *
+             * @param bound Upper bound on the elements.
+             * @param radix_min Minimum number of elements for which radix sort is used.
+             */
+            void sort(const T bound, const int radix_min) {
+                if (cur_pos < radix_min) {
+                    sort_t<T>(arr, cur_pos);
+                    return;
+                }
+                if (!buf) buf = new T[arr_sz];
+                sort_radix_t<T>(arr, buf, cur_pos, bound);
+            }
+
             /**
              * @return A pointer to the internal memory.
              */
@@ -278,6 +353,7 @@ namespace dejavu {
         private:
             int arr_sz = 0;       /**< size to which \a arr is currently allocated*/
             T *arr     = nullptr; /**< internal array */
+            T *buf     = nullptr; /**< scratch space for radix sort, allocated on first use */
         };
 
         typedef worklist_t<int> worklist;
@@ -563,6 +639,838 @@ namespace dejavu {
                 if(s) free(s);
             }
         };
+
+        /**
+         * \brief Bit matrix
+         *
+         * Square matrix of bits, e.g., the adjacency matrix of a dense graph. Each row is padded to a multiple of 64 bits,
+         * such that rows can be combined word-wise.
+         */
+        class bit_matrix {
+            std::vector<uint64_t> bits;
+            int sz = 0;
+            int words = 0;
+
+        public:
+            /**
+             * Initializes a matrix with \p size rows and columns, where all bits are unset.
+             *
+             * @param size number of rows and columns
+             */
+            void initialize(int size) {
+                assert(size >= 0);
+                sz    = size;
+                words = (size + 63) / 64;
+                bits.assign(static_cast<size_t>(sz) * words, 0);
+            }
+
+            /**
+             * Sets the bit in row \p row and column \p col.
+             */
+            inline void set(int row, int col) {
+                assert(row >= 0 && row < sz && col >= 0 && col < sz);
+                bits[static_cast<size_t>(row) * words + (col >> 6)] |= uint64_t(1) << (col & 63);
+            }
+
+            /**
+             * @return Is the bit in row \p row and column \p col set?
+             */
+            inline bool get(int row, int col) const {
+                assert(row >= 0 && row < sz && col >= 0 && col < sz);
+                return (bits[static_cast<size_t>(row) * words + (col >> 6)] >> (col & 63)) & 1;
+            }
+
+            /**
+             * @return the words of row \p row
+             */
+            inline const uint64_t* row(int row) const {
+                assert(row >= 0 && row < sz);
+                return bits.data() + static_cast<size_t>(row) * words;
+            }
+
+            /**
+             * @return number of 64-bit words in each row
+             */
+            [[nodiscard]] int row_words() const {
+                return words;
+            }
+
+            /**
+             * @return number of rows (and columns) of the matrix
+             */
+            [[nodiscard]] int size() const {
+                return sz;
+            }
+
+            /**
+             * Releases the memory of the matrix.
+             */
+            void clear() {
+                sz    = 0;
+                words = 0;
+                std::vector<uint64_t>().swap(bits);
+            }
+        };
+
+        /**
+         * \brief Arena of objects
+         *
+         * Objects are constructed in chunks of contiguous memory by bumping a pointer, and can only be freed all at once
+         * using \a clear. This avoids the overhead of allocating and freeing many small objects individually. Chunks
+         * grow geometrically, up to a fixed size.
+         *
+         * Objects stay at their address until the arena is cleared. Objects constructed using \a create are destroyed
+         * when the arena is cleared, arrays allocated using \a allocate are not (and thus require a trivially
+         * destructible type).
+         *
+         * @tparam T Type of objects stored in the arena.
+         */
+        template<class T>
+        class arena {
+            struct chunk {
+                T*  data;
+                int capacity;
+                int used;
+            };
+
+            static constexpr int chunk_min = 64;    /**< capacity of the first chunk, in objects     */
+            static constexpr int chunk_max = 65536; /**< maximum capacity of chunks, in objects      */
+
+            std::vector<chunk> chunks;
+            long s_objects = 0; /**< number of objects in the arena          */
+            long s_memory  = 0; /**< bytes of memory reserved by the chunks  */
+
+            void add_chunk(const int min_capacity) {
+                const int next_capacity = chunks.empty() ? chunk_min : std::min(2 * chunks.back().capacity, chunk_max);
+                const int capacity = std::max(next_capacity, min_capacity);
+                chunks.push_back({std::allocator<T>().allocate(capacity), capacity, 0});
+                s_memory += static_cast<long>(capacity) * static_cast<long>(sizeof(T));
+            }
+
+            T* bump(const int n) {
+                if(chunks.empty() || chunks.back().capacity - chunks.back().used < n) add_chunk(n);
+                chunk& last = chunks.back();
+                T* ptr = last.data + last.used;
+                last.used += n;
+                s_objects += n;
+                return ptr;
+            }
+
+        public:
+            arena() = default;
+            arena(const arena&) = delete;
+            arena& operator=(const arena&) = delete;
+            arena(arena&& other) noexcept :
+                    chunks(std::move(other.chunks)), s_objects(other.s_objects), s_memory(other.s_memory) {
+                other.chunks.clear();
+                other.s_objects = 0;
+                other.s_memory  = 0;
+            }
+
+            /**
+             * Constructs an object in the arena.
+             *
+             * @param args Arguments passed to the constructor of the object.
+             * @return Pointer to the object, valid until the arena is cleared.
+             */
+            template<class... Args>
+            T* create(Args&&... args) {
+                return new (bump(1)) T(std::forward<Args>(args)...);
+            }
+
+            /**
+             * Allocates a contiguous array in the arena. The contents of the array are not initialized.
+             *
+             * @param n Number of elements of the array.
+             * @return Pointer to the array, valid until the arena is cleared.
+             */
+            T* allocate(const int n) {
+                static_assert(std::is_trivially_destructible_v<T>);
+                assert(n >= 0);
+                return bump(n);
+            }
+
+            /**
+             * Destroys all objects in the arena, and releases its memory.
+             */
+            void clear() {
+                for(chunk& ch : chunks) {
+                    if constexpr (!std::is_trivially_destructible_v<T>) {
+                        for(int i = 0; i < ch.used; ++i) ch.data[i].~T();
+                    }
+                    std::allocator<T>().deallocate(ch.data, ch.capacity);
+                }
+                chunks.clear();
+                s_objects = 0;
+                s_memory  = 0;
+            }
+
+            /**
+             * @return Number of objects in the arena.
+             */
+            [[nodiscard]] long size() const {
+                return s_objects;
+            }
+
+            /**
+             * @return Bytes of memory reserved by the arena (not including memory owned by the objects themselves).
+             */
+            [[nodiscard]] long memory() const {
+                return s_memory;
+            }
+
+            ~arena() {
+                clear();
+            }
+        };
+
+        /**
+         * \brief Concurrent hash table mapping 64-bit hashes to pointers
+         *
+         * Open addressing with linear probing on a flat array of slots. Lookups and inserts can be called by multiple
+         * threads concurrently, and do not take locks: a slot is claimed by a compare-and-swap, and published once its
+         * key is written. Keys can not be removed, other than by clearing the table.
+         *
+         * Keys are expected to be hashes already. Keys which only differ in their lowest \a group_bits bits are mapped
+         * to neighbouring slots, such that probing for `h`, `h + 1`, `h + 2`, ..., which is used to resolve collisions
+         * of hashes of IR leaves, stays within a few cache lines.
+         *
+         * Whenever the table is half full, it is replaced by a table of twice the size. Inserts wait while the
+         * entries are moved, lookups continue to use the previous table. Previous tables are kept until the table is
+         * cleared, such that concurrent lookups never read freed memory.
+         *
+         * @tparam T Type of objects pointed to by values, values must not be `nullptr`.
+         */
+        template<class T>
+        class hash_table {
+            static constexpr int group_bits = 5; /**< keys differing in these bits are placed in neighbouring slots */
+            static constexpr int initial_capacity = 64;
+
+            struct slot {
+                std::atomic<uint64_t> key   = 0;
+                std::atomic<T*>       value = nullptr; /**< `nullptr` if empty, \a busy while the key is written */
+            };
+
+            struct table {
+                std::unique_ptr<slot[]> slots;
+                uint64_t mask;
+                explicit table(const uint64_t capacity) : slots(new slot[capacity]), mask(capacity - 1) {}
+            };
+
+            static T* busy() {
+                return reinterpret_cast<T*>(uintptr_t(1));
+            }
+
+            static uint64_t home(const uint64_t key) {
+                uint64_t h = key >> group_bits;
+                h ^= h >> 33;
+                h *= 0xff51afd7ed558ccdULL;
+                h ^= h >> 33;
+                return (h << group_bits) + (key & ((uint64_t(1) << group_bits) - 1));
+            }
+
+            std::vector<std::unique_ptr<table>> tables; /**< current table last, previous tables before */
+            std::atomic<table*> current = nullptr;
+            std::atomic<long>   s_size  = 0;
+            std::atomic<int>    active_inserts = 0;
+            std::atomic<bool>   resizing = false;
+            std::mutex          resize_lock;
+
+            static T* find_in(const table* t, const uint64_t key) {
+                for(uint64_t pos = home(key) & t->mask;; pos = (pos + 1) & t->mask) {
+                    const slot& sl = t->slots[pos];
+                    T* value = sl.value.load(std::memory_order_acquire);
+                    if(value == nullptr) return nullptr;
+                    while(value == busy()) value = sl.value.load(std::memory_order_acquire);
+                    if(sl.key.load(std::memory_order_relaxed) == key) return value;
+                }
+            }
+
+            // returns the value stored for key, and whether value was inserted
+            static std::pair<T*, bool> insert_in(table* t, const uint64_t key, T* value) {
+                for(uint64_t pos = home(key) & t->mask;; pos = (pos + 1) & t->mask) {
+                    slot& sl = t->slots[pos];
+                    T* expected = nullptr;
+                    if(sl.value.compare_exchange_strong(expected, busy(), std::memory_order_acq_rel)) {
+                        sl.key.store(key, std::memory_order_relaxed);
+                        sl.value.store(value, std::memory_order_release);
+                        return {value, true};
+                    }
+                    while(expected == busy()) expected = sl.value.load(std::memory_order_acquire);
+                    if(sl.key.load(std::memory_order_relaxed) == key) return {expected, false};
+                }
+            }
+
+            void grow() {
+                std::lock_guard<std::mutex> guard(resize_lock);
+                table* old_table = current.load();
+                if(static_cast<uint64_t>(s_size.load()) * 2 <= old_table->mask + 1) return; // someone else grew it
+
+                resizing.store(true);
+                while(active_inserts.load() > 0) {} // wait for inserts into the old table to finish
+
+                tables.push_back(std::make_unique<table>(2 * (old_table->mask + 1)));
+                table* new_table = tables.back().get();
+                for(uint64_t pos = 0; pos <= old_table->mask; ++pos) {
+                    const slot& sl = old_table->slots[pos];
+                    T* value = sl.value.load(std::memory_order_relaxed);
+                    if(value != nullptr) insert_in(new_table, sl.key.load(std::memory_order_relaxed), value);
+                }
+                current.store(new_table);
+                resizing.store(false);
+            }
+
+        public:
+            hash_table() {
+                clear();
+            }
+
+            /**
+             * @param key the key
+             * @return the value stored for \p key, or `nullptr` if there is none
+             */
+            T* find(const uint64_t key) const {
+                return find_in(current.load(std::memory_order_acquire), key);
+            }
+
+            /**
+             * Inserts a value, unless a value is already stored for the key.
+             *
+             * @param key the key
+             * @param value the value, must not be `nullptr`
+             * @return whether \p value was inserted
+             */
+            bool insert(const uint64_t key, T* value) {
+                assert(value != nullptr && value != busy());
+                std::pair<T*, bool> result;
+                while(true) {
+                    active_inserts.fetch_add(1);
+                    if(!resizing.load()) break;
+                    active_inserts.fetch_sub(1);
+                    while(resizing.load()) {}
+                }
+                result = insert_in(current.load(), key, value);
+                active_inserts.fetch_sub(1);
+
+                if(result.second && static_cast<uint64_t>(s_size.fetch_add(1) + 1) * 2 > current.load()->mask + 1)
+                    grow();
+                return result.second;
+            }
+
+            /**
+             * @return number of keys in the table
+             */
+            [[nodiscard]] long size() const {
+                return s_size.load();
+            }
+
+            /**
+             * Calls \p f with every key and its value, in the order of the slots of the table. Must not be called
+             * concurrently with \a insert.
+             *
+             * @param f function called with a key and its value
+             */
+            template<class F>
+            void for_each(F&& f) const {
+                const table* t = current.load();
+                for(uint64_t pos = 0; pos <= t->mask; ++pos) {
+                    T* value = t->slots[pos].value.load(std::memory_order_relaxed);
+                    assert(value != busy());
+                    if(value != nullptr) f(t->slots[pos].key.load(std::memory_order_relaxed), value);
+                }
+            }
+
+            /**
+             * @return bytes of memory used by the table, including previous tables, must not be called concurrently
+             * with \a insert
+             */
+            [[nodiscard]] long memory() const {
+                long mem = 0;
+                for(const auto& t : tables) mem += static_cast<long>((t->mask + 1) * sizeof(slot));
+                return mem;
+            }
+
+            /**
+             * Removes all keys, and frees previous tables. Must not be called concurrently with other operations.
+             */
+            void clear() {
+                tables.clear();
+                tables.push_back(std::make_unique<table>(initial_capacity));
+                current.store(tables.back().get());
+                s_size.store(0);
+            }
+        };
+
+        /**
+         * \brief Append-only storage of integer arrays in a memory-mapped temporary file
+         *
+         * Arrays are laid out sequentially in the file, in the order in which they are allocated, such that reading
+         * them in order (or in reverse order) streams through the file. The file is mapped in segments, and arrays stay
+         * at their address until the storage is cleared. The operating system writes mapped pages back to the file
+         * whenever memory is needed, so the arrays mostly occupy local disk instead of memory.
+         *
+         * The file is removed from the file system right after it is created, and is thus deleted as soon as it is
+         * closed, even if the process terminates abnormally. Only available on POSIX systems, elsewhere \a open
+         * always fails.
+         */
+        class spill_file {
+            struct segment {
+                int* data;
+                long capacity;
+                long used;
+            };
+
+            static constexpr long segment_min = 1L << 24; /**< minimum capacity of segments, in integers */
+
+            int  fd = -1;
+            long s_file_size = 0; /**< size of the file in bytes */
+            std::vector<segment> segments;
+
+            bool add_segment(const long min_capacity) {
+#ifdef DEJAVU_HAVE_MMAP
+                const long page  = sysconf(_SC_PAGESIZE);
+                const long bytes = ((std::max(min_capacity, segment_min) * static_cast<long>(sizeof(int)) + page - 1) /
+                                    page) * page;
+                // reserve the blocks on disk right away, running out of disk later on would only be noticed when
+                // writing to the mapping
+#ifdef __linux__
+                if(posix_fallocate(fd, s_file_size, bytes) != 0) return false;
+#else
+                if(ftruncate(fd, s_file_size + bytes) != 0) return false;
+#endif
+                void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, s_file_size);
+                if(data == MAP_FAILED) return false;
+                segments.push_back({static_cast<int*>(data), bytes / static_cast<long>(sizeof(int)), 0});
+                s_file_size += bytes;
+                return true;
+#else
+                (void) min_capacity;
+                return false;
+#endif
+            }
+
+        public:
+            spill_file() = default;
+            spill_file(const spill_file&) = delete;
+            spill_file& operator=(const spill_file&) = delete;
+            spill_file(spill_file&& other) noexcept :
+                    fd(other.fd), s_file_size(other.s_file_size), segments(std::move(other.segments)) {
+                other.fd = -1;
+                other.s_file_size = 0;
+                other.segments.clear();
+            }
+
+            /**
+             * Creates the temporary file, unless it is open already.
+             *
+             * @param directory directory in which the file is created
+             * @return whether the file is open
+             */
+            bool open(const std::string& directory) {
+#ifdef DEJAVU_HAVE_MMAP
+                if(fd >= 0) return true;
+                std::string path = directory + "/dejavu_spill_XXXXXX";
+                fd = mkstemp(path.data());
+                if(fd >= 0) unlink(path.c_str());
+                return fd >= 0;
+#else
+                (void) directory;
+                return false;
+#endif
+            }
+
+            [[nodiscard]] bool is_open() const {
+                return fd >= 0;
+            }
+
+            /**
+             * Allocates an array at the end of the file. The file must be open.
+             *
+             * @param n size of the array
+             * @return Pointer to the array, valid until the storage is cleared, or `nullptr` if the file could not be
+             * extended (e.g., since the disk is full).
+             */
+            int* allocate(const long n) {
+                assert(is_open());
+                if(segments.empty() || segments.back().capacity - segments.back().used < n) {
+                    if(!add_segment(n)) return nullptr;
+                }
+                segment& last = segments.back();
+                int* ptr = last.data + last.used;
+                last.used += n;
+                return ptr;
+            }
+
+            /**
+             * Frees all arrays, and truncates the file. The file stays open.
+             */
+            void clear() {
+#ifdef DEJAVU_HAVE_MMAP
+                for(auto& s : segments) munmap(s.data, s.capacity * static_cast<long>(sizeof(int)));
+                if(fd >= 0 && s_file_size > 0) {
+                    [[maybe_unused]] const int truncated = ftruncate(fd, 0);
+                    assert(truncated == 0);
+                }
+#endif
+                segments.clear();
+                s_file_size = 0;
+            }
+
+            /**
+             * @return Bytes of disk space reserved by the file.
+             */
+            [[nodiscard]] long size() const {
+                return s_file_size;
+            }
+
+            ~spill_file() {
+                clear();
+#ifdef DEJAVU_HAVE_MMAP
+                if(fd >= 0) close(fd);
+#endif
+            }
+        };
+
+        /**
+         * \brief Compact binary encoding of solver state
+         *
+         * Encodes values into a buffer in memory: integers are written as variable-length integers (signed ones in
+         * zig-zag encoding), floating point numbers as their raw bytes. The buffer can be written to a file, which is
+         * replaced atomically and protected by a checksum. Decoded again by \a binary_reader, using the same sequence
+         * of calls.
+         *
+         * Classes that can be stored provide a method `serialize`, which is called with either a writer or a reader.
+         * Both provide the same interface, such that a single template method suffices for most classes.
+         */
+        class binary_writer {
+            std::string buffer;
+
+            void varint(uint64_t x) {
+                while(x >= 0x80) {
+                    buffer.push_back(static_cast<char>((x & 0x7F) | 0x80));
+                    x >>= 7;
+                }
+                buffer.push_back(static_cast<char>(x));
+            }
+
+        public:
+            static constexpr bool reading = false;
+
+            /**
+             * Checksum of a range of bytes (FNV-1a).
+             *
+             * @param h checksum of preceding bytes, to compute a checksum of several ranges
+             */
+            static uint64_t checksum(const char* data, const size_t n, uint64_t h = 14695981039346656037ULL) {
+                for(size_t i = 0; i < n; ++i) {
+                    h ^= static_cast<unsigned char>(data[i]);
+                    h *= 1099511628211ULL;
+                }
+                return h;
+            }
+
+            template<class T>
+            void value(const T& x) {
+                if constexpr (std::is_enum_v<T>) {
+                    value(static_cast<std::underlying_type_t<T>>(x));
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    buffer.push_back(static_cast<char>(x ? 1 : 0));
+                } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                    const auto y = static_cast<int64_t>(x);
+                    varint((static_cast<uint64_t>(y) << 1) ^ static_cast<uint64_t>(y >> 63));
+                } else if constexpr (std::is_integral_v<T>) {
+                    varint(static_cast<uint64_t>(x));
+                } else {
+                    static_assert(std::is_floating_point_v<T>);
+                    buffer.append(reinterpret_cast<const char*>(&x), sizeof(T));
+                }
+            }
+
+            template<class T, class U>
+            void value(const std::pair<T, U>& x) {
+                value(x.first);
+                value(x.second);
+            }
+
+            void value(const std::string& x) {
+                varint(x.size());
+                buffer.append(x);
+            }
+
+            /**
+             * Writes an array of known size, the size itself is not written.
+             */
+            template<class T>
+            void values(const T* arr, const long n) {
+                for(long i = 0; i < n; ++i) value(arr[i]);
+            }
+
+            template<class T>
+            void values(const std::vector<T>& vec) {
+                varint(vec.size());
+                for(const auto& x : vec) value(x);
+            }
+
+            /**
+             * Appends the contents of another writer.
+             */
+            void append(const binary_writer& other) {
+                buffer.append(other.buffer);
+            }
+
+            void clear() {
+                buffer.clear();
+            }
+
+            [[nodiscard]] size_t size() const {
+                return buffer.size();
+            }
+
+            [[nodiscard]] const std::string& data() const {
+                return buffer;
+            }
+
+            /**
+             * Writes the buffer and a checksum to a file. The file is first written under a temporary name, and then
+             * renamed, such that an existing file is only ever replaced by a complete one.
+             *
+             * @param filename name of the file
+             * @return whether the file was written
+             */
+            bool write_file(const std::string& filename) const {
+                const std::string tmp = filename + ".tmp";
+                {
+                    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+                    if(!out) return false;
+                    const uint64_t check = checksum(buffer.data(), buffer.size());
+                    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                    out.write(reinterpret_cast<const char*>(&check), sizeof(check));
+                    if(!out.flush()) return false;
+                }
+                return std::rename(tmp.c_str(), filename.c_str()) == 0;
+            }
+        };
+
+        /**
+         * \brief Decodes solver state written by \a binary_writer
+         *
+         * Reading past the end of the data, or reading sizes which can not be right, marks the reader as failed (see
+         * \a good). Values read from a failed reader are zero.
+         */
+        class binary_reader {
+            std::string buffer;
+            size_t pos = 0;
+            bool   ok  = false;
+
+            uint64_t varint() {
+                uint64_t x = 0;
+                for(int shift = 0; shift < 64; shift += 7) {
+                    if(pos >= buffer.size()) {
+                        ok = false;
+                        return 0;
+                    }
+                    const auto byte = static_cast<unsigned char>(buffer[pos++]);
+                    x |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                    if(!(byte & 0x80)) return x;
+                }
+                ok = false;
+                return 0;
+            }
+
+            // reads a size, each element takes at least one byte
+            size_t length() {
+                const uint64_t n = varint();
+                if(n > buffer.size() - pos) {
+                    ok = false;
+                    return 0;
+                }
+                return n;
+            }
+
+        public:
+            static constexpr bool reading = true;
+
+            binary_reader() = default;
+            explicit binary_reader(std::string data) : buffer(std::move(data)), ok(true) {}
+
+            /**
+             * Reads a file written by \a binary_writer::write_file, and verifies its checksum.
+             *
+             * @param filename name of the file
+             * @return whether the file could be read, and its checksum matched
+             */
+            bool read_file(const std::string& filename) {
+                buffer.clear();
+                pos = 0;
+                ok  = false;
+                std::ifstream in(filename, std::ios::binary);
+                if(!in) return false;
+                buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                uint64_t check;
+                if(buffer.size() < sizeof(check)) return false;
+                memcpy(&check, buffer.data() + buffer.size() - sizeof(check), sizeof(check));
+                buffer.resize(buffer.size() - sizeof(check));
+                ok = (check == binary_writer::checksum(buffer.data(), buffer.size()));
+                return ok;
+            }
+
+            /**
+             * @return whether all values were read successfully so far
+             */
+            [[nodiscard]] bool good() const {
+                return ok;
+            }
+
+            /**
+             * Marks the reader as failed, e.g., if a value read is inconsistent.
+             */
+            void fail() {
+                ok = false;
+            }
+
+            /**
+             * @return whether all data was read
+             */
+            [[nodiscard]] bool at_end() const {
+                return pos == buffer.size();
+            }
+
+            template<class T>
+            void value(T& x) {
+                if constexpr (std::is_enum_v<T>) {
+                    std::underlying_type_t<T> y;
+                    value(y);
+                    x = static_cast<T>(y);
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    x = (varint() != 0);
+                } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                    const uint64_t y = varint();
+                    x = static_cast<T>(static_cast<int64_t>(y >> 1) ^ -static_cast<int64_t>(y & 1));
+                } else if constexpr (std::is_integral_v<T>) {
+                    x = static_cast<T>(varint());
+                } else {
+                    static_assert(std::is_floating_point_v<T>);
+                    x = 0;
+                    if(buffer.size() - pos < sizeof(T)) {
+                        ok = false;
+                        return;
+                    }
+                    memcpy(&x, buffer.data() + pos, sizeof(T));
+                    pos += sizeof(T);
+                }
+            }
+
+            template<class T, class U>
+            void value(std::pair<T, U>& x) {
+                value(x.first);
+                value(x.second);
+            }
+
+            void value(std::string& x) {
+                const size_t n = length();
+                x.assign(buffer.data() + pos, n);
+                pos += n;
+            }
+
+            template<class T>
+            void values(T* arr, const long n) {
+                for(long i = 0; i < n; ++i) value(arr[i]);
+            }
+
+            template<class T>
+            void values(std::vector<T>& vec) {
+                const size_t n = length();
+                vec.resize(n);
+                for(size_t i = 0; i < n; ++i) value(vec[i]);
+            }
+        };
+
+        /**
+         * \brief Bounded multi-producer single-consumer queue
+         *
+         * Lock-free ring buffer of fixed capacity: any number of threads may call \a try_push concurrently, while only
+         * a single thread may call \a try_pop. Neither operation ever blocks. Elements are written and read in place
+         * through a callback, such that memory held by elements (e.g., vectors) is reused across pushes.
+         *
+         * Follows the bounded queue design of Dmitry Vyukov.
+         *
+         * @tparam T Type of elements stored in the queue.
+         */
+        template<class T>
+        class mpsc_queue {
+            struct cell {
+                std::atomic<size_t> sequence;
+                T data;
+            };
+
+            std::unique_ptr<cell[]> buffer;
+            size_t mask = 0;
+
+            alignas(64) std::atomic<size_t> enqueue_pos = 0;
+            alignas(64) size_t dequeue_pos = 0;
+        public:
+            /**
+             * Allocates the queue, and resets it to be empty. Must not be called while other threads use the queue.
+             *
+             * @param capacity Minimum number of elements the queue can hold, rounded up to a power of two.
+             */
+            void initialize(int capacity) {
+                assert(capacity > 0);
+                size_t sz = 1;
+                while (sz < static_cast<size_t>(capacity)) sz <<= 1;
+                buffer = std::make_unique<cell[]>(sz);
+                mask   = sz - 1;
+                for (size_t i = 0; i < sz; ++i) buffer[i].sequence.store(i, std::memory_order_relaxed);
+                enqueue_pos.store(0, std::memory_order_relaxed);
+                dequeue_pos = 0;
+            }
+
+            /**
+             * Pushes an element into the queue. Can be called by multiple threads concurrently.
+             *
+             * @param write Callback writing the element, called with a reference to the slot in the queue.
+             * @return Whether the element was pushed, or the queue was full.
+             */
+            template<class F>
+            bool try_push(F&& write) {
+                assert(buffer);
+                cell* target;
+                size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+                while (true) {
+                    target = &buffer[pos & mask];
+                    const size_t seq = target->sequence.load(std::memory_order_acquire);
+                    const auto   dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                    if (dif == 0) {
+                        if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    } else if (dif < 0) {
+                        return false; // full
+                    } else {
+                        pos = enqueue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+                write(target->data);
+                target->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * Pops an element from the queue. Must only be called by a single thread.
+             *
+             * @param read Callback reading the element, called with a reference to the slot in the queue.
+             * @return Whether an element was popped, or the queue was empty.
+             */
+            template<class F>
+            bool try_pop(F&& read) {
+                assert(buffer);
+                cell* target = &buffer[dequeue_pos & mask];
+                const size_t seq = target->sequence.load(std::memory_order_acquire);
+                if (seq != dequeue_pos + 1) return false; // empty, or element not yet fully written
+                read(target->data);
+                target->sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+                ++dequeue_pos;
+                return true;
+            }
+        };
     }
 }
 
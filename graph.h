@@ -37,11 +37,31 @@ namespace dejavu {
         int *v = nullptr;
         int *d = nullptr;
         int *e = nullptr;
+        int *ec = nullptr; /**< optional colors of half-edges, parallel to `e` (`nullptr` if the graph is neither
+                             *  edge-colored nor directed): both half-edges of an undirected edge have the same
+                             *  non-negative color, whereas the half-edges of arcs are colored using \a arc_out,
+                             *  \a arc_in and \a arc_both */
+
+        static constexpr int arc_out  = -1; /**< half-edge color at the tail of an arc */
+        static constexpr int arc_in   = -2; /**< half-edge color at the head of an arc */
+        static constexpr int arc_both = -3; /**< half-edge color of a pair of arcs in both directions */
+
+        /**
+         * @param color color of a half-edge
+         * @return color of the other half-edge of the same edge or arc
+         */
+        static int reverse_color(const int color) {
+            return color == arc_out ? arc_in : (color == arc_in ? arc_out : color);
+        }
 
         int v_size = 0;
         int e_size = 0;
 
         bool dense = false;
+        double dense_dense_factor = 1.0; /**< scales the degree above which color refinement uses the dense-dense
+                                           *  kernel for a color class (see \a ir::refinement::refine_coloring) */
+        double dense_cell_factor  = 1.0; /**< scales the degree above which color refinement uses the dense-cell
+                                           *  kernel for a color class */
 
         void initialize(int nv, int ne) {
             initialized = true;
@@ -50,6 +70,16 @@ namespace dejavu {
             e = new int[ne];
         }
 
+        /**
+         * Allocates the edge colors of this graph, all of which are initially 0. The graph must be initialized, and
+         * `e_size` must be set.
+         */
+        void initialize_edge_colors() {
+            assert(initialized);
+            delete[] ec;
+            ec = new int[e_size]();
+        }
+
         // initialize a coloring of this sgraph, partitioning degrees of vertices
         void initialize_coloring(ds::coloring *c, int *vertex_to_col) {
             c->initialize(this->v_size);
@@ -223,6 +253,7 @@ namespace dejavu {
                     for(int k = 0; k < d[neigh]; ++k) {
                         const int neigh_neigh = e[v[neigh] + k];
                         if(neigh_neigh == i) {
+                            assert(ec == nullptr || ec[v[neigh] + k] == reverse_color(ec[v[i] + j]));
                             found = true;
                             break;
                         }
@@ -239,6 +270,8 @@ namespace dejavu {
                 delete[] d;
                 delete[] e;
             }
+            delete[] ec;
+            ec = nullptr;
             initialize(g->v_size, g->e_size);
 
             memcpy(v, g->v, g->v_size * sizeof(int));
@@ -246,13 +279,27 @@ namespace dejavu {
             memcpy(e, g->e, g->e_size * sizeof(int));
             v_size = g->v_size;
             e_size = g->e_size;
+            if(g->ec != nullptr) {
+                initialize_edge_colors();
+                memcpy(ec, g->ec, g->e_size * sizeof(int));
+            }
         }
 
         [[maybe_unused]] void sort_edgelist() const {
             for (int i = 0; i < v_size; ++i) {
                 const int estart = v[i];
                 const int eend = estart + d[i];
-                std::sort(e + estart, e + eend);
+                if(ec == nullptr) {
+                    std::sort(e + estart, e + eend);
+                    continue;
+                }
+                std::vector<std::pair<int, int>> edges;
+                for(int j = estart; j < eend; ++j) edges.emplace_back(e[j], ec[j]);
+                std::sort(edges.begin(), edges.end());
+                for(int j = estart; j < eend; ++j) {
+                    e[j]  = edges[j - estart].first;
+                    ec[j] = edges[j - estart].second;
+                }
             }
         }
 
@@ -262,6 +309,7 @@ namespace dejavu {
                 delete[] d;
                 delete[] e;
             }
+            delete[] ec;
         }
     };
 
@@ -277,7 +325,11 @@ namespace dejavu {
      * The `add_vertex(color, deg)` function requires a color and a degree. Both can not be changed later.
      *
      * The `add_edge(v1, v2)` function adds an undirected edge from `v1` to `v2`. It is always required that `v1 < v2`
-     * holds, to prevent the accidental addition of hyper-edges.
+     * holds, to prevent the accidental addition of hyper-edges. Using `add_edge(v1, v2, edge_color)` instead, the graph
+     * becomes edge-colored, in which case all edges added without a color have color 0. The `add_arc(v1, v2)` function
+     * adds a directed arc. For directed graphs, the degree of a vertex is its number of distinct neighbours, and the
+     * number of edges is the number of adjacent pairs of vertices, i.e., arcs in both directions between two vertices
+     * count as a single edge.
      *
      * After the graph was built, the internal sassy graph (sgraph) can be accessed either by the user, or the provided
      * functions. Once the graph construction is finished, the internal sgraph can be changed arbitrarily.
@@ -393,6 +445,58 @@ namespace dejavu {
             num_edges_defined += 2;
         };
 
+        /**
+         * Adds an undirected edge with color \p edge_color from \p v1 to \p v2. Automorphisms of the graph have to
+         * preserve edge colors.
+         *
+         * @param v1 first endpoint, must be smaller than \p v2
+         * @param v2 second endpoint
+         * @param edge_color color of the edge
+         */
+        [[maybe_unused]] void add_edge(const unsigned int v1, const unsigned int v2, const int edge_color) {
+            if(edge_color < 0)
+                throw std::invalid_argument("edge colors must be non-negative");
+            add_edge(v1, v2);
+            if(g.ec == nullptr) g.initialize_edge_colors();
+            g.ec[g.v[v1] + edge_cnt[v1] - 1] = edge_color;
+            g.ec[g.v[v2] + edge_cnt[v2] - 1] = edge_color;
+        };
+
+        /**
+         * Adds a directed arc from \p v1 to \p v2. Automorphisms of the graph have to preserve the direction of arcs.
+         * If the arc from \p v2 to \p v1 was added before, both arcs together form a single edge.
+         *
+         * @param v1 tail of the arc
+         * @param v2 head of the arc
+         */
+        [[maybe_unused]] void add_arc(const unsigned int v1, const unsigned int v2) {
+            if(!initialized)
+                throw std::logic_error("uninitialized graph");
+            if(finalized)
+                throw std::logic_error("can not change finalized graph");
+            if(v1 == v2)
+                throw std::invalid_argument("invalid arc: v1 != v2 must hold");
+            if(v1 >= num_vertices_defined || v2 >= num_vertices_defined)
+                throw std::out_of_range("v1 or v2 is not a defined vertex, use add_vertex to add vertices");
+            if(g.ec == nullptr) g.initialize_edge_colors();
+
+            // arc in the opposite direction already added?
+            for(int j = g.v[v1]; j < g.v[v1] + edge_cnt[v1]; ++j) {
+                if(g.e[j] != static_cast<int>(v2)) continue;
+                if(g.ec[j] != sgraph::arc_in)
+                    throw std::invalid_argument("invalid arc: v1 and v2 are already adjacent");
+                g.ec[j] = sgraph::arc_both;
+                for(int k = g.v[v2]; k < g.v[v2] + edge_cnt[v2]; ++k) {
+                    if(g.e[k] == static_cast<int>(v1)) g.ec[k] = sgraph::arc_both;
+                }
+                return;
+            }
+
+            add_edge(std::min(v1, v2), std::max(v1, v2));
+            g.ec[g.v[v1] + edge_cnt[v1] - 1] = sgraph::arc_out;
+            g.ec[g.v[v2] + edge_cnt[v2] - 1] = sgraph::arc_in;
+        };
+
         void sanity_check() {
             g.sanity_check();
         }
@@ -402,7 +506,10 @@ namespace dejavu {
             std::ofstream dumpfile;
             dumpfile.open (filename, std::ios::out);
 
-            dumpfile << "p edge " << g.v_size << " " << g.e_size/2 << std::endl;
+            // arcs in both directions are written as two lines
+            int both_half_edges = 0;
+            for(int j = 0; g.ec != nullptr && j < g.e_size; ++j) both_half_edges += (g.ec[j] == sgraph::arc_both);
+            dumpfile << "p edge " << g.v_size << " " << g.e_size/2 + both_half_edges/2 << std::endl;
 
             for(int i = 0; i < g.v_size; ++i) {
                 dumpfile << "n " << i+1 << " " << c[i] << std::endl;
@@ -411,9 +518,16 @@ namespace dejavu {
             for(int i = 0; i < g.v_size; ++i) {
                 for(int j = g.v[i]; j < g.v[i]+g.d[i]; ++j) {
                     const int neighbour = g.e[j];
-                    if(neighbour < i) {
-                        dumpfile << "e " << neighbour+1 << " " << i+1 << std::endl;
-                    }
+                    if(neighbour >= i) continue;
+                    const int color = g.ec != nullptr ? g.ec[j] : 0;
+                    if(color == sgraph::arc_out || color == sgraph::arc_both)
+                        dumpfile << "a " << i+1 << " " << neighbour+1 << std::endl;
+                    if(color == sgraph::arc_in  || color == sgraph::arc_both)
+                        dumpfile << "a " << neighbour+1 << " " << i+1 << std::endl;
+                    if(color < 0) continue;
+                    dumpfile << "e " << neighbour+1 << " " << i+1;
+                    if(g.ec != nullptr) dumpfile << " " << color;
+                    dumpfile << std::endl;
                 }
             }
         }
@@ -5,6 +5,8 @@
 #ifndef DEJAVU_GROUPS_H
 #define DEJAVU_GROUPS_H
 
+#include <thread>
+#include <atomic>
 #include "coloring.h"
 #include "graph.h"
 #include "trace.h"
@@ -629,6 +631,16 @@ namespace dejavu {
 
             orbit() = default;
 
+            /**
+             * Stores or restores the orbit partition.
+             */
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(sz);
+                map_arr.serialize(ar);
+                orb_sz.serialize(ar);
+            }
+
             bool operator==(orbit& other_orbit) {
                 bool comp = (other_orbit.sz == sz) ;
                 for(int i = 0; i < sz && comp; ++i)
@@ -775,6 +787,13 @@ namespace dejavu {
                     assert(data.size() == domain_size);
                 }
             }
+
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(domain_size);
+                ar.value(store_type);
+                data.serialize(ar);
+            }
         };
 
         /**
@@ -913,6 +932,31 @@ namespace dejavu {
                 generators.clear();
             }
 
+            /**
+             * Stores or restores the generating set. Restoring replaces all generators.
+             */
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(domain_size);
+                ar.value(s_stored_sparse);
+                ar.value(s_stored_dense);
+                long num = static_cast<long>(generators.size());
+                ar.value(num);
+                if constexpr (A::reading) {
+                    clear();
+                    if(!ar.good() || num < 0) return;
+                    generators.resize(num, nullptr);
+                }
+                for(auto& generator : generators) {
+                    bool present = (generator != nullptr);
+                    ar.value(present);
+                    if constexpr (A::reading) {
+                        if(present) generator = new stored_automorphism;
+                    }
+                    if(present) generator->serialize(ar);
+                }
+            }
+
             ~generating_set() {
                 clear();
             }
@@ -1089,6 +1133,20 @@ namespace dejavu {
                 add_to_fixed_orbit(fixed_vertex, -1, 0);
             }
 
+            /**
+             * Stores or restores the transversal.
+             */
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(fixed);
+                ar.value(sz_upb);
+                ar.value(level);
+                ar.value(finished);
+                ar.values(fixed_orbit);
+                ar.values(fixed_orbit_to_perm);
+                ar.values(fixed_orbit_to_pwr);
+            }
+
             /**
              * Extend this transversal using the given \p automorphism.
              *
@@ -1238,6 +1296,29 @@ namespace dejavu {
                 init = true;
             }
 
+            /**
+             * Stores or restores the Schreier structure, i.e., its generators and transversals.
+             */
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(domain_size);
+                ar.value(finished_up_to);
+                ar.value(init);
+                ar.value(s_consecutive_success);
+                ar.value(h_error_bound);
+                s_grp_sz.serialize(ar);
+                generators.serialize(ar);
+                long num = static_cast<long>(transversals.size());
+                ar.value(num);
+                if constexpr (A::reading) {
+                    transversals.clear();
+                    if(!ar.good() || num < 0) return;
+                    transversals.resize(num);
+                }
+                for(auto& transversal : transversals) transversal.serialize(ar);
+                ar.values(stabilized_generators);
+            }
+
             void set_base(schreier_workspace &w, automorphism_workspace& automorphism, random_source& rng,
                           std::vector<int> &new_base, int err = 10) {
                 assert(init);
@@ -1956,6 +2037,28 @@ namespace dejavu {
                 }
             }
 
+            /**
+             * Stores or restores the Schreier structure. The domain compressor itself is not stored: when restoring,
+             * \p same_compressor must be the compressor the structure was stored with (or one computed in the same
+             * way).
+             *
+             * @param ar the writer or reader
+             * @param same_compressor compressor used when restoring, ignored when storing
+             */
+            template<class A>
+            void serialize(A& ar, domain_compressor* same_compressor) {
+                bool compressed = (compressor != nullptr);
+                ar.value(compressed);
+                ar.value(s_compression_ratio);
+                ar.values(original_base);
+                ar.values(original_base_sizes);
+                internal_schreier.serialize(ar);
+                if constexpr (A::reading) {
+                    compressor = compressed ? same_compressor : nullptr;
+                    if(compressor != nullptr) compressed_automorphism.resize(compressor->compressed_domain_size());
+                }
+            }
+
             /**
              * Returns a vertex to individualize for each color of \p root_coloring that matches in size a corresponding
              * transversal.
@@ -2138,6 +2241,208 @@ namespace dejavu {
                 internal_schreier.compute_group_size();
             }
         };
+
+        /**
+         * \brief Sifts automorphisms into a Schreier structure on a dedicated thread.
+         *
+         * Pipelines the discovery of automorphisms and Schreier-Sims: producers push certified automorphisms into a
+         * bounded queue, which a dedicated sifting thread drains into a \ref compressed_schreier. While the thread is
+         * running, it owns the Schreier structure, and publishes the state of the abort criteria atomically. Producers
+         * never wait on Schreier updates: if the queue is full, the automorphism is dropped, which only delays the
+         * probabilistic abort criterion.
+         */
+        class pipelined_sifter {
+            struct queued_automorphism {
+                std::vector<int> supp;   /**< support of the automorphism */
+                std::vector<int> image;  /**< vertex `supp[i]` is mapped to `image[i]` */
+                bool uniform = false;    /**< was the automorphism sampled uniformly? */
+            };
+
+            ds::mpsc_queue<queued_automorphism> queue;
+            std::vector<queued_automorphism>    changed; /**< automorphisms which changed the Schreier structure */
+            std::thread sifter;
+            compressed_schreier* group = nullptr;
+            random_source rng;
+
+            std::atomic<bool> running      = false;
+            std::atomic<int>  s_pushed     = 0;     /**< also used to wake up the sifting thread */
+
+            // state published by the sifting thread
+            std::atomic<bool> s_probabilistic_abort = false;
+            std::atomic<bool> s_deterministic_abort = false;
+            std::atomic<int>  s_finished_up_to      = -1;
+            std::atomic<int>  s_random_sift_success = 0;
+
+            void publish() {
+                s_finished_up_to.store(group->finished_up_to_level(), std::memory_order_relaxed);
+                s_probabilistic_abort.store(group->probabilistic_abort_criterion(), std::memory_order_relaxed);
+                s_deterministic_abort.store(group->deterministic_abort_criterion(), std::memory_order_release);
+            }
+
+            void sift_loop(int domain_size) {
+                schreier_workspace     w(domain_size);
+                automorphism_workspace automorphism(domain_size);
+                bool uniform = false;
+                int random_sift_success = s_random_sift_success.load(std::memory_order_relaxed);
+                queued_automorphism current; /*< copy of the automorphism being sifted, if h_keep_changed */
+
+                auto load = [this, &automorphism, &uniform, &current](queued_automorphism& element) {
+                    automorphism.reset();
+                    for (int i = 0; i < static_cast<int>(element.supp.size()); ++i)
+                        automorphism.write_single_map(element.supp[i], element.image[i]);
+                    uniform = element.uniform;
+                    if (h_keep_changed) {
+                        current.supp.assign(element.supp.begin(), element.supp.end());
+                        current.image.assign(element.image.begin(), element.image.end());
+                    }
+                };
+
+                while (true) {
+                    const int seen = s_pushed.load(std::memory_order_acquire);
+                    if (!queue.try_pop(load)) {
+                        if (!running.load(std::memory_order_acquire)) {
+                            if (queue.try_pop(load)) continue; // drain whatever was pushed before stopping
+                            break;
+                        }
+                        s_pushed.wait(seen, std::memory_order_acquire);
+                        continue;
+                    }
+                    ++s_sifted;
+
+                    // same procedure as sifting inline in random_ir
+                    const bool sift = group->sift(w, automorphism, uniform);
+                    automorphism.reset();
+                    if (sift && h_keep_changed) changed.push_back(current);
+                    if (sift && group->s_densegen() + group->s_sparsegen() > 1 && random_sift_success > -5) {
+                        int fail = 3;
+                        bool any_changed = false;
+                        while (fail >= 0) {
+                            const bool sift_changed = group->sift_random(w, automorphism, rng);
+                            any_changed = sift_changed || any_changed;
+                            fail -= !sift_changed;
+                        }
+                        random_sift_success += any_changed ? 1 : -1;
+                        random_sift_success  = std::max(std::min(random_sift_success, 5), -5);
+                        s_random_sift_success.store(random_sift_success, std::memory_order_relaxed);
+                    }
+                    automorphism.reset();
+                    publish();
+                }
+            }
+
+        public:
+            int  h_queue_size   = 64;    /**< capacity of the queue between producers and the sifting thread */
+            bool h_keep_changed = false; /**< keep automorphisms which changed the Schreier structure, see
+                                           *  \a take_changed */
+
+            std::atomic<int> s_sifted  = 0; /**< number of automorphisms sifted by the sifting thread */
+            std::atomic<int> s_dropped = 0; /**< number of automorphisms dropped since the queue was full */
+
+            explicit pipelined_sifter(int seed = 0) : rng(false, seed) {}
+
+            ~pipelined_sifter() {
+                stop();
+            }
+
+            /**
+             * Starts the sifting thread. Until \a stop is called, \p new_group must only be accessed through this
+             * object.
+             *
+             * @param new_group Schreier structure into which automorphisms are sifted.
+             * @param domain_size Size of the domain of automorphisms.
+             * @param random_sift_success Initial value of the heuristic deciding whether random elements are sifted.
+             * @param true_random Whether the sifting thread uses the random device of the OS for random sifts.
+             * @param seed Seed of the pseudo random number generator of the sifting thread.
+             */
+            void start(compressed_schreier& new_group, int domain_size, int random_sift_success, bool true_random,
+                       int seed) {
+                assert(!running);
+                group = &new_group;
+                rng.seed(true_random, seed);
+                queue.initialize(h_queue_size);
+                s_random_sift_success.store(random_sift_success);
+                publish();
+                running.store(true);
+                sifter = std::thread(&pipelined_sifter::sift_loop, this, domain_size);
+            }
+
+            /**
+             * Sifts all automorphisms remaining in the queue, and stops the sifting thread. Afterwards, the Schreier
+             * structure may be used directly again.
+             */
+            void stop() {
+                if (!sifter.joinable()) return;
+                running.store(false, std::memory_order_release);
+                s_pushed.fetch_add(1, std::memory_order_release);
+                s_pushed.notify_one();
+                sifter.join();
+            }
+
+            /**
+             * Calls \p f for each automorphism which changed the Schreier structure since the last call, if
+             * \a h_keep_changed is set. Must not be called while the sifting thread is running.
+             *
+             * @param f Called with the support of an automorphism, and the images of the support.
+             */
+            template<class F>
+            void take_changed(F f) {
+                assert(!sifter.joinable());
+                for (const auto& element : changed) f(element.supp, element.image);
+                changed.clear();
+            }
+
+            /**
+             * Queues an automorphism to be sifted. Never blocks. Can be called by multiple threads concurrently.
+             *
+             * @param automorphism The automorphism.
+             * @param uniform Whether the automorphism was sampled uniformly.
+             * @return Whether the automorphism was queued, or dropped since the queue is full.
+             */
+            bool push(automorphism_workspace& automorphism, bool uniform) {
+                const bool pushed = queue.try_push([&automorphism, uniform](queued_automorphism& element) {
+                    const int nsupp = automorphism.nsupp();
+                    element.supp.assign(automorphism.supp(), automorphism.supp() + nsupp);
+                    element.image.resize(nsupp);
+                    for (int i = 0; i < nsupp; ++i) element.image[i] = automorphism.p()[element.supp[i]];
+                    element.uniform = uniform;
+                });
+                if (!pushed) {
+                    ++s_dropped;
+                    return false;
+                }
+                s_pushed.fetch_add(1, std::memory_order_release);
+                s_pushed.notify_one();
+                return true;
+            }
+
+            /**
+             * @return Whether the probabilistic abort criterion was satisfied, as last published by the sifting thread.
+             */
+            [[nodiscard]] bool probabilistic_abort_criterion() const {
+                return s_probabilistic_abort.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @return Whether the deterministic abort criterion was satisfied, as last published by the sifting thread.
+             */
+            [[nodiscard]] bool deterministic_abort_criterion() const {
+                return s_deterministic_abort.load(std::memory_order_acquire);
+            }
+
+            /**
+             * @return Level up to which Schreier structure is complete, as last published by the sifting thread.
+             */
+            [[nodiscard]] int finished_up_to_level() const {
+                return s_finished_up_to.load(std::memory_order_relaxed);
+            }
+
+            /**
+             * @return Heuristic indicating whether sifting random elements was recently successful.
+             */
+            [[nodiscard]] int random_sift_success() const {
+                return s_random_sift_success.load(std::memory_order_relaxed);
+            }
+        };
     }
 }
 
@@ -5,6 +5,8 @@
 #ifndef DEJAVU_INPROCESS_H
 #define DEJAVU_INPROCESS_H
 
+#include <memory>
+#include <thread>
 #include "dfs.h"
 #include "bfs.h"
 #include "rand.h"
@@ -23,12 +25,68 @@ namespace dejavu::search_strategy {
         // statistics
         big_number s_grp_sz; /**< group size */
         int h_splits_hint = INT32_MAX;
+        int h_threads     = 1;    /**< number of threads used to compute invariants                               */
+        int h_parallel_min_vertices = 1024; /**< only use multiple threads if at least this many vertices are processed */
 
         std::vector<std::pair<int, int>> inproc_can_individualize; /**< vertices that can be individualized           */
 
+        /**
+         * Calls \p work for all vertices `from, ..., to - 1`, distributed over \a h_threads threads. Every additional
+         * thread works on its own copy of \p local_state, configured using \p setup. As long as \p work only writes
+         * results for the given vertex, and a vertex is processed the same way in any copy of the state, results do
+         * not depend on the number of threads.
+         *
+         * @param local_state state used to perform IR computations, used by the calling thread
+         * @param setup configures a copied state before use (e.g., heuristic settings which are not copied)
+         * @param from first vertex
+         * @param to vertex after the last vertex
+         * @param work function called with a state and a vertex
+         */
+        template<class S, class F>
+        void for_each_vertex(ir::controller &local_state, S&& setup, const int from, const int to, F&& work) {
+            const int threads = (h_threads > 1 && to - from >= h_parallel_min_vertices)? h_threads : 1;
+            if(threads <= 1) {
+                for(int i = from; i < to; ++i) work(local_state, i);
+                return;
+            }
+
+            // workspaces for additional threads
+            std::vector<std::unique_ptr<ir::refinement>> refinements;
+            std::vector<std::unique_ptr<coloring>>       colorings;
+            std::vector<std::unique_ptr<ir::controller>> states;
+            for(int t = 1; t < threads; ++t) {
+                refinements.push_back(std::make_unique<ir::refinement>());
+                colorings.push_back(std::make_unique<coloring>());
+                colorings.back()->copy_any(local_state.c);
+                states.push_back(std::make_unique<ir::controller>(refinements.back().get(), colorings.back().get()));
+                states.back()->link_compare(&local_state, false);
+                setup(*states.back());
+            }
+
+            // vertices are handed out in small chunks, since cost varies a lot between vertices
+            std::atomic<int> next = from;
+            auto worker = [&next, to, &work](ir::controller& state) {
+                constexpr int chunk = 8;
+                for(int i = next.fetch_add(chunk); i < to; i = next.fetch_add(chunk)) {
+                    const int i_end = std::min(i + chunk, to);
+                    for (int j = i; j < i_end; ++j) work(state, j);
+                }
+            };
+
+            std::vector<std::thread> pool;
+            pool.reserve(threads - 1);
+            for(auto& state : states) pool.emplace_back(worker, std::ref(*state));
+            worker(local_state);
+            for(auto& thread : pool) thread.join();
+        }
+
         /**
          * Computes an invariant using a `shallow` breadth-first search.
          *
+         * Vertices are processed in parallel, if \a h_threads is set. The invariant does not depend on the number of
+         * threads: the depth is only lowered according to the first percent of vertices, which are processed before
+         * all remaining vertices.
+         *
          * @param g the graph
          * @param local_state state used to perform IR computations
          * @param inv place to store the invariant
@@ -36,46 +94,68 @@ namespace dejavu::search_strategy {
          * @param depth depth of trace to look at
          * @param lower_depth whether to try to lower the depth, if a smaller distinguishing depth is found
          */
-        static void shallow_bfs_invariant(sgraph* g, ir::controller &local_state, worklist_t<unsigned long>& inv,
-                                          groups::orbit& orbit_partition,
-                                          int depth = 8, bool lower_depth = true) {
-            local_state.use_reversible(true);
-            local_state.use_trace_early_out(lower_depth); // TODO bad for groups128, otherwise seems fine
-            local_state.use_increase_deviation(false);
-            local_state.use_split_limit(true, depth); // 20
+        void shallow_bfs_invariant(sgraph* g, ir::controller &local_state, worklist_t<unsigned long>& inv,
+                                   groups::orbit& orbit_partition, int depth = 8, bool lower_depth = true) {
+            const bool trace_early_out = lower_depth; // TODO bad for groups128, otherwise seems fine
+            auto setup = [&depth, trace_early_out](ir::controller& state) {
+                state.use_reversible(true);
+                state.use_trace_early_out(trace_early_out);
+                state.use_increase_deviation(false);
+                state.use_split_limit(true, depth);
+            };
+            setup(local_state);
+
+            // vertices considered for lowering the depth
+            const int lower_depth_end = std::min((g->v_size + 99) / 100, g->v_size);
+            const int base_color      = (*local_state.compare_base)[0].color;
+            std::vector<int> splits(lower_depth_end);
+
+            auto is_candidate = [&local_state, &orbit_partition](const int v) {
+                if(!orbit_partition.represents_orbit(v)) return false;
+                const int col_sz = local_state.c->ptn[local_state.c->vertex_to_col[v]] + 1;
+                return col_sz >= 2 && col_sz != orbit_partition.orbit_size(v);
+            };
+            auto work = [g, &inv, &splits, &orbit_partition, lower_depth_end](ir::controller& state, const int i) {
+                if(!orbit_partition.represents_orbit(i)) return;
+                const int col    = state.c->vertex_to_col[i];
+                const int col_sz = state.c->ptn[col] + 1;
+                if (col_sz >= 2 && col_sz != orbit_partition.orbit_size(i)) {
+                    state.T->set_hash(0);
+                    state.reset_trace_equal();
+                    state.move_to_child(g, i);
+                    inv[i] = state.T->get_hash();
+                    if(i < lower_depth_end) splits[i] = state.get_number_of_splits();
+                    state.move_to_parent();
+                } else {
+                    inv[i] = 0;
+                }
+            };
 
             bool repeat = true;
-            int best_depth = depth;
             while (repeat) {
                 repeat = false;
                 local_state.use_split_limit(true, depth);
-                for (int i = 0; i < g->v_size; ++i) {
-                    if(!orbit_partition.represents_orbit(i)) continue;
-
-                    local_state.T->set_hash(0);
-                    local_state.reset_trace_equal();
-                    const int col = local_state.c->vertex_to_col[i];
-                    const int col_sz = local_state.c->ptn[col] + 1;
-                    if (col_sz >= 2 && col_sz != orbit_partition.orbit_size(i)) {
-                        local_state.move_to_child(g, i);
-                        inv[i] = local_state.T->get_hash();
-                        const int splits = local_state.get_number_of_splits();
-                        local_state.move_to_parent();
-                        if(100 * i < g->v_size && lower_depth && splits < best_depth &&
-                           col == (*local_state.compare_base)[0].color) {
-                            best_depth = splits;
-                        }
-                        if(100 * i >= g->v_size && lower_depth && best_depth < depth) {
+                for_each_vertex(local_state, setup, 0, lower_depth_end, work);
+
+                if(lower_depth) {
+                    int best_depth = depth;
+                    for (int i = 0; i < lower_depth_end; ++i) {
+                        if(is_candidate(i) && splits[i] < best_depth &&
+                           local_state.c->vertex_to_col[i] == base_color) best_depth = splits[i];
+                    }
+
+                    // a smaller depth suffices, so start over -- unless there are no other vertices left anyway
+                    if(best_depth < depth) {
+                        for (int i = lower_depth_end; i < g->v_size && !repeat; ++i) repeat = is_candidate(i);
+                        if(repeat) {
                             depth = best_depth;
                             lower_depth = false;
-                            repeat = true;
-                            break;
+                            continue;
                         }
-                    } else {
-                        inv[i] = 0;
                     }
                 }
 
+                for_each_vertex(local_state, setup, lower_depth_end, g->v_size, work);
                 for (int i = 0; i < g->v_size; ++i) inv[i] = inv[orbit_partition.find_orbit(i)];
             }
 
@@ -163,15 +243,21 @@ namespace dejavu::search_strategy {
         /**
          * Computes an invariant using a `shallow` breadth-first search for 2 consecutive levels.
          *
+         * Vertices are processed in parallel, if \a h_threads is set. The invariant does not depend on the number of
+         * threads.
+         *
          * @param g the graph
          * @param local_state state used to perform IR computations
          * @param inv place to store the invariant
          */
-        static void shallow_bfs_invariant2(sgraph* g, ir::controller &local_state, worklist_t<unsigned long>& inv) {
-            local_state.use_reversible(true);
-            local_state.use_trace_early_out(false);
-            local_state.use_increase_deviation(true);
-            local_state.use_split_limit(true, 8);
+        void shallow_bfs_invariant2(sgraph* g, ir::controller &local_state, worklist_t<unsigned long>& inv) {
+            auto setup = [](ir::controller& state) {
+                state.use_reversible(true);
+                state.use_trace_early_out(false);
+                state.use_increase_deviation(true);
+                state.use_split_limit(true, 8);
+            };
+            setup(local_state);
 
             markset original_colors(g->v_size);
             for(int _col = 0; _col < g->v_size;) {
@@ -180,37 +266,51 @@ namespace dejavu::search_strategy {
                 _col += _col_sz;
             }
 
-            for(int i = 0; i < g->v_size; ++i) {
-                local_state.T->set_hash(0);
-                local_state.reset_trace_equal();
-                const int col = local_state.c->vertex_to_col[i];
-                const int col_sz = local_state.c->ptn[col] + 1;
+            for_each_vertex(local_state, setup, 0, g->v_size, [g, &inv, &original_colors](ir::controller& state,
+                                                                                           const int i) {
+                state.T->set_hash(0);
+                state.reset_trace_equal();
+                const int col = state.c->vertex_to_col[i];
+                const int col_sz = state.c->ptn[col] + 1;
                 if(col_sz >= 2) {
-                    local_state.move_to_child(g, i);
-                    inv[i] += local_state.T->get_hash();
+                    state.move_to_child(g, i);
+                    inv[i] += state.T->get_hash();
                     for(int _col = 0; _col < g->v_size;) {
-                        const int _col_sz = local_state.c->ptn[_col] + 1;
+                        const int _col_sz = state.c->ptn[_col] + 1;
                         if (_col_sz >= 2 && _col_sz <= 16 && !original_colors.get(_col)) {
                             for (int jj = _col; jj < _col + _col_sz; ++jj) {
-                                const int j = local_state.c->lab[jj];
-                                local_state.move_to_child(g, j);
-                                inv[i] += local_state.T->get_hash();
-                                local_state.move_to_parent();
+                                const int j = state.c->lab[jj];
+                                state.move_to_child(g, j);
+                                inv[i] += state.T->get_hash();
+                                state.move_to_parent();
                             }
                         }
                         _col += _col_sz;
                     }
-                    local_state.move_to_parent();
+                    state.move_to_parent();
                 } else {
                     inv[i] = 0;
                 }
-            }
+            });
 
             local_state.use_trace_early_out(false);
             local_state.use_increase_deviation(false);
             local_state.use_split_limit(false);
         }
 
+        /**
+         * Stores or restores the state kept across restarts, i.e., the group size and the vertices found by previous
+         * inprocessing.
+         */
+        template<class A>
+        void serialize(A& ar) {
+            s_grp_sz.serialize(ar);
+            ar.value(h_splits_hint);
+            ar.values(inproc_can_individualize);
+            ar.values(inproc_maybe_individualize);
+            ar.values(inproc_fixed_points);
+        }
+
         /**
          * Give hint as to how deep we need to look for shallow invariants.
          * @param splits_hint the hint
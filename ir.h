@@ -5,6 +5,10 @@
 #ifndef DEJAVU_IR_H
 #define DEJAVU_IR_H
 
+#include <list>
+#include <bit>
+#include <unordered_map>
+#include <unordered_set>
 #include "refinement.h"
 #include "coloring.h"
 #include "graph.h"
@@ -35,36 +39,355 @@ namespace dejavu {
          */
         typedef int type_selector_hook(const coloring *, const int);
 
+        /**
+         * \brief Difference of a coloring to the coloring of its parent IR node
+         *
+         * Individualizing a vertex and refining only changes the cells of the parent coloring which are split. The
+         * delta stores the contents of these cells after refinement, which suffices to restore the coloring from the
+         * coloring of the parent.
+         */
+        struct coloring_delta {
+            int cells = 0;           /**< number of cells of the coloring                       */
+            std::vector<int> colors; /**< colors of the cells which differ from the parent      */
+            std::vector<int> lab;    /**< contents of lab of these cells, in order of \a colors */
+            std::vector<int> ptn;    /**< contents of ptn of these cells, in order of \a colors */
+
+            /**
+             * Records the given cells of a coloring.
+             *
+             * @param c the coloring
+             * @param changed colors of the cells of \p c which differ from the parent coloring, where every position of
+             * a changed cell of the parent must be covered by one of these cells
+             */
+            void record(const coloring& c, const std::vector<int>& changed) {
+                cells  = c.cells;
+                colors = changed;
+                lab.clear();
+                ptn.clear();
+                for(const int col : colors) {
+                    const int col_sz = c.ptn[col] + 1;
+                    lab.insert(lab.end(), c.lab + col, c.lab + col + col_sz);
+                    ptn.insert(ptn.end(), c.ptn + col, c.ptn + col + col_sz);
+                }
+            }
+
+            /**
+             * Applies the delta to the coloring of the parent, which turns it into the recorded coloring.
+             *
+             * @param c the coloring of the parent
+             */
+            void apply(coloring* c) const {
+                int pt = 0;
+                for(const int col : colors) {
+                    const int col_sz = ptn[pt] + 1;
+                    for(int i = col; i < col + col_sz; ++i, ++pt) {
+                        const int u = lab[pt];
+                        c->lab[i] = u;
+                        c->ptn[i] = ptn[pt];
+                        c->vertex_to_lab[u] = i;
+                        c->vertex_to_col[u] = col;
+                    }
+                }
+                c->cells = cells;
+            }
+
+            /**
+             * @return approximate number of bytes used by this delta
+             */
+            [[nodiscard]] long bytes() const {
+                return static_cast<long>(sizeof(int) * (colors.size() + lab.size() + ptn.size()));
+            }
+        };
+
         /**
          * \brief Reduced IR save state
          *
          * Using this class, partial information of a state of an IR computation can be stored. Using this information,
          * IR computations can be resumed from this state either using BFS or random walks. The state in particular does not
          * keep enough information to resume using DFS.
+         *
+         * A state can also be saved "base-only" (see \a save_base_only), in which case it does not keep a coloring.
+         * Instead, it refers to the nearest ancestor in the IR tree which does keep a coloring (its checkpoint), and
+         * the coloring is recomputed from the checkpoint whenever the state is loaded (see
+         * \a controller::load_reduced_state).
+         *
+         * Alternatively, a state can be saved as a delta to its parent (see \a save_delta), in which case it only keeps
+         * the cells of its coloring which differ from the coloring of the parent. Loading the state then loads the
+         * parent, and applies the delta.
+         *
+         * Lastly, a state can keep its coloring in external storage, such as a memory-mapped file (see
+         * \a save_spilled). Only `lab` and `ptn` of the coloring are kept, the remaining arrays are restored when the
+         * state is loaded.
          */
         class limited_save {
-            // TODO enable a "compressed state" only consisting of base (but code outside should be oblivious to it)
             // TODO this is only supposed to be an "incomplete" state -- should there be complete states?
 
             std::vector<int> base_vertex; /**< base of vertices of this IR node  */
             coloring c;                   /**< vertex coloring of this IR node   */
-            unsigned long invariant = 0;  /**< hash of invariant of this IR node */
+            hash128 invariant;            /**< hash of invariant of this IR node */
             int trace_position = 0;       /**< position of trace of this IR node */
             int base_position  = 0;       /**< length of base of this IR node    */
+            limited_save* checkpoint = nullptr; /**< ancestor keeping a coloring, if this state is base-only */
+            limited_save* parent     = nullptr; /**< parent, if this state is saved as a delta              */
+            coloring_delta delta;               /**< difference of coloring to \a parent                    */
+            const int* spilled = nullptr;       /**< `lab` followed by `ptn` of the coloring, if spilled     */
+            int spilled_size   = 0;             /**< domain size of the spilled coloring                     */
         public:
-            void save(std::vector<int>& s_base_vertex, coloring &s_c, unsigned long s_invariant, int s_trace_position,
+            void save(std::vector<int>& s_base_vertex, coloring &s_c, hash128 s_invariant, int s_trace_position,
                       int s_base_position) {
                 this->base_vertex = s_base_vertex;
                 this->c.copy_any(&s_c);
                 this->invariant = s_invariant;
                 this->trace_position = s_trace_position;
                 this->base_position = s_base_position;
+                this->checkpoint = nullptr;
+                if(is_delta()) this->delta = coloring_delta();
+                this->parent = nullptr;
+                this->spilled = nullptr;
             }
 
             /**
-             * @return coloring of this IR node
+             * Saves a state without its coloring. The coloring can be recomputed by individualizing the base from
+             * \p s_checkpoint onwards.
+             *
+             * @param s_checkpoint an ancestor of this IR node which keeps its (possibly delta-encoded) coloring, must
+             * outlive this state
+             */
+            void save_base_only(std::vector<int>& s_base_vertex, limited_save* s_checkpoint, hash128 s_invariant,
+                                int s_trace_position, int s_base_position) {
+                assert(s_checkpoint != nullptr && !s_checkpoint->is_base_only());
+                assert(s_checkpoint->get_base_position() < s_base_position);
+                this->base_vertex = s_base_vertex;
+                this->invariant = s_invariant;
+                this->trace_position = s_trace_position;
+                this->base_position = s_base_position;
+                this->checkpoint = s_checkpoint;
+                if(is_delta()) this->delta = coloring_delta();
+                this->parent = nullptr;
+                this->spilled = nullptr;
+            }
+
+            /**
+             * Saves a state, keeping only the difference of its coloring to the coloring of its parent.
+             *
+             * @param s_parent the parent of this IR node, which must not be base-only, and must outlive this state
+             * @param s_c the coloring of this IR node
+             * @param s_changed colors of the cells of \p s_c which differ from the coloring of \p s_parent (see
+             * \a coloring_delta::record)
+             */
+            void save_delta(std::vector<int>& s_base_vertex, limited_save* s_parent, coloring &s_c,
+                            const std::vector<int>& s_changed, hash128 s_invariant, int s_trace_position,
+                            int s_base_position) {
+                assert(s_parent != nullptr && !s_parent->is_base_only());
+                assert(s_parent->get_base_position() + 1 == s_base_position);
+                this->base_vertex = s_base_vertex;
+                this->delta.record(s_c, s_changed);
+                this->invariant = s_invariant;
+                this->trace_position = s_trace_position;
+                this->base_position = s_base_position;
+                this->checkpoint = nullptr;
+                this->parent = s_parent;
+                this->spilled = nullptr;
+            }
+
+            /**
+             * Saves a state, keeping `lab` and `ptn` of its coloring in the given external storage.
+             *
+             * @param s_storage array of at least `2 * s_c.domain_size` integers, which must outlive this state
+             */
+            void save_spilled(std::vector<int>& s_base_vertex, coloring &s_c, int* s_storage, hash128 s_invariant,
+                              int s_trace_position, int s_base_position) {
+                std::copy(s_c.lab, s_c.lab + s_c.domain_size, s_storage);
+                std::copy(s_c.ptn, s_c.ptn + s_c.domain_size, s_storage + s_c.domain_size);
+                this->base_vertex = s_base_vertex;
+                this->invariant = s_invariant;
+                this->trace_position = s_trace_position;
+                this->base_position = s_base_position;
+                this->checkpoint = nullptr;
+                if(is_delta()) this->delta = coloring_delta();
+                this->parent = nullptr;
+                this->spilled = s_storage;
+                this->spilled_size = s_c.domain_size;
+            }
+
+            /**
+             * Restores the coloring of a spilled state.
+             *
+             * @param out coloring to which the coloring of this state is written
+             */
+            void load_spilled(coloring* out) const {
+                assert(is_spilled());
+                const int n = spilled_size;
+                if(out->domain_size != n) out->initialize(n);
+                std::copy(spilled, spilled + n, out->lab);
+                std::copy(spilled + n, spilled + 2 * n, out->ptn);
+                complete_coloring(out);
+            }
+
+            /**
+             * Computes `cells`, `vertex_to_col` and `vertex_to_lab` of a coloring from its `lab` and `ptn`.
+             */
+            static void complete_coloring(coloring* out) {
+                const int n = out->domain_size;
+                out->cells = 0;
+                for(int col = 0; col < n; col += out->ptn[col] + 1) {
+                    ++out->cells;
+                    for(int i = col; i <= col + out->ptn[col]; ++i) {
+                        out->vertex_to_col[out->lab[i]] = col;
+                        out->vertex_to_lab[out->lab[i]] = i;
+                    }
+                }
+            }
+
+            /**
+             * Stores this state. States referred to by this state (its checkpoint or parent) are stored as indices.
+             *
+             * @param ar the writer
+             * @param index_of returns the index of a state this state refers to
+             */
+            template<class F>
+            void serialize(ds::binary_writer& ar, F&& index_of) {
+                const int kind = is_base_only() ? 1 : (is_delta() ? 2 : (is_spilled() ? 3 : 0));
+                ar.value(kind);
+                ar.values(base_vertex);
+                ar.value(invariant.low);
+                ar.value(invariant.high);
+                ar.value(trace_position);
+                ar.value(base_position);
+                switch(kind) {
+                    case 0:
+                        ar.value(c.domain_size);
+                        ar.values(c.lab, c.domain_size);
+                        ar.values(c.ptn, c.domain_size);
+                        break;
+                    case 1:
+                        ar.value(index_of(checkpoint));
+                        break;
+                    case 2:
+                        ar.value(index_of(parent));
+                        ar.value(delta.cells);
+                        ar.values(delta.colors);
+                        ar.values(delta.lab);
+                        ar.values(delta.ptn);
+                        break;
+                    default:
+                        ar.value(spilled_size);
+                        ar.values(spilled, 2 * static_cast<long>(spilled_size));
+                        break;
+                }
+            }
+
+            /**
+             * Restores a state stored by \a serialize.
+             *
+             * @param ar the reader
+             * @param save_at returns the state with the given index, which must be restored already
+             * @param spill_storage returns storage for a spilled coloring of the given domain size, or `nullptr` in
+             * which case the coloring is kept in memory instead
+             */
+            template<class F, class G>
+            void serialize(ds::binary_reader& ar, F&& save_at, G&& spill_storage) {
+                int kind = 0;
+                ar.value(kind);
+                ar.values(base_vertex);
+                ar.value(invariant.low);
+                ar.value(invariant.high);
+                ar.value(trace_position);
+                ar.value(base_position);
+                checkpoint = nullptr;
+                parent     = nullptr;
+                spilled    = nullptr;
+                delta      = coloring_delta();
+
+                long index = 0;
+                int  n     = 0;
+                switch(kind) {
+                    case 1:
+                        ar.value(index);
+                        checkpoint = save_at(index);
+                        break;
+                    case 2:
+                        ar.value(index);
+                        parent = save_at(index);
+                        ar.value(delta.cells);
+                        ar.values(delta.colors);
+                        ar.values(delta.lab);
+                        ar.values(delta.ptn);
+                        break;
+                    default: {
+                        ar.value(n);
+                        if(!ar.good() || n < 0) return;
+                        int* storage = (kind == 3) ? spill_storage(n) : nullptr;
+                        if(storage != nullptr) {
+                            ar.values(storage, 2 * static_cast<long>(n));
+                            spilled      = storage;
+                            spilled_size = n;
+                        } else {
+                            if(c.domain_size != n) c.initialize(n);
+                            ar.values(c.lab, n);
+                            ar.values(c.ptn, n);
+                            complete_coloring(&c);
+                        }
+                        break;
+                    }
+                }
+            }
+
+            /**
+             * @return whether this state does not keep a coloring
+             */
+            [[nodiscard]] bool is_base_only() const {
+                return checkpoint != nullptr;
+            }
+
+            /**
+             * @return whether this state keeps its coloring as a delta to its parent
+             */
+            [[nodiscard]] bool is_delta() const {
+                return parent != nullptr;
+            }
+
+            /**
+             * @return whether this state keeps its coloring in external storage
+             */
+            [[nodiscard]] bool is_spilled() const {
+                return spilled != nullptr;
+            }
+
+            /**
+             * @return whether this state keeps its complete coloring, i.e., whether \a get_coloring can be used
+             */
+            [[nodiscard]] bool has_coloring() const {
+                return !is_base_only() && !is_delta() && !is_spilled();
+            }
+
+            /**
+             * @return parent of this IR node, if this state is saved as a delta
+             */
+            limited_save* get_parent() {
+                return parent;
+            }
+
+            /**
+             * @return difference of the coloring of this IR node to the coloring of its parent
+             */
+            [[nodiscard]] const coloring_delta& get_delta() const {
+                return delta;
+            }
+
+            /**
+             * @return the nearest ancestor keeping a (possibly delta-encoded) coloring, if this state is base-only, or
+             * this state otherwise
+             */
+            limited_save* get_checkpoint() {
+                return is_base_only() ? checkpoint : this;
+            }
+
+            /**
+             * @return coloring of this IR node, must neither be base-only, a delta, nor spilled
              */
             coloring *get_coloring() {
+                assert(has_coloring());
                 return &c;
             }
 
@@ -72,6 +395,13 @@ namespace dejavu {
              * @return hash of invariant of this IR node
              */
             [[nodiscard]] unsigned long get_invariant_hash() const {
+                return invariant.low;
+            }
+
+            /**
+             * @return full hash of invariant of this IR node (see \a trace::get_hash128)
+             */
+            [[nodiscard]] hash128 get_invariant_hash128() const {
                 return invariant;
             }
 
@@ -97,6 +427,172 @@ namespace dejavu {
             }
         };
 
+        /**
+         * \brief Memoizes color refinement near the start of random walks
+         *
+         * Random walks start from the same few IR nodes over and over again, and thus revisit the first levels below
+         * these nodes. For an IR node identified by its base, the cache stores the result of individualizing a vertex
+         * and refining: the cells of the coloring that were changed, as well as the state of the trace afterwards. A
+         * later walk through the same node can then apply the stored cells instead of refining again.
+         *
+         * Entries are only valid for a fixed root coloring and comparison trace, i.e., the cache must be cleared
+         * whenever either changes. The cache is limited to a budget of memory, and evicts the least recently used
+         * entries first.
+         */
+        class refinement_cache {
+        public:
+            /**
+             * \brief Result of individualizing a vertex and refining, for one IR node
+             */
+            struct entry {
+                unsigned long    key = 0;        /**< hash of \a base                                        */
+                std::vector<int> base;           /**< base of the resulting IR node                          */
+
+                int settings = 0;                /**< settings of the trace early out used for refinement    */
+                unsigned long hash_before = 0;   /**< hash of trace of the parent node                       */
+                int position_before  = 0;        /**< position of trace of the parent node                   */
+                int deviation_before = 0;        /**< trace deviations counted before refinement, if used    */
+
+                hash128 hash_after;              /**< hash of trace of the resulting node                    */
+                int position_after  = 0;         /**< position of trace of the resulting node                */
+                int deviations      = 0;         /**< trace deviations counted during refinement             */
+                bool trace_equal    = true;      /**< whether trace is still equal to comparison trace       */
+                int splits = 0;                  /**< number of splits performed by refinement               */
+                coloring_delta delta;            /**< cells which were changed by refinement                 */
+
+                /**
+                 * @return approximate number of bytes used by this entry
+                 */
+                [[nodiscard]] long bytes() const {
+                    return static_cast<long>(sizeof(entry) + sizeof(int) * base.size()) + delta.bytes() + 64;
+                }
+            };
+
+        private:
+            std::list<entry> entries; /**< entries, the most recently used one first */
+            std::unordered_map<unsigned long, std::list<entry>::iterator> index; /**< entries by key */
+            std::unordered_set<unsigned long> seen; /**< keys which were looked up, but are not cached (yet) */
+
+            int  h_levels = 0;      /**< how many levels below a loaded IR node are cached */
+            long h_memory = 0;      /**< memory budget in bytes                            */
+            long s_memory = 0;      /**< memory currently used in bytes                    */
+
+            void evict() {
+                s_memory -= entries.back().bytes();
+                index.erase(entries.back().key);
+                entries.pop_back();
+            }
+
+        public:
+            long s_hits   = 0; /**< number of successful lookups */
+            long s_misses = 0; /**< number of failed lookups     */
+
+            /**
+             * @return key of the IR node with base \p base, extended by \p v
+             */
+            static unsigned long make_key(const std::vector<int>& base, const int v) {
+                unsigned long key = base.size() + 1;
+                for(const int b : base) key = add_to_hash(key, static_cast<int>(hash(b)));
+                return add_to_hash(key, static_cast<int>(hash(v)));
+            }
+
+            /**
+             * Sets up the cache, and clears it.
+             *
+             * @param levels how many levels below a loaded IR node are cached
+             * @param memory budget in bytes
+             */
+            void configure(const int levels, const long memory) {
+                h_levels = levels;
+                h_memory = memory;
+                clear();
+            }
+
+            /**
+             * @return how many levels below a loaded IR node are cached
+             */
+            [[nodiscard]] int levels() const {
+                return h_levels;
+            }
+
+            /**
+             * Removes all entries.
+             */
+            void clear() {
+                entries.clear();
+                index.clear();
+                seen.clear();
+                s_memory = 0;
+            }
+
+            /**
+             * Looks up the result of individualizing \p v in the IR node with base \p base. The entry also has to match
+             * the given state of the trace.
+             *
+             * @param key the key, i.e., `make_key(base, v)`
+             * @return the entry, or `nullptr` if there is no matching entry
+             */
+            entry* lookup(const unsigned long key, const std::vector<int>& base, const int v, const int settings,
+                          const unsigned long hash_before, const int position_before, const int deviation_before) {
+                const auto it = index.find(key);
+                if(it == index.end()) {
+                    ++s_misses;
+                    return nullptr;
+                }
+
+                entry& e = *it->second;
+                const bool match = e.base.size() == base.size() + 1 && e.base.back() == v &&
+                                   std::equal(base.begin(), base.end(), e.base.begin()) && e.settings == settings &&
+                                   e.hash_before == hash_before && e.position_before == position_before &&
+                                   e.deviation_before == deviation_before;
+                if(!match) {
+                    ++s_misses;
+                    return nullptr;
+                }
+
+                ++s_hits;
+                entries.splice(entries.begin(), entries, it->second); // mark as most recently used
+                return &e;
+            }
+
+            /**
+             * Whether a result which was not found by \a lookup should be inserted. Most IR nodes of random walks are
+             * only visited once, so results are only inserted once the same key was looked up before.
+             *
+             * @param key the key
+             * @return whether to insert the result for \p key
+             */
+            bool admit(const unsigned long key) {
+                if(seen.erase(key) > 0) return true;
+                if(static_cast<long>(seen.size()) * 64 > h_memory) seen.clear();
+                seen.insert(key);
+                return false;
+            }
+
+            /**
+             * Inserts an entry, replacing the entry of the same IR node, if any. Evicts the least recently used
+             * entries until the entry fits into the memory budget.
+             *
+             * @param e the entry, where \a key and \a base must be set
+             */
+            void insert(entry&& e) {
+                const long e_bytes = e.bytes();
+                if(e_bytes > h_memory) return;
+
+                const auto it = index.find(e.key);
+                if(it != index.end()) {
+                    s_memory -= it->second->bytes();
+                    entries.erase(it->second);
+                    index.erase(it);
+                }
+                while(s_memory + e_bytes > h_memory) evict();
+
+                entries.push_front(std::move(e));
+                index[entries.front().key] = entries.begin();
+                s_memory += e_bytes;
+            }
+        };
+
         /**
          * \brief Tracks information for a base point
          */
@@ -104,18 +600,31 @@ namespace dejavu {
             int color; /**< color of the base point */
             int color_sz; /**< color size of the base point */
             int cells; /**< number of cells of the coloring*/
-            int touched_color_list_pt; /**< position of the touched color list */
+            int undo_log_pt; /**< position of the undo log */
             int singleton_pt; /**< position of the singleton list */
 
             int  trace_pos; /**< position of the trace */
-            unsigned long trace_hash; /**< hash of the trace */
+            hash128 trace_hash; /**< hash of the trace */
 
-            base_info(int color, int colorSz, int cells, int touchedColorListPt, int singletonPt, int tracePos,
-                      unsigned long traceHash) :
-                      color(color), color_sz(colorSz), cells(cells), touched_color_list_pt(touchedColorListPt),
+            base_info(int color, int colorSz, int cells, int undoLogPt, int singletonPt, int tracePos,
+                      hash128 traceHash) :
+                      color(color), color_sz(colorSz), cells(cells), undo_log_pt(undoLogPt),
                       singleton_pt(singletonPt), trace_pos(tracePos), trace_hash(traceHash) {}
         };
 
+        /**
+         * \brief Entry of the undo log of a controller, recording that a color was split off from another color
+         *
+         * Entries of one level of the base are stored contiguously, in the order in which colors were split off. The
+         * size of the new color is recorded as well: since colors split off later are reverted first, it is the size of
+         * the new color when the entry is reverted, which therefore does not need to be read from the coloring.
+         */
+        struct split_record {
+            int old_color;    /**< color from which \a new_color was split off */
+            int new_color;    /**< the new color                               */
+            int new_color_sz; /**< size of \a new_color when it was split off  */
+        };
+
         /**
          * \brief Controls movement in IR tree
          *
@@ -154,8 +663,7 @@ namespace dejavu {
             std::vector<base_info> internal_compare_base;        /** additional info of the comparison base */
 
             markset  touched_color; /**< were changes in this color already tracked? */
-            worklist  touched_color_list; /**< color touched_color_list[i] was changed... */
-            worklist  prev_color_list; /**< ...and its vertices were previously of color prev_color_list[i]  */
+            worklist_t<split_record> undo_log; /**< colors split off along the current base, to revert refinement */
 
             // the following workspaces are only used for the paired color dfs (AKA the saucy-style dfs) -- not needed
             // for normal bfs, dfs, or random search operation
@@ -169,11 +677,6 @@ namespace dejavu {
                                          *there is also no point in tracking it anymore since they are not isomorphic */
             int singleton_pt_start = 0; /**< a pointer were we need to start reading singletons */
 
-            // hooks for color refinement -- this controller hooks into the color refinement algorithm to gather
-            // necessary information
-            std::function<type_split_color_hook>     my_split_hook; /**< split hook for color refinement */
-            std::function<type_worklist_color_hook>  my_worklist_hook; /**< worklist hook for color refinement */
-
             // settings
             ir_mode mode = IR_MODE_RECORD_TRACE; /**< which mode are we operating in currently? */
 
@@ -190,8 +693,23 @@ namespace dejavu {
             bool h_use_split_limit = false;
             int  h_split_limit     = 0;
 
+            int  h_compact_trace   = 0; /**< if positive, \a compare_to_this compacts the comparison trace to hashes of
+                                          *  blocks of this many operations (see \a trace::compact) */
+
             int  s_splits = 0;
 
+            // memoization of color refinement, see \ref refinement_cache
+            refinement_cache  m_cache;              /**< cached refinements below loaded IR nodes              */
+            bool              h_cache_active = false; /**< whether \a m_cache is used right now               */
+            int               s_cache_start  = 0;     /**< base position of the last loaded IR node            */
+
+            // recording of cells changed by refinement, for \ref refinement_cache and \ref coloring_delta
+            bool              h_delta_record  = false; /**< record changed cells of every \a move_to_child     */
+            bool              s_record_splits = false; /**< whether splits are recorded right now              */
+            markset           split_touched;         /**< colors changed by the current refinement            */
+            std::vector<int>  split_colors;          /**< ...and in a list                                     */
+            std::vector<limited_save*> delta_chain;  /**< workspace to load delta-encoded states              */
+
             /**
              * Marks all colors of the current coloring as "touched". Used on the initial coloring, since we never want
              * to "revert" these colors.
@@ -209,8 +727,7 @@ namespace dejavu {
              */
             void reset_touched() {
                 touched_color.reset();
-                touched_color_list.reset();
-                prev_color_list.reset();
+                undo_log.reset();
                 touch_initial_colors();
             }
 
@@ -226,17 +743,31 @@ namespace dejavu {
             /**
              * The split hook function used for color refinement. Tracks the trace invariant, touched colors and
              * singletons. Provides early out functionality using the trace and/or number of cells.
+             *
+             * @tparam hook_mode the mode the controller is in, i.e., \a mode
              */
+            template<ir_mode hook_mode>
             bool split_hook(const int old_color, const int new_color, const int new_color_sz) {
-                if (mode != IR_MODE_COMPARE_TRACE_IRREVERSIBLE) {
+                assert(hook_mode == mode);
+                if constexpr (hook_mode != IR_MODE_COMPARE_TRACE_IRREVERSIBLE) {
                     // write singletons to singleton list
                     if (new_color_sz == 1) singletons.push_back(c->lab[new_color]);
 
                     // record colors that were changed
                     if (!touched_color.get(new_color)) {
                         touched_color.set(new_color);
-                        prev_color_list.push_back(old_color);
-                        touched_color_list.push_back(new_color);
+                        undo_log.push_back({old_color, new_color, new_color_sz});
+                    }
+                }
+                if (s_record_splits) {
+                    // record colors that were changed, for the refinement cache or deltas
+                    if (!split_touched.get(old_color)) {
+                        split_touched.set(old_color);
+                        split_colors.push_back(old_color);
+                    }
+                    if (!split_touched.get(new_color)) {
+                        split_touched.set(new_color);
+                        split_colors.push_back(new_color);
                     }
                 }
 
@@ -247,7 +778,7 @@ namespace dejavu {
                 s_deviation_inc_current += (!cont);
                 const bool deviation_override = h_deviation_inc_active && (s_deviation_inc_current <= h_deviation_inc);
 
-                const bool continue_cell_limit = !((mode != IR_MODE_RECORD_TRACE) && T->trace_equal()
+                const bool continue_cell_limit = !((hook_mode != IR_MODE_RECORD_TRACE) && T->trace_equal()
                                                    && s_base_pos - 1 < static_cast<int>(compare_base->size())
                                                    && (*compare_base)[s_base_pos - 1].cells == c->cells);
                 ++s_splits;
@@ -255,12 +786,19 @@ namespace dejavu {
                 return continue_split_limit && continue_cell_limit && (cont || deviation_override);
             }
 
-            std::function<type_split_color_hook> self_split_hook() {
-                return [this](auto && PH1, auto && PH2, auto && PH3) { return
-                        split_hook(std::forward<decltype(PH1)>(PH1), std::forward<decltype(PH2)>(PH2),
-                                std::forward<decltype(PH3)>(PH3));
-                };
-            }
+            /**
+             * \brief Split hook policy of this controller for color refinement, for a fixed mode
+             *
+             * Since the mode is a compile-time constant, the hook is specialized to the mode and inlined into the
+             * color refinement.
+             */
+            template<ir_mode hook_mode>
+            struct split_policy {
+                controller* state;
+                bool operator()(const int old_color, const int new_color, const int new_color_sz) const {
+                    return state->split_hook<hook_mode>(old_color, new_color, new_color_sz);
+                }
+            };
 
 
             /**
@@ -286,12 +824,15 @@ namespace dejavu {
                 return true;
             }
 
-            std::function<type_worklist_color_hook> self_worklist_hook() {
-                return [this](auto && PH1, auto && PH2) {
-                    return worklist_hook(std::forward<decltype(PH1)>(PH1),
-                                       std::forward<decltype(PH2)>(PH2));
-                };
-            }
+            /**
+             * \brief Worklist hook policy of this controller for color refinement
+             */
+            struct worklist_policy {
+                controller* state;
+                bool operator()(const int color, const int color_sz) const {
+                    return state->worklist_hook(color, color_sz);
+                }
+            };
 
             /**
              * Vertex v is now differing.
@@ -376,14 +917,10 @@ namespace dejavu {
                 cT = &internal_T2;
 
                 touched_color.initialize(c->domain_size);
-                touched_color_list.allocate(c->domain_size);
-                prev_color_list.allocate(c->domain_size);
+                undo_log.allocate(c->domain_size);
 
                 touch_initial_colors();
 
-                my_split_hook = self_split_hook();
-                my_worklist_hook = self_worklist_hook();
-
                 diff_tester.initialize(c->domain_size);
 
                 diff_vertices.initialize(c->domain_size);
@@ -416,6 +953,7 @@ namespace dejavu {
                 internal_compare_base.clear();
                 internal_compare_base_vertex.clear();
                 internal_compare_singletons.clear();
+                m_cache.clear();
             }
 
             /**
@@ -592,14 +1130,14 @@ namespace dejavu {
              * @return whether there is a difference
              */
             bool update_diff_vertices_last_individualization(const controller& other_state) {
-                int i = base.back().touched_color_list_pt;
-                if(touched_color_list.cur_pos != other_state.touched_color_list.cur_pos) {
+                int i = base.back().undo_log_pt;
+                if(undo_log.cur_pos != other_state.undo_log.cur_pos) {
                     diff_diverge = true;
                     return true;
                 }
-                for(;i < touched_color_list.cur_pos; ++i) {
-                    const int old_color = prev_color_list[i];
-                    const int new_color = touched_color_list[i];
+                for(;i < undo_log.cur_pos; ++i) {
+                    const int old_color = undo_log[i].old_color;
+                    const int new_color = undo_log[i].new_color;
 
                     assert(old_color != new_color);
 
@@ -628,15 +1166,17 @@ namespace dejavu {
              * trace).
              *
              * @param state the other state which is copied
+             * @param share_refinement whether to also use the refinement workspace of \p state, must be false if both
+             *                         controllers are used concurrently
              */
-            void __attribute__((noinline)) link_compare(controller* state) {
+            void __attribute__((noinline)) link_compare(controller* state, bool share_refinement = true) {
                 this->c->copy_any(state->c);
 
                 T->set_compare(true);
                 T->set_record(false);
                 T->set_compare_trace(state->T->get_compare_trace());
                 T->set_position(state->T->get_position());
-                T->set_hash(state->T->get_hash());
+                T->set_hash128(state->T->get_hash128());
 
                 base_vertex = state->base_vertex;
                 base        = state->base;
@@ -648,15 +1188,15 @@ namespace dejavu {
                 mode = state->mode;
 
                 touched_color.copy(&state->touched_color);
-                prev_color_list.copy(&state->prev_color_list);
-                touched_color_list.copy(&state->touched_color_list);
+                undo_log.copy(&state->undo_log);
 
                 //singletons         = state->singletons;
                 compare_singletons = state->compare_singletons;
 
                 s_base_pos = state->s_base_pos;
+                m_cache.clear();
 
-                this->R = state->R;
+                if(share_refinement) this->R = state->R;
             }
 
             /**
@@ -673,7 +1213,7 @@ namespace dejavu {
                 T->set_record(false);
                 T->set_compare_trace(state->T);
                 T->set_position(state->T->get_position());
-                T->set_hash(state->T->get_hash());
+                T->set_hash128(state->T->get_hash128());
 
                 base_vertex = state->base_vertex;
                 base        = state->base;
@@ -685,12 +1225,12 @@ namespace dejavu {
                 mode = state->mode;
 
                 touched_color.copy(&state->touched_color);
-                prev_color_list.copy(&state->prev_color_list);
-                touched_color_list.copy(&state->touched_color_list);
+                undo_log.copy(&state->undo_log);
                 singletons         = state->singletons;
                 compare_singletons = &state->singletons;
 
                 s_base_pos = state->s_base_pos;
+                m_cache.clear();
 
                 this->R = state->R;
             }
@@ -724,6 +1264,24 @@ namespace dejavu {
 
                 leaf_color.copy_any(c);
                 mode = ir::IR_MODE_COMPARE_TRACE_REVERSIBLE;
+                m_cache.clear(); // comparison trace changed
+
+                if(h_compact_trace > 0) {
+                    cT->compact(h_compact_trace);
+                    T->set_compare_trace(cT); // re-synchronize with the compacted trace
+                }
+            }
+
+            /**
+             * Whether \a compare_to_this only keeps hashes of blocks of the comparison trace, instead of the full
+             * trace (see \a trace::compact). This reduces the memory used by the comparison trace by a factor of
+             * roughly \p stride / 2, but deviations from the comparison trace are only detected at the end of each
+             * block, and may go unnoticed in blocks which are only compared partially.
+             *
+             * @param stride number of operations per block, or 0 to keep the full trace
+             */
+            void use_compact_trace(int stride) {
+                h_compact_trace = std::max(stride, 0);
             }
 
             void reserve() {
@@ -810,24 +1368,75 @@ namespace dejavu {
              * @param state A reference to the limited_save in which the state will be stored.
              */
             void save_reduced_state(limited_save &state) {
-                state.save(base_vertex, *c, T->get_hash(), T->get_position(),
+                state.save(base_vertex, *c, T->get_hash128(), T->get_position(),
                            s_base_pos);
             }
 
             /**
-             * Load a partial state into this controller.
+             * Save a partial state of this controller, keeping its coloring in external storage (see
+             * \a limited_save::save_spilled).
+             *
+             * @param state A reference to the limited_save in which the state will be stored.
+             * @param storage Array of at least twice the domain size, which must outlive \p state.
+             */
+            void save_reduced_state_spilled(limited_save &state, int* storage) {
+                state.save_spilled(base_vertex, *c, storage, T->get_hash128(), T->get_position(), s_base_pos);
+            }
+
+            /**
+             * Save a partial state of this controller, without its coloring (see \a limited_save::save_base_only).
+             *
+             * @param state A reference to the limited_save in which the state will be stored.
+             * @param checkpoint An ancestor of the current IR node which keeps its coloring.
+             */
+            void save_reduced_state_base_only(limited_save &state, limited_save* checkpoint) {
+                state.save_base_only(base_vertex, checkpoint, T->get_hash128(), T->get_position(), s_base_pos);
+            }
+
+            /**
+             * @return size of the delta recorded during the last call of \a move_to_child, in number of vertices (see
+             * \a use_delta_recording)
+             */
+            [[nodiscard]] int recorded_delta_size() const {
+                int sz = 0;
+                for(const int col : split_colors) sz += c->ptn[col] + 1;
+                return sz;
+            }
+
+            /**
+             * Save a partial state of this controller, keeping only the cells changed by the last call of
+             * \a move_to_child (see \a limited_save::save_delta). Requires \a use_delta_recording, and that the last call
+             * of \a move_to_child started from \p parent.
+             *
+             * @param state A reference to the limited_save in which the state will be stored.
+             * @param parent The parent of the current IR node.
+             */
+            void save_reduced_state_delta(limited_save &state, limited_save* parent) {
+                assert(h_delta_record);
+                state.save_delta(base_vertex, parent, *c, split_colors, T->get_hash128(), T->get_position(), s_base_pos);
+            }
+
+            /**
+             * Load a partial state into this controller. If the state is base-only, its coloring is recomputed from
+             * its checkpoint, which requires the graph \p g. If the state is a delta, the deltas of its ancestors are
+             * applied to the nearest ancestor keeping a complete (possibly spilled) coloring.
              *
              * @param state A reference to the limited_save from which the state will be loaded.
+             * @param g The graph, only needed if \p state is base-only.
              */
-            void __attribute__((noinline)) load_reduced_state(limited_save &state) {
-                c->copy_any(state.get_coloring());
+            void __attribute__((noinline)) load_reduced_state(limited_save &state, sgraph* g = nullptr) {
+                if(state.is_base_only())    recompute_coloring(g, state);
+                else if(state.is_delta())   apply_delta_chain(state);
+                else if(state.is_spilled()) state.load_spilled(c);
+                else                        c->copy_any(state.get_coloring());
 
-                T->set_hash(state.get_invariant_hash());
+                T->set_hash128(state.get_invariant_hash128());
                 T->set_position(state.get_trace_position());
                 T->reset_trace_equal();
                 T->set_compare(true);
                 s_base_pos = state.get_base_position();
                 base_vertex = state.get_base();
+                s_cache_start = s_base_pos;
 
                 // these become meaningless, so clear them out
                 base.clear();
@@ -836,10 +1445,63 @@ namespace dejavu {
                 if(mode == IR_MODE_COMPARE_TRACE_REVERSIBLE) reset_touched();
             }
 
+        private:
+            /**
+             * Restores the coloring of a delta-encoded state, by copying the coloring of its nearest ancestor which
+             * keeps a complete coloring, and then applying the deltas on the path to the state.
+             *
+             * @param state The delta-encoded state.
+             */
+            void apply_delta_chain(limited_save &state) {
+                delta_chain.clear();
+                limited_save* ancestor = &state;
+                while(ancestor->is_delta()) {
+                    delta_chain.push_back(ancestor);
+                    ancestor = ancestor->get_parent();
+                }
+                if(ancestor->is_spilled()) ancestor->load_spilled(c);
+                else                       c->copy_any(ancestor->get_coloring());
+                for(auto it = delta_chain.rbegin(); it != delta_chain.rend(); ++it) (*it)->get_delta().apply(c);
+            }
+
+            /**
+             * Recomputes the coloring of a base-only state, by loading its checkpoint and individualizing the remaining
+             * base vertices. Refinement is performed in the same manner as in breadth-first search, which computed the
+             * state in the first place.
+             *
+             * Throws a \a std::logic_error if the recomputed state deviates from the stored one, since continuing with
+             * a wrong coloring would silently corrupt the search.
+             *
+             * @param g The graph.
+             * @param state The base-only state.
+             */
+            void recompute_coloring(sgraph* g, limited_save &state) {
+                assert(g != nullptr);
+                load_reduced_state(*state.get_checkpoint());
+
+                const ir_mode prev_mode          = mode;
+                const bool    prev_early_out     = h_trace_early_out;
+                const bool    prev_deviation_inc = h_deviation_inc_active;
+                mode = IR_MODE_COMPARE_TRACE_IRREVERSIBLE;
+                h_trace_early_out = true;
+                while(s_base_pos < state.get_base_position()) {
+                    h_deviation_inc_active = s_base_pos > 0;
+                    reset_trace_equal();
+                    move_to_child(g, state.get_base()[s_base_pos]);
+                    if(!T->trace_equal()) break;
+                }
+                mode                   = prev_mode;
+                h_trace_early_out      = prev_early_out;
+                h_deviation_inc_active = prev_deviation_inc;
+                if(s_base_pos != state.get_base_position() || T->get_hash() != state.get_invariant_hash())
+                    throw std::logic_error("recomputed base-only state deviates from the stored state");
+            }
+
+        public:
             // TODO: hopefully can be deprecated
             // TODO: problem this fixes: trace state is not reverted properly when moving to parent!
             void load_reduced_state_without_coloring(limited_save &state) {
-                T->set_hash(state.get_invariant_hash());
+                T->set_hash128(state.get_invariant_hash128());
                 T->set_position(state.get_trace_position());
                 T->reset_trace_equal();
                 T->set_compare(true);
@@ -918,6 +1580,151 @@ namespace dejavu {
              * @param v the vertex to be individualized
              */
             void move_to_child(sgraph *g, int v) {
+                if(h_delta_record) {
+                    split_touched.reset();
+                    split_colors.clear();
+                    s_record_splits = true;
+                }
+                switch(mode) {
+                    case IR_MODE_RECORD_TRACE:
+                        move_to_child_in_mode<IR_MODE_RECORD_TRACE>(g, v);
+                        break;
+                    case IR_MODE_COMPARE_TRACE_REVERSIBLE:
+                        move_to_child_in_mode<IR_MODE_COMPARE_TRACE_REVERSIBLE>(g, v);
+                        break;
+                    case IR_MODE_COMPARE_TRACE_IRREVERSIBLE:
+                        if (h_cache_active && s_base_pos < s_cache_start + m_cache.levels() && T->trace_equal() &&
+                            !h_use_split_limit)
+                            move_to_child_cached(g, v);
+                        else
+                            move_to_child_in_mode<IR_MODE_COMPARE_TRACE_IRREVERSIBLE>(g, v);
+                        break;
+                }
+                s_record_splits = false;
+            }
+
+            /**
+             * Whether to record the cells changed by each call of \a move_to_child, which is required to save states
+             * using \a save_reduced_state_delta.
+             *
+             * @param delta_record whether to record changed cells
+             */
+            void use_delta_recording(bool delta_record) {
+                if(delta_record) prepare_split_recording();
+                h_delta_record = delta_record;
+            }
+
+            /**
+             * Sets up the refinement cache, which memoizes \a move_to_child for the first \p levels individualizations
+             * after an IR node is loaded using \a load_reduced_state. The cache is only used while it is activated using
+             * \a use_refinement_cache, and only for non-reversible calls to \a move_to_child.
+             *
+             * @param levels how many levels below a loaded IR node are cached
+             * @param memory memory budget of the cache in bytes, least recently used entries are evicted first
+             */
+            void set_refinement_cache(int levels, long memory) {
+                m_cache.configure(levels, memory);
+                if(levels > 0) prepare_split_recording();
+            }
+
+            /**
+             * Whether to use the refinement cache set up by \a set_refinement_cache. Cached results are only valid for
+             * the root coloring and comparison trace they were computed with, so the cache must only be activated for
+             * computations which start from the root of the IR tree, or from a node saved after the last call of
+             * \a compare_to_this.
+             *
+             * @param cache_active whether to use the cache
+             */
+            void use_refinement_cache(bool cache_active) {
+                h_cache_active = cache_active && m_cache.levels() > 0;
+            }
+
+            /**
+             * @return the refinement cache
+             */
+            [[nodiscard]] const refinement_cache& get_refinement_cache() const {
+                return m_cache;
+            }
+
+        private:
+            void prepare_split_recording() {
+                split_touched.initialize(c->domain_size);
+                split_colors.reserve(c->domain_size);
+            }
+
+            /**
+             * Implementation of \a move_to_child in `IR_MODE_COMPARE_TRACE_IRREVERSIBLE`, using the refinement cache.
+             * If the cache contains the result for \p v in the current IR node, the cached cells and trace are applied.
+             * Otherwise, the coloring is refined and the result is inserted into the cache.
+             *
+             * @param g the graph
+             * @param v the vertex to be individualized
+             */
+            void move_to_child_cached(sgraph *g, int v) {
+                const int settings = h_trace_early_out + 2 * h_deviation_inc_active + 4 * h_deviation_inc;
+                const unsigned long hash_before = T->get_hash();
+                const int position_before  = T->get_position();
+                const int deviation_before = h_deviation_inc_active ? s_deviation_inc_current : 0;
+                const int deviation_start  = s_deviation_inc_current;
+
+                const unsigned long key = refinement_cache::make_key(base_vertex, v);
+                const refinement_cache::entry* cached = m_cache.lookup(key, base_vertex, v, settings, hash_before,
+                                                                       position_before, deviation_before);
+                if(cached != nullptr) {
+                    ++s_base_pos;
+                    base_vertex.push_back(v);
+
+                    cached->delta.apply(c);
+                    if(h_delta_record) split_colors = cached->delta.colors;
+
+                    T->set_hash128(cached->hash_after);
+                    T->set_position(cached->position_after);
+                    if(!cached->trace_equal) T->reset_trace_unequal();
+                    s_deviation_inc_current += cached->deviations;
+                    s_splits = cached->splits;
+                    return;
+                }
+
+                if(!m_cache.admit(key)) {
+                    move_to_child_in_mode<IR_MODE_COMPARE_TRACE_IRREVERSIBLE>(g, v);
+                    return;
+                }
+
+                if(!s_record_splits) {
+                    split_touched.reset();
+                    split_colors.clear();
+                    s_record_splits = true;
+                }
+                move_to_child_in_mode<IR_MODE_COMPARE_TRACE_IRREVERSIBLE>(g, v);
+
+                refinement_cache::entry e;
+                e.key              = key;
+                e.base             = base_vertex;
+                e.settings         = settings;
+                e.hash_before      = hash_before;
+                e.position_before  = position_before;
+                e.deviation_before = deviation_before;
+                e.hash_after       = T->get_hash128();
+                e.position_after   = T->get_position();
+                e.deviations       = s_deviation_inc_current - deviation_start;
+                e.trace_equal      = T->trace_equal();
+                e.splits           = s_splits;
+                e.delta.record(*c, split_colors);
+                m_cache.insert(std::move(e));
+            }
+
+            /**
+             * Implementation of \a move_to_child, specialized to the current mode of the controller.
+             *
+             * @tparam hook_mode the mode the controller is in, i.e., \a mode
+             * @param g the graph
+             * @param v the vertex to be individualized
+             */
+            template<ir_mode hook_mode>
+            void move_to_child_in_mode(sgraph *g, int v) {
+                split_policy<hook_mode> my_split_hook {this};
+                worklist_policy my_worklist_hook {this};
+
                 // always keep track of vertex base
                 ++s_base_pos;
                 s_splits = 0;
@@ -927,9 +1734,9 @@ namespace dejavu {
 
                 // some info maybe needed later
                 const int singleton_pt     = (int) singletons.size();
-                const int touched_color_pt = touched_color_list.cur_pos;
+                const int undo_log_pt      = undo_log.cur_pos;
                 const int trace_pos        = T->get_position();
-                const unsigned long trace_hash      = T->get_hash();
+                const hash128 trace_hash   = T->get_hash128();
 
                 // determine color
                 const int prev_col    = c->vertex_to_col[v];
@@ -943,14 +1750,12 @@ namespace dejavu {
 
                 // refine coloring
                 T->op_refine_start();
-                if (mode == IR_MODE_RECORD_TRACE) {
-                    R->refine_coloring(g, c, init_color_class, -1, &my_split_hook,
-                                       my_worklist_hook);
+                if constexpr (hook_mode == IR_MODE_RECORD_TRACE) {
+                    R->refine_coloring(g, c, init_color_class, -1, my_split_hook, my_worklist_hook);
                     if (s_cell_active) T->op_refine_cell_end();
                     T->op_refine_end();
                 } else {
-                    R->refine_coloring(g, c, init_color_class, -1, &my_split_hook,
-                                       my_worklist_hook);
+                    R->refine_coloring(g, c, init_color_class, -1, my_split_hook, my_worklist_hook);
                     if (T->trace_equal() && c->cells==(*compare_base)[s_base_pos - 1].cells) {
                         T->skip_to_individualization();
                     }
@@ -958,11 +1763,13 @@ namespace dejavu {
 
                 s_cell_active = false;
 
-                if (mode != IR_MODE_COMPARE_TRACE_IRREVERSIBLE)
-                    base.emplace_back(prev_col, prev_col_sz, c->cells, touched_color_pt, singleton_pt, trace_pos,
+                if constexpr (hook_mode != IR_MODE_COMPARE_TRACE_IRREVERSIBLE)
+                    base.emplace_back(prev_col, prev_col_sz, c->cells, undo_log_pt, singleton_pt, trace_pos,
                                       trace_hash);
             }
 
+        public:
+
             /**
              * Move IR node kept in this controller to a child, specified by a vertex to be individualized.
              *
@@ -993,28 +1800,27 @@ namespace dejavu {
 
                 // unwind invariant
                 T->set_position(base.back().trace_pos);
-                T->set_hash(base.back().trace_hash);
+                T->set_hash128(base.back().trace_hash);
 
-                // unwind colors introduced on this level of the tree
+                // unwind colors introduced on this level of the tree, in one backwards scan of the undo log
                 --s_base_pos;
-                while (prev_color_list.cur_pos > base.back().touched_color_list_pt) {
-                    const int old_color = prev_color_list.pop_back();
-                    const int new_color = touched_color_list.pop_back();
-
-                    touched_color.unset(new_color);
-
-                    const int new_color_sz = c->ptn[new_color] + 1;
-                    c->ptn[old_color] += new_color_sz;
-                    c->ptn[new_color] = 1;
-
-                    for (int j = 0; j < new_color_sz; ++j) {
-                        const int v = c->lab[new_color + j];
-                        c->vertex_to_col[v] = old_color;
-                        assert(c->vertex_to_lab[v] == new_color + j);
+                const int undo_log_pt = base.back().undo_log_pt;
+                for (int i = undo_log.cur_pos - 1; i >= undo_log_pt; --i) {
+                    const split_record& split = undo_log[i];
+                    assert(c->ptn[split.new_color] + 1 == split.new_color_sz);
+
+                    touched_color.unset(split.new_color);
+                    c->ptn[split.old_color] += split.new_color_sz;
+                    c->ptn[split.new_color] = 1;
+
+                    const int* lab = c->lab + split.new_color;
+                    for (int j = 0; j < split.new_color_sz; ++j) {
+                        c->vertex_to_col[lab[j]] = split.old_color;
+                        assert(c->vertex_to_lab[lab[j]] == split.new_color + j);
                     }
-
-                    --c->cells;
                 }
+                c->cells -= undo_log.cur_pos - undo_log_pt;
+                undo_log.set_size(undo_log_pt);
                 // unwind singletons
                 int const new_singleton_pos = base.back().singleton_pt;
                 singletons.resize(new_singleton_pos);
@@ -1035,7 +1841,7 @@ namespace dejavu {
              *                 in the given order.
              */
             void walk(sgraph *g, ir::limited_save &start_from, std::vector<int>& vertices) {
-                load_reduced_state(start_from);
+                load_reduced_state(start_from, g);
 
                 while (s_base_pos < (int) vertices.size()) {
                     int v = vertices[s_base_pos];
@@ -1717,76 +2523,209 @@ namespace dejavu {
             bool check_deviation(unsigned long deviation) {
                 return !deviation_done || deviation_map.contains(deviation);
             }
+
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(computed_for_base);
+                ar.value(expected_for_base);
+                ar.value(deviation_done);
+                std::vector<unsigned long> deviations(deviation_map.begin(), deviation_map.end());
+                ar.values(deviations);
+                if constexpr (A::reading) deviation_map = std::unordered_set<unsigned long>(deviations.begin(),
+                                                                                            deviations.end());
+            }
         };
 
         /**
          * \brief IR leaf
          *
-         * A stored leaf of an IR tree. The leaf can be stored in a dense manner (coloring of the leaf), or a sparse
-         * manner (base of the walk that leads to this leaf).
+         * A stored leaf of an IR tree. The base of the walk that leads to the leaf is always stored. Additionally, the
+         * leaf may store its coloring, either dense or compressed, which saves walking to the leaf whenever the leaf
+         * is used. Which leaves store their coloring is decided by the memory policy of \a shared_leaves, and may
+         * change over time. The base is kept in an arena of \a shared_leaves.
          */
         class stored_leaf {
+            friend class shared_leaves;
         public:
-            enum stored_leaf_type { STORE_LAB, ///< stores coloring of the leaf
-                                    STORE_BASE ///< stores only base of the leaf
+            enum stored_leaf_type { STORE_LAB,        ///< stores coloring of the leaf
+                                    STORE_COMPRESSED, ///< stores compressed coloring of the leaf
+                                    STORE_BASE        ///< stores only base of the leaf
             };
 
-            stored_leaf(int* arr, int arr_sz, stored_leaf_type store_type) : store_type(store_type) {
-                lab_or_base.allocate(arr_sz);
-                memcpy(lab_or_base.get_array(), arr, arr_sz * sizeof(int));
-                lab_or_base.set_size(arr_sz);
-            }
+            stored_leaf(const int* base, int base_sz) : base(base), base_sz(base_sz) {}
 
-            stored_leaf(std::vector<int>& arr, stored_leaf_type store_type) : store_type(store_type) {
-                lab_or_base.allocate((int) arr.size());
-                std::copy(arr.begin(), arr.end(), lab_or_base.get_array());
-                lab_or_base.set_size((int) arr.size());
+            [[nodiscard]] const int* get_base() const {
+                return base;
             }
 
-            const int* get_lab_or_base() {
-                return lab_or_base.get_array();
+            [[nodiscard]] int get_base_size() const {
+                return base_sz;
             }
 
-            int get_lab_or_base_size() {
-                return lab_or_base.size();
+            /**
+             * @return The coloring of the leaf, only available if the leaf is of type \a STORE_LAB.
+             */
+            [[nodiscard]] const int* get_lab() const {
+                assert(store_type == STORE_LAB);
+                return lab.data();
             }
 
             [[nodiscard]] stored_leaf_type get_store_type() const {
                 return store_type;
             }
 
+            /**
+             * @return Upper 64 bits of the hash of the leaf, only computed if \a hash_128 (see \a trace::get_hash128).
+             */
+            [[nodiscard]] unsigned long get_hash_high() const {
+                return hash_high;
+            }
+
+            /**
+             * @return Bytes used by the coloring of this leaf.
+             */
+            [[nodiscard]] long lab_memory() const {
+                return static_cast<long>(lab.size() * sizeof(int) + packed_lab.size() * sizeof(uint64_t));
+            }
+
         private:
-            worklist lab_or_base;
-            stored_leaf_type store_type;
+            const int* base;
+            int base_sz;
+            unsigned long hash_high = 0;
+            stored_leaf_type store_type = STORE_BASE;
+            std::vector<int>      lab;        /**< coloring, if of type STORE_LAB                */
+            std::vector<uint64_t> packed_lab; /**< compressed coloring, if of type STORE_COMPRESSED */
+            std::atomic<int> hits = 0;        /**< recent hits, decays whenever the policy sweeps   */
+            bool promotion_pending = false;   /**< whether the leaf is queued for promotion         */
         };
 
         /**
          * \brief Collection of leaves
          *
-         * Can be used across multiple threads.
+         * Can be used across multiple threads: lookups and inserts into the hash table of leaves do not take locks,
+         * only allocating the memory of a new leaf does. Leaves are kept in arenas, and are freed all at once when the
+         * collection is cleared (which must not happen concurrently).
          *
+         * Colorings of leaves are stored according to a memory budget (\a h_memory_budget). While less than half of
+         * the budget is used, leaves store their coloring dense. Afterwards, colorings are compressed: only the
+         * positions in which the coloring differs from the first stored leaf are kept, packed into as few bits as
+         * possible. Once the budget is exhausted, leaves only store their base. Leaves which are hit frequently
+         * (see \a record_hit) are queued for promotion, and store their coloring again once \a apply_promotions is
+         * called, demoting leaves which were not hit recently. Recording hits does not change how leaves are stored,
+         * but \a apply_promotions does, and hence must not be called concurrently with reading the coloring of a leaf.
          */
         class shared_leaves {
-            std::unordered_multimap<unsigned long, stored_leaf*> leaf_store;
-            std::vector<stored_leaf*> garbage_collector;
+            ds::hash_table<stored_leaf> leaf_store; /**< the leaves, by hash                    */
+            ds::arena<stored_leaf> leaf_arena;      /**< the leaves                             */
+            ds::arena<int>         data_arena;      /**< the bases of leaves                    */
+            std::mutex             arena_lock;      /**< protects the arenas and memory policy  */
 
-        public:
-            int s_leaves          = 0;   /**< number of leaves stored */
-            int h_full_save_limit = 256; /**< number of leaves which will be stored fully */
+            std::vector<int>          reference_lab; /**< compressed colorings are stored relative to this coloring */
+            std::vector<stored_leaf*> lab_leaves;    /**< leaves storing a coloring, swept to demote leaves         */
+            std::vector<std::pair<stored_leaf*, std::vector<int>>> pending_promotions; /**< queued by \a record_hit */
+            int  clock_hand = 0;                     /**< position of the sweep in \a lab_leaves                    */
+            long used_memory = 0;                    /**< bytes used by colorings of leaves                         */
 
-            shared_leaves() {
-                leaf_store.reserve(20);
+            static int value_bits(int domain_size) {
+                return std::max(1, static_cast<int>(std::bit_width(static_cast<unsigned int>(domain_size - 1))));
             }
 
             /**
-             * Free up all memory.
+             * Compresses \p lab: a bitmap of the positions in which \p lab differs from \a reference_lab, followed by
+             * the differing values, each packed into \a value_bits bits.
              */
-            ~shared_leaves() {
-                for(auto & l : garbage_collector) {
-                    delete l;
+            void compress_lab(const int* lab, int domain_size, std::vector<uint64_t>& packed) const {
+                const int  bits   = value_bits(domain_size);
+                const long bitmap = (domain_size + 63) / 64;
+                long diff = 0;
+                for(int i = 0; i < domain_size; ++i) diff += (lab[i] != reference_lab[i]);
+
+                packed.assign(bitmap + (diff * bits + 63) / 64, 0);
+                long pos = bitmap * 64;
+                for(int i = 0; i < domain_size; ++i) {
+                    if(lab[i] == reference_lab[i]) continue;
+                    packed[i / 64] |= (1ULL << (i % 64));
+                    const auto value = static_cast<uint64_t>(lab[i]);
+                    packed[pos / 64] |= value << (pos % 64);
+                    if(pos % 64 + bits > 64) packed[pos / 64 + 1] |= value >> (64 - pos % 64);
+                    pos += bits;
+                }
+            }
+
+            void add_to_policy(stored_leaf* leaf, stored_leaf::stored_leaf_type type, bool hot) {
+                leaf->store_type = type;
+                used_memory += leaf->lab_memory();
+                lab_leaves.push_back(leaf);
+                s_promoted += hot;
+            }
+
+            void demote(stored_leaf* leaf) {
+                used_memory -= leaf->lab_memory();
+                std::vector<int>().swap(leaf->lab);
+                std::vector<uint64_t>().swap(leaf->packed_lab);
+                leaf->store_type = stored_leaf::STORE_BASE;
+            }
+
+            /**
+             * Sweeps over the leaves storing a coloring, and demotes leaves which were not hit since the last sweep,
+             * until \p bytes fit into the memory budget.
+             */
+            void make_room(long bytes) {
+                long steps = 2 * static_cast<long>(lab_leaves.size());
+                while(used_memory + bytes > h_memory_budget && !lab_leaves.empty() && steps-- > 0) {
+                    if(clock_hand >= static_cast<int>(lab_leaves.size())) clock_hand = 0;
+                    stored_leaf* leaf = lab_leaves[clock_hand];
+                    if(leaf->hits > 0) {
+                        leaf->hits = leaf->hits / 2;
+                        ++clock_hand;
+                    } else {
+                        demote(leaf);
+                        ++s_demoted;
+                        lab_leaves[clock_hand] = lab_leaves.back();
+                        lab_leaves.pop_back();
+                    }
+                }
+            }
+
+            /**
+             * Stores the coloring \p lab in \p leaf, if the memory budget allows it. Dense if less than half the
+             * budget is used, compressed otherwise.
+             *
+             * @param hot whether the leaf is promoted, which demotes other leaves to make room if necessary
+             */
+            void store_lab(stored_leaf* leaf, const int* lab, int domain_size, bool hot) {
+                if(reference_lab.empty()) reference_lab.assign(lab, lab + domain_size);
+                const long dense_bytes = static_cast<long>(domain_size) * static_cast<long>(sizeof(int));
+                if(used_memory + dense_bytes <= h_memory_budget / 2) {
+                    leaf->lab.assign(lab, lab + domain_size);
+                    add_to_policy(leaf, stored_leaf::STORE_LAB, hot);
+                    return;
+                }
+
+                compress_lab(lab, domain_size, leaf->packed_lab);
+                const long bytes = leaf->lab_memory();
+                if(hot && used_memory + bytes > h_memory_budget) make_room(bytes);
+                if(used_memory + bytes > h_memory_budget) {
+                    std::vector<uint64_t>().swap(leaf->packed_lab);
+                    return;
                 }
+                add_to_policy(leaf, stored_leaf::STORE_COMPRESSED, hot);
             }
 
+        public:
+            std::atomic<int> s_leaves = 0;   /**< number of leaves stored                                 */
+            std::atomic<long> s_hits  = 0;   /**< number of times leaves were hit                         */
+            long s_rewalks  = 0;             /**< hits on leaves only storing their base                  */
+            long s_promoted = 0;             /**< how often leaves were promoted to store their coloring  */
+            long s_demoted  = 0;             /**< how often leaves were demoted to only store their base  */
+            std::atomic<long> s_collisions        = 0; /**< hits told apart by the upper 64 bits of the hash   */
+            std::atomic<long> s_cert_failures     = 0; /**< hits which did not lead to an automorphism         */
+            std::atomic<long> s_strong_invariants = 0; /**< strong invariants written after failed certificates */
+
+            long h_memory_budget = 0x8000000; /**< memory budget for colorings of leaves in bytes         */
+            int  h_promote_hits  = 2;         /**< leaves only storing their base are promoted after being
+                                                *  hit this many times                                     */
+
             /**
              * Lookup whether a leaf with the given hash already exists.
              *
@@ -1794,12 +2733,7 @@ namespace dejavu {
              * @return
              */
             stored_leaf* lookup_leaf(unsigned long hash) {
-                auto find = leaf_store.find(hash);
-                if(find != leaf_store.end()) {
-                    return find->second;
-                } else {
-                    return nullptr;
-                }
+                return leaf_store.find(hash);
             }
 
             /**
@@ -1807,30 +2741,193 @@ namespace dejavu {
              *
              * @param hash
              * @param ptr
+             * @param hash_high upper 64 bits of the hash, only computed if \a hash_128
              */
-            void add_leaf(unsigned long hash, coloring& c, std::vector<int>& base) {
+            void add_leaf(unsigned long hash, coloring& c, std::vector<int>& base, unsigned long hash_high = 0) {
 
                 // check whether hash already exists
-                if(leaf_store.contains(hash)) return;
+                if(leaf_store.find(hash) != nullptr) return;
 
                 // if not, add the leaf
-                const bool full_save = s_leaves < h_full_save_limit;
-                auto type
-                       = full_save?stored_leaf::stored_leaf_type::STORE_LAB:stored_leaf::stored_leaf_type::STORE_BASE;
-                auto new_leaf
-                       = full_save?new stored_leaf(c.lab,c.domain_size, type):new stored_leaf(base, type);
-                leaf_store.insert(std::pair<unsigned long, stored_leaf*>(hash, new_leaf));
-                garbage_collector.push_back(new_leaf);
-                ++s_leaves;
+                const int base_sz = static_cast<int>(base.size());
+                stored_leaf* new_leaf;
+                {
+                    std::lock_guard<std::mutex> guard(arena_lock);
+                    int* data = data_arena.allocate(base_sz);
+                    std::copy(base.begin(), base.end(), data);
+                    new_leaf = leaf_arena.create(data, base_sz);
+                    new_leaf->hash_high = hash_high;
+                    store_lab(new_leaf, c.lab, c.domain_size, false);
+                }
+
+                // another thread may have added a leaf with the same hash in the meantime
+                if(leaf_store.insert(hash, new_leaf)) {
+                    ++s_leaves;
+                } else if(new_leaf->get_store_type() != stored_leaf::STORE_BASE) {
+                    std::lock_guard<std::mutex> guard(arena_lock);
+                    lab_leaves.erase(std::find(lab_leaves.begin(), lab_leaves.end(), new_leaf));
+                    demote(new_leaf);
+                }
+            }
+
+            /**
+             * Stores the leaves, and statistics. Only the bases of leaves are stored, restored leaves are of type
+             * \a stored_leaf::STORE_BASE.
+             */
+            void serialize(ds::binary_writer& ar) {
+                ar.value(leaf_store.size());
+                leaf_store.for_each([&ar](const uint64_t hash, const stored_leaf* leaf) {
+                    ar.value(hash);
+                    ar.value(leaf->hash_high);
+                    ar.value(leaf->base_sz);
+                    ar.values(leaf->base, leaf->base_sz);
+                });
+                serialize_statistics(ar);
+            }
+
+            /**
+             * Restores leaves and statistics stored by \a serialize. Clears the collection first.
+             */
+            void serialize(ds::binary_reader& ar) {
+                clear();
+                long num = 0;
+                ar.value(num);
+                std::vector<int> base;
+                for(long i = 0; i < num && ar.good(); ++i) {
+                    uint64_t hash = 0;
+                    unsigned long hash_high = 0;
+                    int base_sz = 0;
+                    ar.value(hash);
+                    ar.value(hash_high);
+                    ar.value(base_sz);
+                    if(!ar.good() || base_sz < 0) return;
+                    base.resize(base_sz);
+                    ar.values(base.data(), base_sz);
+
+                    int* data = data_arena.allocate(base_sz);
+                    std::copy(base.begin(), base.end(), data);
+                    stored_leaf* leaf = leaf_arena.create(data, base_sz);
+                    leaf->hash_high = hash_high;
+                    leaf_store.insert(hash, leaf);
+                }
+                serialize_statistics(ar);
+            }
+
+            template<class A>
+            void serialize_statistics(A& ar) {
+                int leaves = s_leaves;
+                long hits = s_hits, collisions = s_collisions, cert_failures = s_cert_failures,
+                     strong_invariants = s_strong_invariants;
+                ar.value(leaves);
+                ar.value(hits);
+                ar.value(s_rewalks);
+                ar.value(s_promoted);
+                ar.value(s_demoted);
+                ar.value(collisions);
+                ar.value(cert_failures);
+                ar.value(strong_invariants);
+                if constexpr (A::reading) {
+                    s_leaves            = leaves;
+                    s_hits              = hits;
+                    s_collisions        = collisions;
+                    s_cert_failures     = cert_failures;
+                    s_strong_invariants = strong_invariants;
+                }
+            }
+
+            /**
+             * Writes the coloring of \p leaf to \p lab. The leaf must store its coloring, i.e., must not be of type
+             * \a STORE_BASE.
+             *
+             * @param leaf the leaf
+             * @param lab array of size of the domain, to which the coloring is written
+             */
+            void load_lab(const stored_leaf* leaf, int* lab) const {
+                assert(leaf->get_store_type() != stored_leaf::STORE_BASE);
+                if(leaf->get_store_type() == stored_leaf::STORE_LAB) {
+                    std::copy(leaf->lab.begin(), leaf->lab.end(), lab);
+                    return;
+                }
+
+                const int  domain_size = static_cast<int>(reference_lab.size());
+                const int  bits        = value_bits(domain_size);
+                const auto mask        = (1ULL << bits) - 1;
+                const auto& packed     = leaf->packed_lab;
+                long pos = ((domain_size + 63) / 64) * 64;
+                for(int i = 0; i < domain_size; ++i) {
+                    if(!((packed[i / 64] >> (i % 64)) & 1)) {
+                        lab[i] = reference_lab[i];
+                        continue;
+                    }
+                    uint64_t value = packed[pos / 64] >> (pos % 64);
+                    if(pos % 64 + bits > 64) value |= packed[pos / 64 + 1] << (64 - pos % 64);
+                    lab[i] = static_cast<int>(value & mask);
+                    pos += bits;
+                }
+            }
+
+            /**
+             * Records that \p leaf was used to test for an automorphism. Leaves only storing their base which were
+             * hit \a h_promote_hits times are queued for promotion (see \a apply_promotions). Does not change how any
+             * leaf is stored, and may hence be called while other threads read colorings of leaves.
+             *
+             * @param leaf the leaf
+             * @param lab the coloring of the leaf
+             * @param domain_size size of the domain
+             */
+            void record_hit(stored_leaf* leaf, const int* lab, int domain_size) {
+                ++s_hits;
+                const int hits = ++leaf->hits;
+                if(leaf->get_store_type() != stored_leaf::STORE_BASE) return;
+                std::lock_guard<std::mutex> guard(arena_lock);
+                ++s_rewalks;
+                if(hits < h_promote_hits || leaf->promotion_pending) return;
+                leaf->promotion_pending = true;
+                pending_promotions.emplace_back(leaf, std::vector<int>(lab, lab + domain_size));
             }
 
             /**
-             * Empty this leaf container.
+             * Promotes the leaves queued by \a record_hit to store their coloring, demoting leaves which were not hit
+             * recently if necessary. Must not be called concurrently with reading the coloring of a leaf.
+             */
+            void apply_promotions() {
+                std::lock_guard<std::mutex> guard(arena_lock);
+                for(auto& [leaf, lab] : pending_promotions) {
+                    leaf->promotion_pending = false;
+                    if(leaf->get_store_type() != stored_leaf::STORE_BASE) continue;
+                    store_lab(leaf, lab.data(), static_cast<int>(lab.size()), true);
+                }
+                pending_promotions.clear();
+            }
+
+            /**
+             * Empty this leaf container, and free the memory of all leaves.
              */
             void clear() {
                 s_leaves = 0;
                 leaf_store.clear();
-                // TODO clear garbage collector?
+                leaf_arena.clear();
+                data_arena.clear();
+                reference_lab.clear();
+                lab_leaves.clear();
+                pending_promotions.clear();
+                clock_hand  = 0;
+                used_memory = 0;
+            }
+
+            /**
+             * @return Bytes used by colorings of leaves, which is limited by \a h_memory_budget.
+             */
+            [[nodiscard]] long lab_memory() const {
+                return used_memory;
+            }
+
+            /**
+             * @return Bytes of memory reserved for leaves.
+             */
+            [[nodiscard]] long memory() const {
+                return leaf_store.memory() + leaf_arena.memory() + data_arena.memory() + used_memory +
+                       static_cast<long>(reference_lab.size() * sizeof(int));
             }
         };
 
@@ -1839,7 +2936,6 @@ namespace dejavu {
          */
         class tree_node {
             limited_save* data = nullptr;
-            bool          owns_data = true;
             tree_node*    next;
             tree_node*    parent;
             bool          is_base = false;
@@ -1850,10 +2946,9 @@ namespace dejavu {
             int           nodes_below  = 0;
             int           pruned_below = 0;
 
-            tree_node(limited_save* data, tree_node* next, tree_node* parent, bool owns_data) {
+            tree_node(limited_save* data, tree_node* next, tree_node* parent) {
                 this->data = data;
                 this->next = next;
-                this->owns_data = owns_data;
                 if(next == nullptr) {
                     next = this; // TODO supposed to be this->next?
                 }
@@ -1895,8 +2990,16 @@ namespace dejavu {
                 return is_base;
             }
 
-            ~tree_node() {
-                if(owns_data) delete data;
+            /**
+             * Stores or restores the flags of this node, but not its save or its position in the tree.
+             */
+            template<class A>
+            void serialize(A& ar) {
+                ar.value(is_base);
+                ar.value(is_pruned);
+                ar.value(hash);
+                ar.value(nodes_below);
+                ar.value(pruned_below);
             }
         };
 
@@ -1908,6 +3011,9 @@ namespace dejavu {
          * Datastructure to explicitly store parts of an IR tree, such as a level-wise store, leaf store, as well as
          * further information used for pruning in BFS.
          *
+         * Nodes and their saves are kept in arenas, one per level of the tree, such that levels can be freed all at
+         * once whenever they are discarded.
+         *
          * Can be used across multiple threads.
          */
         class shared_tree {
@@ -1915,7 +3021,9 @@ namespace dejavu {
             std::vector<tree_node*>              tree_data;
             std::vector<std::vector<tree_node*>> tree_data_jump_map;
             std::vector<int>        tree_level_size;
-            std::vector<tree_node*> garbage_collector;
+            std::vector<ds::arena<tree_node>>    node_arena; /**< nodes of each level         */
+            std::vector<ds::arena<limited_save>> save_arena; /**< saves of nodes of each level */
+            std::vector<ds::spill_file>          spill;      /**< spilled colorings of each level */
             int                     finished_up_to = 0;
 
             std::vector<int> current_base;
@@ -1928,6 +3036,7 @@ namespace dejavu {
             int h_bfs_automorphism_pw = 0;
             shared_leaves stored_leaves;    /**< stores leaves of the IR tree */
             deviation_map stored_deviation; /**< stores trace deviations of a BFS level*/
+            std::string h_spill_directory;  /**< directory for files of spilled colorings, none if empty */
 
             explicit shared_tree(int domain_size) {
                 h_bfs_top_level_orbit.initialize(domain_size);
@@ -1999,6 +3108,9 @@ namespace dejavu {
                 tree_data.resize(base.size() + 1);
                 tree_level_size.resize(base.size() + 1);
                 tree_data_jump_map.resize(base.size() + 1);
+                node_arena.resize(base.size() + 1);
+                save_arena.resize(base.size() + 1);
+                spill.resize(base.size() + 1);
                 add_node(0, root, nullptr, true);
                 node_invariant.resize(root->get_coloring()->domain_size);
                 current_base = base;
@@ -2035,20 +3147,23 @@ namespace dejavu {
                     }
                 }
 
-                if(keep_until == 0) {
-                    for(auto t : garbage_collector) delete t;
-                    garbage_collector.clear();
-                }
+                if(keep_until == 0) clear_level(0);
 
 
                 if(keep_until == new_size && new_size == old_size) return false;
 
                 finished_up_to = std::min(keep_until, finished_up_to);
 
+                // free the levels which are discarded (nodes only refer to nodes on lower levels)
+                for (int i = keep_until+1; i < old_size+1; ++i) clear_level(i);
+
                 h_bfs_top_level_orbit.reset();
                 tree_data.resize(new_size + 1);
                 tree_level_size.resize(new_size + 1);
                 tree_data_jump_map.resize(new_size + 1);
+                node_arena.resize(new_size + 1);
+                save_arena.resize(new_size + 1);
+                spill.resize(new_size + 1);
 
                 for (int i = keep_until+1; i < new_size+1; ++i) {
                     tree_data[i] = nullptr;
@@ -2107,20 +3222,58 @@ namespace dejavu {
                 node_invariant[v] += inv;
             }
 
+            /**
+             * Creates a save for a node on the given level, which is freed together with the level.
+             *
+             * @param level the level
+             * @return the save
+             */
+            limited_save* create_save(int level) {
+                return save_arena[level].create();
+            }
+
+            /**
+             * Allocates storage for a spilled coloring (see \a limited_save::save_spilled) of a node on the given
+             * level, in a memory-mapped file in \a h_spill_directory. The storage is freed together with the level.
+             *
+             * @param level the level
+             * @param domain_size domain size of the coloring
+             * @return the storage, or `nullptr` if no spill directory is set, or the file can not be created or
+             * extended
+             */
+            int* create_spilled_coloring(int level, int domain_size) {
+                if(h_spill_directory.empty() || !spill[level].open(h_spill_directory)) return nullptr;
+                return spill[level].allocate(2 * static_cast<long>(domain_size));
+            }
+
+            /**
+             * @return whether colorings can be spilled, i.e., whether a spill directory is set
+             */
+            [[nodiscard]] bool can_spill() const {
+                return !h_spill_directory.empty();
+            }
+
+            /**
+             * Adds a node to the given level.
+             *
+             * @param level the level
+             * @param data the save of the node, which must either outlive the tree (e.g., the root), or be created
+             * using \a create_save on the same level
+             * @param parent the parent node
+             * @param is_base whether the node is on the base
+             */
             void add_node(int level, limited_save* data, tree_node* parent, bool is_base = false) {
                 assert(data != nullptr);
                 if(tree_data[level] == nullptr) {
                     tree_level_size[level] = 0;
-                    tree_data[level] = new tree_node(data, nullptr, parent, level != 0);
+                    tree_data[level] = node_arena[level].create(data, nullptr, parent);
                     tree_data[level]->set_next(tree_data[level]);
 
-                    garbage_collector.push_back( tree_data[level]);
                     if(is_base) tree_data[level]->base();
                 } else {
                     tree_node* a_node    = tree_data[level];
                     tree_node* next_node = a_node->get_next();
-                    auto       new_node  = new tree_node(data, next_node, parent, level != 0);
-                    garbage_collector.push_back(new_node);
+                    auto       new_node  = node_arena[level].create(data, next_node, parent);
                     if(is_base) new_node->base();
                     a_node->set_next(new_node);
                     tree_data[level] = new_node;
@@ -2174,9 +3327,170 @@ namespace dejavu {
                 return tree_level_size[level];
             }
 
-            ~shared_tree() {
-                for(auto & i : garbage_collector) delete i;
-            };
+            /**
+             * Frees all nodes (and their saves) on the given level.
+             *
+             * @param level the level
+             */
+            void clear_level(int level) {
+                node_arena[level].clear();
+                save_arena[level].clear();
+                spill[level].clear();
+            }
+
+            /**
+             * Stores the tree, i.e., the current base, all levels up to \a finished_up_to, as well as the leaves and
+             * further information used for pruning. Must not be called while nodes are queued.
+             *
+             * The root is not stored (see \a serialize(ds::binary_reader&, limited_save*)).
+             */
+            void serialize(ds::binary_writer& ar) {
+                assert(init);
+                assert(missing_nodes.empty());
+                ar.values(current_base);
+                ar.value(finished_up_to);
+
+                std::unordered_map<const limited_save*, long> save_index;
+                std::unordered_map<const tree_node*, long>    node_index;
+                auto index_of = [&save_index](const limited_save* save) {
+                    assert(save_index.contains(save));
+                    return save_index[save];
+                };
+
+                for(int level = 0; level <= finished_up_to; ++level) {
+                    std::vector<tree_node*> nodes;
+                    if(tree_data[level] != nullptr) {
+                        tree_node* first = tree_data[level]->get_next();
+                        tree_node* next  = first;
+                        do {
+                            nodes.push_back(next);
+                            next = next->get_next();
+                        } while(next != first);
+                    }
+                    assert(level > 0 || nodes.size() == 1);
+
+                    std::unordered_map<const tree_node*, long> level_index;
+                    ar.value(static_cast<long>(nodes.size()));
+                    for(long i = 0; i < static_cast<long>(nodes.size()); ++i) {
+                        tree_node* node = nodes[i];
+                        level_index[node] = i;
+                        ar.value(node->get_parent() != nullptr ? node_index[node->get_parent()] : -1L);
+                        if(level > 0) node->get_save()->serialize(ar, index_of);
+                        save_index.emplace(node->get_save(), static_cast<long>(save_index.size()));
+                        node->serialize(ar);
+                    }
+
+                    std::vector<long> jump_map;
+                    for(auto node : tree_data_jump_map[level]) jump_map.push_back(level_index[node]);
+                    ar.values(jump_map);
+                    node_index.swap(level_index);
+                }
+
+                ar.values(node_invariant);
+                h_bfs_top_level_orbit.serialize(ar);
+                ar.value(h_bfs_automorphism_pw);
+                stored_deviation.serialize(ar);
+                stored_leaves.serialize(ar);
+            }
+
+            /**
+             * Restores a tree stored by \a serialize, replacing all contents of this tree.
+             *
+             * @param ar the reader
+             * @param root save of the root, which must be the same as the root of the stored tree
+             */
+            void serialize(ds::binary_reader& ar, limited_save* root) {
+                std::vector<int> base;
+                ar.values(base);
+                int finished = 0;
+                ar.value(finished);
+                if(!ar.good() || finished < 0 || finished > static_cast<int>(base.size())) {
+                    ar.fail();
+                    return;
+                }
+
+                for(int level = 0; level < static_cast<int>(node_arena.size()); ++level) clear_level(level);
+                tree_data.clear();
+                tree_level_size.clear();
+                tree_data_jump_map.clear();
+                initialize(base, root);
+                finished_up_to = finished;
+
+                std::vector<limited_save*> saves;
+                std::vector<tree_node*>    parents;
+                auto save_at = [&saves, &ar](const long index) -> limited_save* {
+                    if(index < 0 || index >= static_cast<long>(saves.size())) {
+                        ar.fail();
+                        return nullptr;
+                    }
+                    return saves[index];
+                };
+
+                for(int level = 0; level <= finished_up_to && ar.good(); ++level) {
+                    auto spill_storage = [this, level](const int n) { return create_spilled_coloring(level, n); };
+                    long num = 0;
+                    ar.value(num);
+                    if(level == 0 && num != 1) ar.fail();
+
+                    std::vector<tree_node*> nodes;
+                    for(long i = 0; i < num && ar.good(); ++i) {
+                        long parent = -1;
+                        ar.value(parent);
+                        if(parent >= static_cast<long>(parents.size()) || (level > 0) != (parent >= 0)) {
+                            ar.fail();
+                            break;
+                        }
+                        limited_save* save = root;
+                        if(level > 0) {
+                            save = create_save(level);
+                            save->serialize(ar, save_at, spill_storage);
+                            add_node(level, save, parents[parent]);
+                        }
+                        saves.push_back(save);
+                        tree_data[level]->serialize(ar);
+                        nodes.push_back(tree_data[level]);
+                    }
+
+                    std::vector<long> jump_map;
+                    ar.values(jump_map);
+                    tree_data_jump_map[level].clear();
+                    for(const long pos : jump_map) {
+                        if(pos < 0 || pos >= static_cast<long>(nodes.size())) {
+                            ar.fail();
+                            break;
+                        }
+                        tree_data_jump_map[level].push_back(nodes[pos]);
+                    }
+                    if(!jump_map.empty()) tree_level_size[level] = static_cast<int>(jump_map.size());
+                    parents.swap(nodes);
+                }
+
+                ar.values(node_invariant);
+                h_bfs_top_level_orbit.serialize(ar);
+                ar.value(h_bfs_automorphism_pw);
+                stored_deviation.serialize(ar);
+                stored_leaves.serialize(ar);
+            }
+
+            /**
+             * @return Bytes of memory reserved for nodes, saves and leaves of the tree (not including memory owned by
+             * saves, such as colorings).
+             */
+            [[nodiscard]] long memory() const {
+                long mem = stored_leaves.memory();
+                for(const auto& a : node_arena) mem += a.memory();
+                for(const auto& a : save_arena) mem += a.memory();
+                return mem;
+            }
+
+            /**
+             * @return Bytes of disk space used by spilled colorings.
+             */
+            [[nodiscard]] long spilled_memory() const {
+                long mem = 0;
+                for(const auto& f : spill) mem += f.size();
+                return mem;
+            }
         };
     }
 }
@@ -48,6 +48,10 @@ namespace dejavu {
         dejavu::worklist aux_automorphism;
         dejavu::worklist aux_automorphism_supp;
 
+        std::vector<int> component_automorphism; /**< workspace to lift automorphisms of components, if the graph
+                                                   *  was not reduced */
+        dejavu::worklist component_automorphism_supp;
+
         bool layers_melded = false;
 
         bool skipped_preprocessing = false;
@@ -98,6 +102,8 @@ namespace dejavu {
         int domain_size   = 0;      /**< size of the underlying domain (i.e., number of vertices) */
         bool h_deact_deg1 = false;  /**< no degree 0,1 processing */
         bool h_deact_deg2 = false;  /**< no degree 2   processing */
+        int  h_threads    = 1;      /**< number of threads used for parallelized preprocessing */
+        int  h_parallel_min_vertices = 4096; /**< only use multiple threads on graphs with this many vertices */
 
         preprocessor() = default;
         explicit preprocessor(dejavu::ir::refinement* R) {
@@ -168,6 +174,70 @@ namespace dejavu {
             recovery_strings.clear();
         }
 
+        /**
+         * Groups vertices of degree at most \p d_limit into classes of potential twins, using multiple threads. Two
+         * vertices end up in the same class of \p open_class (\p closed_class) if their colors and hashes of their open
+         * (closed) neighbourhoods agree. Hashes are commutative, so neighbourhoods do not need to be sorted.
+         *
+         * Classes are stored contiguously in \p members, where class `k` consists of
+         * `members[class_pt[k]], ..., members[class_pt[k+1]-1]`.
+         */
+        void twin_classes(dejavu::sgraph *g, const int d_limit, std::vector<int>& open_class,
+                          std::vector<int>& closed_class, std::vector<int>& members, std::vector<int>& class_pt) {
+            std::vector<unsigned long> open_hash(g->v_size);
+            parallel_for(h_threads, 0, g->v_size, [&](const int v) {
+                if(g->d[v] > d_limit) return;
+                unsigned long h = 0;
+                for(int k = g->v[v]; k < g->v[v] + g->d[v]; ++k) {
+                    const auto neighbour = static_cast<unsigned int>(g->e[k]);
+                    h += (static_cast<unsigned long>(hash(neighbour)) << 32) + hash(~neighbour);
+                }
+                open_hash[v] = h;
+            });
+
+            members.clear();
+            class_pt.clear();
+            std::vector<std::pair<std::pair<int, unsigned long>, int>> keys;
+            keys.reserve(g->v_size);
+            for(int closed = 0; closed <= 1; ++closed) {
+                auto& vertex_class = closed ? closed_class : open_class;
+                vertex_class.assign(g->v_size, -1);
+
+                keys.clear();
+                for(int v = 0; v < g->v_size; ++v) {
+                    if(g->d[v] > d_limit) continue;
+                    const auto uv = static_cast<unsigned int>(v);
+                    const unsigned long h = open_hash[v] +
+                            (closed ? (static_cast<unsigned long>(hash(uv)) << 32) + hash(~uv) : 0);
+                    keys.push_back({{c.vertex_to_col[v], h}, v});
+                }
+                std::sort(keys.begin(), keys.end());
+
+                for(int i = 0; i < static_cast<int>(keys.size());) {
+                    int j = i + 1;
+                    while(j < static_cast<int>(keys.size()) && keys[j].first == keys[i].first) ++j;
+                    if(j - i > 1) {
+                        class_pt.push_back(static_cast<int>(members.size()));
+                        for(int k = i; k < j; ++k) {
+                            vertex_class[keys[k].second] = static_cast<int>(class_pt.size()) - 1;
+                            members.push_back(keys[k].second);
+                        }
+                    }
+                    i = j;
+                }
+            }
+            class_pt.push_back(static_cast<int>(members.size()));
+        }
+
+        /**
+         * Removes twins (i.e., vertices with the same open or closed neighbourhood) of vertices of low degree, and
+         * records the respective automorphisms.
+         *
+         * If \a h_threads is set, potential twins are determined using neighbourhood hashes computed on multiple
+         * threads (see \a twin_classes), instead of scanning the neighbourhoods of neighbours. Candidates are then
+         * verified exactly, and visited in the same order as by the sequential scan. Generators, the group size and
+         * the resulting graph do not depend on the number of threads.
+         */
         int remove_twins(dejavu::sgraph *g, int *colmap, dejavu_hook* hook) {
             //coloring col;
             g->initialize_coloring(&c, colmap);
@@ -187,6 +257,11 @@ namespace dejavu {
 
             int d_limit = std::max(static_cast<int>(sqrt(sqrt(g->v_size))), 8);
 
+            // with multiple threads, determine potential twins using hashes of neighbourhoods
+            const bool use_twin_classes = h_threads > 1 && g->v_size >= h_parallel_min_vertices;
+            std::vector<int> open_class, closed_class, class_members, class_pt;
+            if(use_twin_classes) twin_classes(g, d_limit, open_class, closed_class, class_members, class_pt);
+
             int s_twins = 0;
             for(int i = 0; i < g->v_size; ++i) twin_counter[i] = 0;
                 // iterate over color classes
@@ -210,22 +285,36 @@ namespace dejavu {
                     test_twin.reset();
                     potential_twin.reset();
                     potential_twin_list.clear();
-                    for(int k = 0; k < g->d[vertex]; ++k) {
-                        const int neighbour = g->e[g->v[vertex] + k];
-                        test_twin.set(neighbour);
-                        if(g->d[neighbour] > d_limit) {
-                            limit_breached = true;
-                            break;
+                    if(use_twin_classes) {
+                        for(int k = 0; k < g->d[vertex]; ++k) {
+                            const int neighbour = g->e[g->v[vertex] + k];
+                            test_twin.set(neighbour);
+                            if(g->d[neighbour] > d_limit) {
+                                limit_breached = true;
+                                break;
+                            }
                         }
-                        for(int l = 0; l < g->d[neighbour]; ++l) {
-                            const int neighbour_neighbour = g->e[g->v[neighbour] + l];
-                            if(touched.get(neighbour_neighbour)) continue;
-                            if(potential_twin.get(neighbour_neighbour)) {
-                                potential_twin_counter[neighbour_neighbour] += 1;
-                            } else {
-                                potential_twin.set(neighbour_neighbour);
-                                potential_twin_counter[neighbour_neighbour] = 1;
-                                potential_twin_list.push_back(neighbour_neighbour);
+                        if(!limit_breached) potential_twins_from_classes(g, vertex, touched, open_class, closed_class,
+                                                                         class_members, class_pt, potential_twin,
+                                                                         potential_twin_counter, potential_twin_list);
+                    } else {
+                        for(int k = 0; k < g->d[vertex]; ++k) {
+                            const int neighbour = g->e[g->v[vertex] + k];
+                            test_twin.set(neighbour);
+                            if(g->d[neighbour] > d_limit) {
+                                limit_breached = true;
+                                break;
+                            }
+                            for(int l = 0; l < g->d[neighbour]; ++l) {
+                                const int neighbour_neighbour = g->e[g->v[neighbour] + l];
+                                if(touched.get(neighbour_neighbour)) continue;
+                                if(potential_twin.get(neighbour_neighbour)) {
+                                    potential_twin_counter[neighbour_neighbour] += 1;
+                                } else {
+                                    potential_twin.set(neighbour_neighbour);
+                                    potential_twin_counter[neighbour_neighbour] = 1;
+                                    potential_twin_list.push_back(neighbour_neighbour);
+                                }
                             }
                         }
                     }
@@ -301,6 +390,44 @@ namespace dejavu {
             return s_twins;
         }
 
+        /**
+         * Collects the potential twins of \p vertex from the classes computed by \a twin_classes, in the order in
+         * which scanning the neighbourhoods of the neighbours of \p vertex discovers them. Vertices in
+         * \p potential_twin_list then pass the counter test of the scan, and are verified afterwards.
+         *
+         * Since every twin is adjacent to the first neighbour of \p vertex (unless it is that neighbour), the scan
+         * discovers twins in the order of the adjacency list of the first neighbour. A true twin which is the first
+         * neighbour itself is discovered last, through the second neighbour.
+         */
+        void potential_twins_from_classes(dejavu::sgraph *g, const int vertex, dejavu::ds::markset& touched,
+                                          std::vector<int>& open_class, std::vector<int>& closed_class,
+                                          std::vector<int>& class_members, std::vector<int>& class_pt,
+                                          dejavu::ds::markset& potential_twin,
+                                          dejavu::ds::worklist& potential_twin_counter,
+                                          std::vector<int>& potential_twin_list) {
+            if(g->d[vertex] == 0) return;
+            for(const int twin_class : {open_class[vertex], closed_class[vertex]}) {
+                if(twin_class < 0) continue;
+                for(int k = class_pt[twin_class]; k < class_pt[twin_class + 1]; ++k) {
+                    const int other_vertex = class_members[k];
+                    if(touched.get(other_vertex) || potential_twin.get(other_vertex)) continue;
+                    potential_twin.set(other_vertex);
+                }
+            }
+
+            const int first_neighbour = g->e[g->v[vertex]];
+            for(int l = 0; l < g->d[first_neighbour]; ++l) {
+                const int other_vertex = g->e[g->v[first_neighbour] + l];
+                if(!potential_twin.get(other_vertex)) continue;
+                potential_twin_counter[other_vertex] = g->d[vertex];
+                potential_twin_list.push_back(other_vertex);
+            }
+            if(g->d[vertex] >= 2 && potential_twin.get(first_neighbour)) {
+                potential_twin_counter[first_neighbour] = g->d[vertex];
+                potential_twin_list.push_back(first_neighbour);
+            }
+        }
+
         // reset internal automorphism structure to the identity
         static void reset_automorphism(int *rautomorphism, int nsupp, const int *supp) {
             for (int i = 0; i < nsupp; ++i) {
@@ -2922,6 +3049,37 @@ namespace dejavu {
         }
 
     public:
+        // given automorphism of a component of a graph which was not reduced, reconstructs automorphism of the
+        // original graph using only the translation of the decomposer
+        void component_hook_buffered(int _n, const int *_automorphism, int _supp, const int *_automorphism_supp,
+                                     dejavu_hook* hook) {
+            if(hook == nullptr) return;
+            assert(decomposer != nullptr);
+            if(static_cast<int>(component_automorphism.size()) != domain_size) {
+                component_automorphism.resize(domain_size);
+                for(int i = 0; i < domain_size; ++i) component_automorphism[i] = i;
+                component_automorphism_supp.allocate(domain_size);
+            }
+
+            const int end = _supp >= 0 ? _supp : _n;
+            for(int i = 0; i < end; ++i) {
+                const int _v_from = _supp >= 0 ? _automorphism_supp[i] : i;
+                const int _v_to   = _automorphism[_v_from];
+                if(_v_from == _v_to) continue;
+                const int v_from = decomposer->map_back(current_component, _v_from);
+                component_automorphism[v_from] = decomposer->map_back(current_component, _v_to);
+                component_automorphism_supp.push_back(v_from);
+            }
+
+            (*hook)(domain_size, component_automorphism.data(), component_automorphism_supp.cur_pos,
+                    component_automorphism_supp.get_array());
+            for(int i = 0; i < component_automorphism_supp.cur_pos; ++i) {
+                const int v = component_automorphism_supp[i];
+                component_automorphism[v] = v;
+            }
+            component_automorphism_supp.reset();
+        }
+
         // given automorphism of reduced graph, reconstructs automorphism of the original graph
         void
         pre_hook_buffered(int _n, const int *_automorphism, int _supp, const int *_automorphism_supp, dejavu_hook* hook) {
@@ -3270,6 +3428,23 @@ namespace dejavu {
                 return;
             g->dense = !(g->e_size < g->v_size || g->e_size / g->v_size < g->v_size / (g->e_size / g->v_size));
 
+            if(g->ec != nullptr) {
+                // reductions do not maintain edge colors or arcs, so we leave edge-colored and directed graphs as they
+                // are -- unless color refinement already shows that there are no automorphisms
+                skipped_preprocessing = true;
+                g->initialize_coloring(&c, colmap);
+                dejavu::ir::refinement R_edge_colored;
+                R_edge_colored.refine_coloring_first(g, &c, -1);
+                if (c.cells == g->v_size) {
+                    g->v_size = 0;
+                    g->e_size = 0;
+                    if(print) print->timer_print("discrete", g->v_size, g->e_size);
+                    return;
+                }
+                if(print) print->timer_print("edge_colored", g->v_size, g->e_size);
+                return;
+            }
+
             const int test_d = g->d[0];
             int k;
             for (k = 0; k < (g->v_size) && (g->d[k] == test_d); ++k);
@@ -3303,6 +3478,7 @@ namespace dejavu {
 
             dejavu::ir::refinement R_stack = dejavu::ir::refinement();
             if(R1 == nullptr) R1 = &R_stack;
+            R1->h_threads = h_threads;
 
             R1->refine_coloring_first(g, &c, -1);
             const bool color_refinement_effective = pre_cells != c.cells;
@@ -3555,6 +3731,11 @@ namespace dejavu {
                 }
                 return;
             }
+            if(p->skipped_preprocessing && p->translation_layers.empty()) {
+                // the graph was left as it is, so only the decomposition needs to be reverted
+                p->component_hook_buffered(n, aut, nsupp, supp, p->saved_hook);
+                return;
+            }
             p->pre_hook_buffered(n, (const int *) aut, nsupp, supp, p->saved_hook);
         }
     };
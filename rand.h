@@ -27,14 +27,65 @@ namespace dejavu::search_strategy {
         //std::default_random_engine& generator; /**< random number generator */
         random_source& rng;
         std::vector<int> heuristic_reroll;
+        std::vector<int> leaf_lab; /**< workspace to decompress colorings of stored leaves */
+        std::vector<int> sifted_supp, sifted_image; /**< copy of the automorphism being sifted, see \a h_group_hook */
 
         timed_print& gl_printer;
         groups::schreier_workspace&     gl_schreierw;
         groups::automorphism_workspace& gl_automorphism;
+        groups::pipelined_sifter        m_sifter; /**< sifting thread, only used if h_pipeline_sifting is set */
 
         /**
-         * Loads the leaf into the \p local_state. Only works if base of leaf was stored, i.e., whenever
-         * `full_save = false` was used in the constructor.
+         * Starts the sifting thread, if pipelined sifting is used. From here on, \p group must only be read through
+         * \a abort_criterion and \a finished_up_to_level, until \a end_sifting is called. The random source of the
+         * sifting thread is seeded from \a rng, such that it follows the random settings of the solver.
+         */
+        void begin_sifting(sgraph *g, groups::compressed_schreier &group) {
+            m_sifter.h_keep_changed = (h_group_hook != nullptr);
+            if(h_pipeline_sifting)
+                m_sifter.start(group, g->v_size, s_random_sift_success, rng.is_true_random(), rng());
+        }
+
+        /**
+         * Waits for all queued automorphisms to be sifted, and stops the sifting thread. Automorphisms which changed
+         * the Schreier structure are then reported to \a h_group_hook.
+         */
+        void end_sifting(sgraph *g) {
+            if(!h_pipeline_sifting) return;
+            m_sifter.stop();
+            s_random_sift_success = m_sifter.random_sift_success();
+            m_sifter.take_changed([this, g](const std::vector<int>& supp, const std::vector<int>& image) {
+                report_group_change(g, supp, image);
+            });
+        }
+
+        /**
+         * Calls \a h_group_hook with the automorphism mapping \p supp to \p image, using \a gl_automorphism as a
+         * workspace.
+         */
+        void report_group_change(sgraph *g, const std::vector<int>& supp, const std::vector<int>& image) {
+            gl_automorphism.reset();
+            for(int i = 0; i < static_cast<int>(supp.size()); ++i) gl_automorphism.write_single_map(supp[i], image[i]);
+            (*h_group_hook)(g->v_size, gl_automorphism.p(), gl_automorphism.nsupp(), gl_automorphism.supp());
+            gl_automorphism.reset();
+        }
+
+        [[nodiscard]] bool abort_criterion(const groups::compressed_schreier &group) const {
+            if(h_pipeline_sifting)
+                return m_sifter.probabilistic_abort_criterion() || m_sifter.deterministic_abort_criterion();
+            return group.probabilistic_abort_criterion() || group.deterministic_abort_criterion();
+        }
+
+        [[nodiscard]] int finished_up_to_level(const groups::compressed_schreier &group) const {
+            return h_pipeline_sifting? m_sifter.finished_up_to_level() : group.finished_up_to_level();
+        }
+
+        [[nodiscard]] int random_sift_success() const {
+            return h_pipeline_sifting? m_sifter.random_sift_success() : s_random_sift_success;
+        }
+
+        /**
+         * Loads the leaf into the \p local_state, by walking along the base of the leaf.
          *
          * @param leaf The leaf.
          * @param g The graph.
@@ -43,10 +94,7 @@ namespace dejavu::search_strategy {
          */
         static void load_state_from_leaf(sgraph *g, ir::controller &local_state, ir::limited_save &start_from,
                                   ir::stored_leaf *leaf) {
-            assert(leaf->get_store_type() == ir::stored_leaf::STORE_BASE);
-            std::vector<int> base;
-            base.reserve(leaf->get_lab_or_base_size());
-            for(int i = 0; i < leaf->get_lab_or_base_size(); ++i) base.push_back(leaf->get_lab_or_base()[i]);
+            std::vector<int> base(leaf->get_base(), leaf->get_base() + leaf->get_base_size());
             local_state.walk(g, start_from, base);
         }
 
@@ -61,13 +109,8 @@ namespace dejavu::search_strategy {
             assert(g->v_size == local_state.c->cells);
 
             // Outer loop to handle hash collisions -- at most h_hash_col_limit will be checked and stored
+            int cert_failures = 0;
             for(int hash_offset = 0; hash_offset < h_hash_col_limit; ++hash_offset) {
-                // after first hash collision, we write a stronger invariant
-                if(hash_offset == 1) local_state.write_strong_invariant_quarter(g);
-
-                // after second hash collision, an even stronger one
-                if(hash_offset == 2) local_state.write_strong_invariant(g);
-
                 // First, test whether leaf with same hash has already been stored
                 const unsigned long hash_c = local_state.T->get_hash() + hash_offset; // '+hash_offset' is for hash
                                                                                       // collisions
@@ -78,21 +121,39 @@ namespace dejavu::search_strategy {
                     ++s_leaves;
                     ++s_paths_failany;
                     s_rolling_success = (9.0 * s_rolling_success + 0.0) / 10.0;
-                    leaf_storage.add_leaf(hash_c, *local_state.c, local_state.base_vertex);
+                    leaf_storage.add_leaf(hash_c, *local_state.c, local_state.base_vertex,
+                                          local_state.T->get_hash128().high);
                     break;
                 }
 
+                // If the upper bits of the hash differ, the traces differ, and there is no need to certify
+                if (other_leaf->get_hash_high() != local_state.T->get_hash128().high) {
+                    ++leaf_storage.s_collisions;
+                    continue;
+                }
+
                 // If there is a leaf with the same hash, load the leaf and test automorphism
                 gl_automorphism.reset();
 
-                // Sometimes, a lab array is already stored for the leaf
-                if(other_leaf->get_store_type() == ir::stored_leaf::STORE_LAB) {
-                    const int* lab = other_leaf->get_lab_or_base();
-                    gl_automorphism.write_color_diff(local_state.c->vertex_to_col, lab);
-                } else {
-                    load_state_from_leaf(g, other_state, root_save, other_leaf);
-                    gl_automorphism.write_color_diff(local_state.c->vertex_to_col, other_state.c->lab);
+                // Sometimes, a lab array is already stored for the leaf (possibly compressed), otherwise we walk to
+                // the leaf
+                const int* lab;
+                switch(other_leaf->get_store_type()) {
+                    case ir::stored_leaf::STORE_LAB:
+                        lab = other_leaf->get_lab();
+                        break;
+                    case ir::stored_leaf::STORE_COMPRESSED:
+                        leaf_lab.resize(g->v_size);
+                        leaf_storage.load_lab(other_leaf, leaf_lab.data());
+                        lab = leaf_lab.data();
+                        break;
+                    default:
+                        load_state_from_leaf(g, other_state, root_save, other_leaf);
+                        lab = other_state.c->lab;
+                        break;
                 }
+                gl_automorphism.write_color_diff(local_state.c->vertex_to_col, lab);
+                leaf_storage.record_hit(other_leaf, lab, g->v_size);
 
 
                 const bool cert = local_state.certify(g, gl_automorphism);
@@ -106,9 +167,24 @@ namespace dejavu::search_strategy {
                     if(hook) (*hook)(g->v_size, gl_automorphism.p(), gl_automorphism.nsupp(),
                                      gl_automorphism.supp());
 
-                    // Sift into Schreier structure
+                    // Hand over to the sifting thread, without waiting for the result
+                    if(h_pipeline_sifting) {
+                        const bool queued = m_sifter.push(gl_automorphism, uniform);
+                        gl_automorphism.reset();
+                        return queued;
+                    }
+
+                    // Sift into Schreier structure, sifting changes the automorphism, so keep a copy if it is to be
+                    // reported
+                    if(h_group_hook) {
+                        sifted_supp.assign(gl_automorphism.supp(), gl_automorphism.supp() + gl_automorphism.nsupp());
+                        sifted_image.resize(sifted_supp.size());
+                        for(size_t i = 0; i < sifted_supp.size(); ++i)
+                            sifted_image[i] = gl_automorphism.p()[sifted_supp[i]];
+                    }
                     bool sift = group.sift(gl_schreierw, gl_automorphism, uniform);
                     gl_automorphism.reset();
+                    if(sift && h_group_hook) report_group_change(g, sifted_supp, sifted_image);
 
                     if(sift && group.s_densegen() + group.s_sparsegen() > 1 && s_random_sift_success > -5) {
                         int fail = 3; // 3
@@ -126,6 +202,14 @@ namespace dejavu::search_strategy {
                     gl_automorphism.reset();
                     return sift;
                 }
+
+                // The leaves have an equal hash, but are not automorphic: after the first failure, we write a stronger
+                // invariant, after the second failure, an even stronger one
+                ++leaf_storage.s_cert_failures;
+                ++cert_failures;
+                if(cert_failures == 1) local_state.write_strong_invariant_quarter(g);
+                if(cert_failures == 2) local_state.write_strong_invariant(g);
+                leaf_storage.s_strong_invariants += cert_failures <= 2;
             }
             gl_automorphism.reset();
             return false;
@@ -153,6 +237,9 @@ namespace dejavu::search_strategy {
         bool      h_sift_random     = true;               /**< sift random elements into Schreier structure    */
         int       h_sift_random_lim = 8;                  /**< after how many paths random elements are sifted */
         int       h_randomize_up_to = INT32_MAX;          /**< randomize vertex selection up to this level */
+        bool      h_pipeline_sifting = false;             /**< sift automorphisms on a dedicated thread        */
+        dejavu_hook* h_group_hook    = nullptr;           /**< if set, called for each automorphism which changed
+                                                            *  the Schreier structure                          */
 
         void use_look_close(bool look_close = false) {
             h_look_close = look_close;
@@ -184,6 +271,23 @@ namespace dejavu::search_strategy {
             s_min_split_number = INT32_MAX;
         }
 
+        /**
+         * Stores or restores the recorded statistics.
+         */
+        template<class A>
+        void serialize(A& ar) {
+            ar.value(s_rolling_success);
+            ar.value(s_rolling_first_level_success);
+            ar.value(s_trace_cost1);
+            ar.value(s_paths);
+            ar.value(s_paths_fail1);
+            ar.value(s_paths_failany);
+            ar.value(s_succeed);
+            ar.value(s_leaves);
+            ar.value(s_min_split_number);
+            ar.value(s_random_sift_success);
+        }
+
         static bool h_almost_done(groups::compressed_schreier &group) {
             return group.get_consecutive_success() >= 2;
         }
@@ -193,7 +297,8 @@ namespace dejavu::search_strategy {
             local_state.walk(g, *ir_tree.pick_node_from_level(0,0)->get_save(), base_vertex);
             auto other_leaf = ir_tree.stored_leaves.lookup_leaf(local_state.T->get_hash());
             if(other_leaf == nullptr) {
-                ir_tree.stored_leaves.add_leaf(local_state.T->get_hash(), *local_state.c, local_state.base_vertex);
+                ir_tree.stored_leaves.add_leaf(local_state.T->get_hash(), *local_state.c, local_state.base_vertex,
+                                               local_state.T->get_hash128().high);
             }
         }
 
@@ -219,6 +324,7 @@ namespace dejavu::search_strategy {
                           ir::controller& other_state, int fail_limit) {
             local_state.use_reversible(false);
             local_state.use_trace_early_out(false);
+            local_state.use_refinement_cache(true);
             other_state.use_reversible(false);
             other_state.use_trace_early_out(false);
 
@@ -235,11 +341,11 @@ namespace dejavu::search_strategy {
 
             int s_sifting_success = 0;
 
-            while(!group.probabilistic_abort_criterion() && !group.deterministic_abort_criterion() &&
-                    s_paths_failany < fail_limit) {
+            begin_sifting(g, group);
+            while(!abort_criterion(group) && s_paths_failany < fail_limit) {
                 local_state.load_reduced_state(*start_from);
 
-                int could_start_from = group.finished_up_to_level();
+                int could_start_from = finished_up_to_level(group);
 
                 if(s_paths_failany > 8 && (s_paths & 0x00000FFF) == 0x000000FE)
                     gl_printer.progress_current_method("random", "leaves", ir_tree.stat_leaves(), "f1", s_paths_fail1,
@@ -260,7 +366,7 @@ namespace dejavu::search_strategy {
                     if(progress_now - progress_initial > 0.1) {
                         gl_printer.progress_current_method("random", "root_cells", 1.0 * s_cells_now / g->v_size,
                                                            "base_pos", could_start_from,
-                                                           "sift", s_sifting_success, "rsift", s_random_sift_success);
+                                                           "sift", s_sifting_success, "rsift", random_sift_success());
                         progress_initial = progress_now;
                     }
                 }
@@ -296,7 +402,7 @@ namespace dejavu::search_strategy {
                     // itself, let's try to create sparse generators by trying to stick to the base after a few
                     // individualizations
                     if(base_pos > start_from_base_pos + 1 && g->v_size > 5000 && s_sifting_success >= 0 &&
-                       s_random_sift_success < 0 &&
+                       random_sift_success() < 0 &&
                        base_pos < static_cast<int>(local_state.compare_base_vertex->size())) {
                         // or even better: let's choose the base vertex, if it's in the correct color
                         const int v_base     = (*local_state.compare_base_vertex)[base_pos];
@@ -312,8 +418,9 @@ namespace dejavu::search_strategy {
 
                     // base-aware search: if we are still walking along the base, and the vertex we picked is in the
                     // same orbit as the base -- we might as well keep walking on the base, or choose a different vertex
-                    if(group.finished_up_to_level() + 1 == base_pos && group.is_in_base_orbit(base_pos, v)
-                         && ir_tree.stored_leaves.s_leaves <= 1) {
+                    // (reads the transversals, so not done while they are being updated by the sifting thread)
+                    if(!h_pipeline_sifting && group.finished_up_to_level() + 1 == base_pos &&
+                       group.is_in_base_orbit(base_pos, v) && ir_tree.stored_leaves.s_leaves <= 1) {
                         heuristic_reroll.clear();
                         for(int i = 0; i < col_sz; ++i) {
                             heuristic_reroll.push_back(local_state.c->lab[col + i]);
@@ -363,10 +470,13 @@ namespace dejavu::search_strategy {
                 // automorphism -- or add this leaf to the storage
                 const bool sift = add_leaf_to_storage_and_group(g, hook, group, ir_tree.stored_leaves, local_state,
                                                                 other_state, *root_save, uniform);
+                ir_tree.stored_leaves.apply_promotions();
                 s_sifting_success += sift?1:-1;
                 s_sifting_success += sift && !uniform?1:0;
                 s_sifting_success = std::max(std::min(s_sifting_success, 10), -10);
             }
+            end_sifting(g);
+            local_state.use_refinement_cache(false);
         }
 
         /**
@@ -390,20 +500,21 @@ namespace dejavu::search_strategy {
                                     ir::controller &local_state, ir::controller& other_state, int fail_limit) {
             local_state.use_reversible(false);
             local_state.use_trace_early_out(false);
+            local_state.use_refinement_cache(true);
             s_rolling_first_level_success = 1;
             const int pick_from_level = ir_tree.get_finished_up_to();
 
             other_state.link_compare(&local_state);
 
-            while(!group.probabilistic_abort_criterion() && !group.deterministic_abort_criterion() &&
-                    s_paths_failany < fail_limit) {
+            begin_sifting(g, group);
+            while(!abort_criterion(group) && s_paths_failany < fail_limit) {
 
                 if((s_paths & 0x000000FF) == 0x000000FE)
                     gl_printer.progress_current_method("random", "leaves", ir_tree.stat_leaves(), "f1", s_paths_fail1,
                                                        "compress", group.s_compression_ratio);
 
                 auto node = ir_tree.pick_node_from_level(pick_from_level, rng());
-                local_state.load_reduced_state(*node->get_save());
+                local_state.load_reduced_state(*node->get_save(), g);
 
                 int base_pos                  = local_state.s_base_pos;
                 const int start_from_base_pos = base_pos;
@@ -436,7 +547,10 @@ namespace dejavu::search_strategy {
 
                 add_leaf_to_storage_and_group(g, hook, group, ir_tree.stored_leaves, local_state, other_state,
                                               *ir_tree.pick_node_from_level(0, 0)->get_save(), true);
+                ir_tree.stored_leaves.apply_promotions();
             }
+            end_sifting(g);
+            local_state.use_refinement_cache(false);
         }
     };
 }
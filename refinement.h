@@ -5,10 +5,14 @@
 #ifndef DEJAVU_REFINEMENT_H
 #define DEJAVU_REFINEMENT_H
 
+#include <atomic>
+#include <chrono>
+#include <iomanip>
 #include "ds.h"
 #include "coloring.h"
 #include "graph.h"
 #include "utility.h"
+#include "simd.h"
 
 namespace dejavu {
 
@@ -50,9 +54,55 @@ namespace dejavu {
                 return comp;
             }
 
+            // checks whether the image of every neighbour of a point in the support is a neighbour of the image of the
+            // point, using the adjacency matrix of the graph -- if p is a bijection and degrees agree, this means that
+            // p preserves neighbourhoods
+            static bool neighbours_preserved_bit_matrix(const sgraph *g, const bit_matrix& adjacency, const int *p,
+                                                        int supp, const int *supp_arr) {
+                for (int f = 0; f < supp; ++f) {
+                    const int i = supp_arr ? supp_arr[f] : f;
+                    const int image_i = p[i];
+                    if (image_i == i) continue;
+                    if (g->d[i] != g->d[image_i]) return false;
+                    const int start_pt = g->v[i];
+                    const int end_pt   = g->v[i] + g->d[i];
+                    for (int j = start_pt; j < end_pt; ++j) {
+                        if (!adjacency.get(image_i, p[g->e[j]])) return false;
+                    }
+                }
+                return true;
+            }
+
+            // checks whether p maps half-edges to half-edges of the same color, i.e., preserves edge colors and arcs --
+            // assumes that p preserves neighbourhoods, such that every entry of image_color which is read was written
+            static bool edge_colors_preserved(int* image_color, const sgraph *g, const int *p, int supp,
+                                              const int *supp_arr) {
+                for (int f = 0; f < supp; ++f) {
+                    const int i = supp_arr ? supp_arr[f] : f;
+                    const int image_i = p[i];
+                    if (image_i == i) continue;
+                    for (int j = g->v[i]; j < g->v[i] + g->d[i]; ++j) image_color[p[g->e[j]]] = g->ec[j];
+                    for (int j = g->v[image_i]; j < g->v[image_i] + g->d[image_i]; ++j) {
+                        if (image_color[g->e[j]] != g->ec[j]) return false;
+                    }
+                }
+                return true;
+            }
+
+            // on edge-colored or directed graphs, checks half-edge colors using image_color if given, or a temporary
+            // array otherwise
+            static bool edge_colors_preserved(workspace* image_color, const sgraph *g, const int *p, int supp,
+                                              const int *supp_arr) {
+                if (g->ec == nullptr) return true;
+                if (image_color != nullptr) return edge_colors_preserved(image_color->get_array(), g, p, supp, supp_arr);
+                workspace temporary_image_color(g->v_size);
+                return edge_colors_preserved(temporary_image_color.get_array(), g, p, supp, supp_arr);
+            }
+
         public:
             // certify an automorphism on a graph
-            static bool certify_automorphism(markset& scratch_set, sgraph *g, const int *p) {
+            static bool certify_automorphism(markset& scratch_set, sgraph *g, const int *p,
+                                             workspace* edge_color_scratch = nullptr) {
                 if(!bijection_check(scratch_set, g->v_size, p)) return false;
 
                 for (int i = 0; i < g->v_size; ++i) {
@@ -81,12 +131,12 @@ namespace dejavu {
                     if (found != 0) return false;
                 }
 
-                return true;
+                return edge_colors_preserved(edge_color_scratch, g, p, g->v_size, nullptr);
             }
 
             // certify an automorphism on a graph, sparse
             static bool certify_automorphism_sparse(markset& scratch_set, const sgraph *g, const int *p, int supp,
-                                                    const int *supp_arr) {
+                                                    const int *supp_arr, workspace* edge_color_scratch = nullptr) {
                 int i, found;
                 if(!cycle_check(scratch_set, p, supp, supp_arr)) return false;
 
@@ -120,7 +170,22 @@ namespace dejavu {
                     }
                 }
                 scratch_set.reset();
-                return true;
+                return edge_colors_preserved(edge_color_scratch, g, p, supp, supp_arr);
+            }
+
+            // certify an automorphism on a graph, using the adjacency matrix of the graph
+            static bool certify_automorphism_bit_matrix(markset& scratch_set, const sgraph *g,
+                                                        const bit_matrix& adjacency, const int *p) {
+                if(!bijection_check(scratch_set, g->v_size, p)) return false;
+                return neighbours_preserved_bit_matrix(g, adjacency, p, g->v_size, nullptr);
+            }
+
+            // certify an automorphism on a graph, sparse, using the adjacency matrix of the graph
+            static bool certify_automorphism_sparse_bit_matrix(markset& scratch_set, const sgraph *g,
+                                                               const bit_matrix& adjacency, const int *p, int supp,
+                                                               const int *supp_arr) {
+                if(!cycle_check(scratch_set, p, supp, supp_arr)) return false;
+                return neighbours_preserved_bit_matrix(g, adjacency, p, supp, supp_arr);
             }
         };
 
@@ -133,6 +198,134 @@ namespace dejavu {
         // bool worklist_color_hook(int color, int color_sz);
         typedef bool type_worklist_color_hook(const int, const int);
 
+        /**
+         * \brief Hook policy that does nothing
+         *
+         * Hook policies are callable types which are passed to the templated variants of \a refine_coloring and
+         * \a individualize_vertex, and are called whenever a color class is split, or whenever a color class is
+         * considered for refinement. Since the type of the policy is known at compile time, calls to hooks are inlined
+         * and calls to this policy vanish entirely.
+         */
+        struct no_hook {
+            bool operator()(const int, const int, const int) const { return true; }
+            bool operator()(const int, const int) const { return true; }
+        };
+
+        /**
+         * \brief Hook policy that calls a split hook given as a `std::function`, if there is one
+         */
+        struct function_split_hook {
+            const std::function<type_split_color_hook>* hook;
+            bool operator()(const int old_color, const int new_color, const int new_color_sz) const {
+                return hook == nullptr || !(*hook) || (*hook)(old_color, new_color, new_color_sz);
+            }
+        };
+
+        /**
+         * \brief Hook policy that calls a worklist hook given as a `std::function`, if there is one
+         */
+        struct function_worklist_hook {
+            const std::function<type_worklist_color_hook>* hook;
+            bool operator()(const int color, const int color_sz) const {
+                return !(*hook) || (*hook)(color, color_sz);
+            }
+        };
+
+#ifdef DEJAVU_PROFILE_REFINEMENT
+        constexpr bool profile_refinement = true;  /**< whether refinement kernels are profiled */
+#else
+        constexpr bool profile_refinement = false; /**< whether refinement kernels are profiled */
+#endif
+
+        /**
+         * Kernels of color refinement, as dispatched by \a refinement::refine_coloring and
+         * \a refinement::refine_coloring_first.
+         */
+        enum refinement_kernel {
+            rk_singleton, rk_dense_dense, rk_dense_cell, rk_dense, rk_sparse, rk_edge_colored,
+            rk_singleton_first, rk_dense_dense_first, rk_dense_first, rk_sparse_first, rk_count
+        };
+
+        /**
+         * \brief Counters for the kernels of color refinement
+         *
+         * Counts calls, half-edges of the refined color classes, cells split and cycles spent (nanoseconds on non-x86
+         * platforms) per kernel. Counters are only collected if dejavu is compiled with `DEJAVU_PROFILE_REFINEMENT`,
+         * in which case all refinement workspaces add to \a global, and the solver prints the counters at the end of
+         * \a solver::automorphisms.
+         */
+        class refinement_profile {
+        public:
+            std::atomic<long> calls[rk_count];
+            std::atomic<long> half_edges[rk_count];
+            std::atomic<long> cells_split[rk_count];
+            std::atomic<long> cycles[rk_count];
+
+            refinement_profile() {
+                reset();
+            }
+
+            /**
+             * @return the profile all refinement workspaces add to
+             */
+            static refinement_profile& global() {
+                static refinement_profile profile;
+                return profile;
+            }
+
+            /**
+             * @return a timestamp in cycles (nanoseconds on non-x86 platforms)
+             */
+            static long timestamp() {
+#ifdef DEJAVU_SIMD_X86
+                return static_cast<long>(__rdtsc());
+#else
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+            }
+
+            void reset() {
+                for(int k = 0; k < rk_count; ++k) {
+                    calls[k]       = 0;
+                    half_edges[k]  = 0;
+                    cells_split[k] = 0;
+                    cycles[k]      = 0;
+                }
+            }
+
+            void record(const refinement_kernel kernel, const long kernel_half_edges, const long kernel_cells_split,
+                        const long kernel_cycles) {
+                calls[kernel].fetch_add(1, std::memory_order_relaxed);
+                half_edges[kernel].fetch_add(kernel_half_edges, std::memory_order_relaxed);
+                cells_split[kernel].fetch_add(kernel_cells_split, std::memory_order_relaxed);
+                cycles[kernel].fetch_add(kernel_cycles, std::memory_order_relaxed);
+            }
+
+            /**
+             * Prints one line per kernel which was called.
+             *
+             * @param out stream to print to
+             */
+            void print(std::ostream& out) const {
+                static const char* names[rk_count] = {"singleton", "dense_dense", "dense_cell", "dense", "sparse",
+                                                      "edge_colored", "singleton_first", "dense_dense_first", "dense_first",
+                                                      "sparse_first"};
+                long total_cycles = 0;
+                for(int k = 0; k < rk_count; ++k) total_cycles += cycles[k];
+                out << std::left << std::setw(19) << "kernel" << std::right << std::setw(12) << "calls"
+                    << std::setw(15) << "half_edges" << std::setw(12) << "splits" << std::setw(16) << "cycles"
+                    << std::setw(8) << "%" << std::endl;
+                for(int k = 0; k < rk_count; ++k) {
+                    if(calls[k] == 0) continue;
+                    out << std::left << std::setw(19) << names[k] << std::right << std::setw(12) << calls[k]
+                        << std::setw(15) << half_edges[k] << std::setw(12) << cells_split[k] << std::setw(16)
+                        << cycles[k] << std::setw(8) << std::fixed << std::setprecision(1)
+                        << (total_cycles > 0 ? 100.0 * cycles[k] / total_cycles : 0.0) << std::endl;
+                }
+            }
+        };
+
         /**
          * \brief Color refinement and related algorithms
          *
@@ -142,9 +335,18 @@ namespace dejavu {
         */
         class refinement {
             bool g_early_out = false;
-            const std::function<type_split_color_hook>* g_split_hook;
 
         public:
+            int h_threads = 1; /**< number of threads used by \a refine_coloring_first */
+            int h_parallel_min_edges = 262144; /**< only count neighbours of a color class with multiple threads if it
+                                                 *  has roughly this many incident edges */
+            simd::instruction_set h_instruction_set = simd::select_instruction_set(); /**< instruction set used by
+                                                                                          * vectorized kernels */
+            int    h_bit_matrix_max_vertices = 16384; /**< only build bit matrices for graphs up to this size */
+            double h_bit_matrix_min_density  = 0.1;   /**< only build bit matrices for graphs of at least this density */
+            int h_radix_sort_min = 192; /**< sort color classes and neighbour counts of at least this many elements using
+                                          *  radix sort (see benchmarks/refinement_benchmark.cpp) */
+
             /**
              * The color refinement algorithm. Refines a given coloring with respect to a given graph.
              * @param g The graph.
@@ -161,6 +363,32 @@ namespace dejavu {
             void refine_coloring(sgraph *g, coloring *c, int init_color = -1, int color_limit = -1,
                                  const std::function<type_split_color_hook>* split_hook = nullptr,
                                  const std::function<type_worklist_color_hook> &worklist_hook = nullptr) {
+                if(split_hook == nullptr && !worklist_hook) {
+                    no_hook hook;
+                    refine_coloring(g, c, init_color, color_limit, hook, hook);
+                } else {
+                    function_split_hook    split    {split_hook};
+                    function_worklist_hook worklist {&worklist_hook};
+                    refine_coloring(g, c, init_color, color_limit, split, worklist);
+                }
+            }
+
+            /**
+             * The color refinement algorithm, with hooks given as policies (see \a no_hook). Since the hooks are known
+             * at compile time, they are inlined into the refinement.
+             *
+             * @param g The graph.
+             * @param c The coloring to be refined.
+             * @param init_color Initialize the worklist with a single color class (see above).
+             * @param color_limit Stop refinement whenever the coloring reaches this number of color classes (see above).
+             * @param split_hook Called whenever a color class is split. Return value can be used to stop refinement
+             * early.
+             * @param worklist_hook Called whenever a color class is considered for refinement. Return value can be used
+             * to skip refinement of that color class.
+             */
+            template<class split_policy, class worklist_policy>
+            void refine_coloring(sgraph *g, coloring *c, int init_color, int color_limit, split_policy& split_hook,
+                                 worklist_policy& worklist_hook) {
                 assure_initialized(g);
                 cell_todo.reset(queue_pointer);
 
@@ -178,31 +406,45 @@ namespace dejavu {
                 }
 
                 g_early_out  = false;
-                g_split_hook = split_hook;
 
                 while (!cell_todo.empty()) {
                     const int next_color_class    = cell_todo.next_cell(queue_pointer, c);
                     const int next_color_class_sz = c->ptn[next_color_class] + 1;
 
-                    if (worklist_hook && !worklist_hook(next_color_class, next_color_class_sz)) continue;
+                    if (!worklist_hook(next_color_class, next_color_class_sz)) continue;
 
                     // this scheme is reverse-engineered from the color refinement in Traces by Adolfo Piperno
                     // we choose a separate algorithm depending on the size and density of the graph and/or color class
+                    // -- edge-colored and directed graphs always use the same algorithm
                     const int  test_deg   = g->d[c->lab[next_color_class]];
-                    const bool very_dense = test_deg > (g->v_size / (next_color_class_sz + 1));
-                    const bool cell_dense = test_deg > (c->cells);
-                    if (next_color_class_sz == 1 && !(g->dense && very_dense)) { // singleton
-                        refine_color_class_singleton(g, c, next_color_class);
+                    const bool very_dense = test_deg > (g->v_size / (next_color_class_sz + 1)) * g->dense_dense_factor;
+                    const bool cell_dense = test_deg > (c->cells) * g->dense_cell_factor;
+                    if (g->ec != nullptr) { // edge-colored or directed
+                        run_kernel(rk_edge_colored, g, c, next_color_class, next_color_class_sz, [&]() {
+                            refine_color_class_edge_colored(g, c, next_color_class, next_color_class_sz, split_hook);
+                        });
+                    } else if (next_color_class_sz == 1 && !(g->dense && very_dense)) { // singleton
+                        run_kernel(rk_singleton, g, c, next_color_class, next_color_class_sz, [&]() {
+                            refine_color_class_singleton(g, c, next_color_class, split_hook);
+                        });
                     } else if (g->dense) {
                         if (very_dense) { // dense-dense
-                            refine_color_class_dense_dense(g, c, next_color_class,next_color_class_sz);
+                            run_kernel(rk_dense_dense, g, c, next_color_class, next_color_class_sz, [&]() {
+                                refine_color_class_dense_dense(g, c, next_color_class,next_color_class_sz, split_hook);
+                            });
                         } else if(cell_dense) { // dense-cell
-                            refine_color_class_dense_cell(g, c, next_color_class, next_color_class_sz);
+                            run_kernel(rk_dense_cell, g, c, next_color_class, next_color_class_sz, [&]() {
+                                refine_color_class_dense_cell(g, c, next_color_class, next_color_class_sz, split_hook);
+                            });
                         } else { // dense-sparse
-                            refine_color_class_dense(g, c, next_color_class, next_color_class_sz);
+                            run_kernel(rk_dense, g, c, next_color_class, next_color_class_sz, [&]() {
+                                refine_color_class_dense(g, c, next_color_class, next_color_class_sz, split_hook);
+                            });
                         }
                     } else { // sparse
-                        refine_color_class_sparse(g, c, next_color_class, next_color_class_sz);
+                        run_kernel(rk_sparse, g, c, next_color_class, next_color_class_sz, [&]() {
+                            refine_color_class_sparse(g, c, next_color_class, next_color_class_sz, split_hook);
+                        });
                     }
 
                     if (g_early_out) {
@@ -225,12 +467,40 @@ namespace dejavu {
                 }
             }
         private:
+            /**
+             * Runs a kernel of color refinement on a color class. If dejavu is compiled with
+             * `DEJAVU_PROFILE_REFINEMENT`, the kernel is profiled in \a refinement_profile::global.
+             *
+             * @param kernel the kernel, used to attribute counters
+             * @param g the graph
+             * @param c the coloring
+             * @param color_class the color class refined by the kernel
+             * @param class_size size of \p color_class
+             * @param call runs the kernel
+             */
+            template<class kernel_call>
+            static void run_kernel(const refinement_kernel kernel, const sgraph *g, const coloring *c,
+                                   const int color_class, const int class_size, kernel_call&& call) {
+                if constexpr (!profile_refinement) {
+                    call();
+                } else {
+                    long half_edges = 0;
+                    for (int i = color_class; i < color_class + class_size; ++i) half_edges += g->d[c->lab[i]];
+                    const int  cells_before = c->cells;
+                    const long start = refinement_profile::timestamp();
+                    call();
+                    refinement_profile::global().record(kernel, half_edges, c->cells - cells_before,
+                                                        refinement_profile::timestamp() - start);
+                }
+            }
+
+            template<class split_policy>
             void report_split_color_class(coloring* c, const int old_class, const int new_class, const int new_class_sz,
-                                          const bool is_largest) {
+                                          const bool is_largest, split_policy& split_hook) {
                 c->cells += (old_class != new_class);
                 assert(c->ptn[new_class] + 1 == new_class_sz);
 
-                if ((g_split_hook != nullptr) && !(*g_split_hook)(old_class, new_class, new_class_sz)) {
+                if (!split_hook(old_class, new_class, new_class_sz)) {
                     g_early_out = true;
                 }
 
@@ -254,6 +524,19 @@ namespace dejavu {
              */
             static int
             individualize_vertex(coloring *c, int v, const std::function<type_split_color_hook> &split_hook = nullptr) {
+                function_split_hook split {&split_hook};
+                return individualize_vertex<function_split_hook>(c, v, split);
+            }
+
+            /**
+             * Individualizes a vertex in a coloring, with the split hook given as a policy (see \a no_hook).
+             * @param c Coloring in which the vertex is individualized.
+             * @param v Vertex to be individualized.
+             * @param split_hook Called whenever a color class is split. Return value is not used.
+             * @return
+             */
+            template<class split_policy>
+            static int individualize_vertex(coloring *c, int v, split_policy& split_hook) {
                 const int color = c->vertex_to_col[v];
                 const int pos = c->vertex_to_lab[v];
 
@@ -274,10 +557,8 @@ namespace dejavu {
                 c->ptn[color + color_class_size - 1] = 0;
                 c->cells += 1;
 
-                if (split_hook) {
-                    split_hook(color, color + color_class_size, 1);
-                    split_hook(color, color, c->ptn[color] + 1);
-                }
+                split_hook(color, color + color_class_size, 1);
+                split_hook(color, color, c->ptn[color] + 1);
 
                 return color + color_class_size;
             }
@@ -293,6 +574,10 @@ namespace dejavu {
              * default value -1 denotes that the worklist is initialized with all color classes of the coloring.
              */
             void refine_coloring_first(sgraph *g, coloring *c, int init_color_class = -1) {
+                if (g->ec != nullptr) { // no optimized kernels for edge-colored or directed graphs
+                    refine_coloring(g, c, init_color_class);
+                    return;
+                }
                 assure_initialized(g);
                 singleton_hint.reset();
 
@@ -318,15 +603,23 @@ namespace dejavu {
 
                     if (next_color_class_sz == 1 && !(g->dense && very_dense)) {
                         // singleton
-                        refine_color_class_singleton_first(g, c, next_color_class);
+                        run_kernel(rk_singleton_first, g, c, next_color_class, next_color_class_sz, [&]() {
+                            refine_color_class_singleton_first(g, c, next_color_class);
+                        });
                     } else if (g->dense) {
                         if (very_dense) { // dense-dense
-                            refine_color_class_dense_dense_first(g, c, next_color_class, next_color_class_sz);
+                            run_kernel(rk_dense_dense_first, g, c, next_color_class, next_color_class_sz, [&]() {
+                                refine_color_class_dense_dense_first(g, c, next_color_class, next_color_class_sz);
+                            });
                         } else { // dense-sparse
-                            refine_color_class_dense_first(g, c, next_color_class, next_color_class_sz);
+                            run_kernel(rk_dense_first, g, c, next_color_class, next_color_class_sz, [&]() {
+                                refine_color_class_dense_first(g, c, next_color_class, next_color_class_sz);
+                            });
                         }
                     } else { // sparse
-                        refine_color_class_sparse_first(g, c, next_color_class, next_color_class_sz);
+                        run_kernel(rk_sparse_first, g, c, next_color_class, next_color_class_sz, [&]() {
+                            refine_color_class_sparse_first(g, c, next_color_class, next_color_class_sz);
+                        });
                     }
 
                     if (c->cells == g->v_size) {
@@ -372,7 +665,8 @@ namespace dejavu {
              */
             bool certify_automorphism(sgraph *g, const int *p) {
                 assure_initialized(g);
-                return certification::certify_automorphism(scratch_set, g, p);
+                if (has_bit_matrix(g)) return certification::certify_automorphism_bit_matrix(scratch_set, g, adjacency, p);
+                return certification::certify_automorphism(scratch_set, g, p, &neighbour_buffer);
             }
 
             /**
@@ -389,7 +683,150 @@ namespace dejavu {
              */
             bool certify_automorphism_sparse(const sgraph *g, const int *p, int supp, const int *supp_arr) {
                 assure_initialized(g);
-                return certification::certify_automorphism_sparse(scratch_set, g, p, supp, supp_arr);
+                if (has_bit_matrix(g)) {
+                    return certification::certify_automorphism_sparse_bit_matrix(scratch_set, g, adjacency, p, supp,
+                                                                                 supp_arr);
+                }
+                return certification::certify_automorphism_sparse(scratch_set, g, p, supp, supp_arr,
+                                                                  &neighbour_buffer);
+            }
+
+            /**
+             * Builds the adjacency matrix of \p g as a bit matrix, if \p g is dense enough (see
+             * \a h_bit_matrix_min_density), not too large (see \a h_bit_matrix_max_vertices), and neither
+             * edge-colored nor directed (see \a sgraph::ec). The matrix is then used for color refinement and
+             * certification on \p g, until \a clear_bit_matrix is called. Hence, \p g must not be modified in the
+             * meantime.
+             *
+             * @param g the graph
+             * @return whether the bit matrix was built
+             */
+            bool build_bit_matrix(const sgraph *g) {
+                clear_bit_matrix();
+                if (!g->dense || g->ec != nullptr || g->v_size > h_bit_matrix_max_vertices ||
+                    g->e_size < h_bit_matrix_min_density * g->v_size * (g->v_size - 1.0)) return false;
+
+                adjacency.initialize(g->v_size);
+                for (int i = 0; i < g->v_size; ++i) {
+                    for (int j = g->v[i]; j < g->v[i] + g->d[i]; ++j) adjacency.set(i, g->e[j]);
+                }
+                adjacency_graph = g;
+                return true;
+            }
+
+            /**
+             * Calibrates which kernels color refinement uses on \p g, i.e., \a sgraph::dense,
+             * \a sgraph::dense_dense_factor and \a sgraph::dense_cell_factor. Times a few dives of
+             * individualization-refinement starting from \p c for candidate configurations, and keeps the fastest one.
+             * First, sparse and dense refinement are compared. If dense refinement is used, the two factors are then
+             * calibrated one after the other. A candidate is aborted as soon as it is slower than the best one so far,
+             * and the default configuration is only replaced if a candidate is at least 10% faster.
+             *
+             * Since the kernels may split color classes in a different order, the configuration must be fixed before
+             * any other color refinement is performed on \p g, and all refinement workspaces used for \p g then use
+             * the same configuration. Releases the bit matrix built by \a build_bit_matrix. Edge-colored and directed
+             * graphs always use the same kernel, hence nothing is calibrated for them.
+             *
+             * @param g the graph
+             * @param c an initial coloring of \p g
+             * @param samples number of dives per configuration
+             * @param max_depth maximum number of individualizations per dive
+             * @return whether a configuration other than the default was chosen
+             */
+            bool calibrate_dispatch(sgraph *g, coloring *c, const int samples = 3, const int max_depth = 8) {
+                if (g->ec != nullptr) return false;
+
+                struct dispatch {
+                    bool   dense;
+                    double dense_dense_factor;
+                    double dense_cell_factor;
+                };
+
+                // stops refinement once a candidate is slower than the best one so far
+                struct deadline_hook {
+                    std::chrono::steady_clock::time_point deadline;
+                    int  splits  = 0;
+                    bool expired = false;
+                    bool operator()(const int, const int, const int) {
+                        if ((++splits & 63) == 0) expired = expired || std::chrono::steady_clock::now() > deadline;
+                        return !expired;
+                    }
+                    bool operator()(const int, const int) const { return true; }
+                };
+
+                coloring work;
+
+                // time dives using the given configuration, returns a negative value if the time limit was exceeded
+                const auto measure = [&](const dispatch& candidate, const double time_limit) {
+                    g->dense              = candidate.dense;
+                    g->dense_dense_factor = candidate.dense_dense_factor;
+                    g->dense_cell_factor  = candidate.dense_cell_factor;
+                    clear_bit_matrix();
+                    build_bit_matrix(g);
+
+                    const auto start = std::chrono::steady_clock::now();
+                    deadline_hook hook;
+                    hook.deadline = time_limit < 0 ? std::chrono::steady_clock::time_point::max() :
+                                    start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                            std::chrono::duration<double>(time_limit));
+                    for (int sample = 0; sample < samples && !hook.expired; ++sample) {
+                        work.copy_any(c);
+                        refine_coloring(g, &work, -1, -1, hook, hook);
+                        for (int depth = 0; depth < max_depth && work.cells < g->v_size && !hook.expired; ++depth) {
+                            // individualize a vertex of the first non-singleton cell, varying the vertex on the first
+                            // level between samples
+                            int cell = 0;
+                            while (work.ptn[cell] == 0) ++cell;
+                            const int pos = cell + (depth == 0 ? sample % (work.ptn[cell] + 1) : 0);
+                            const int init_color_class = individualize_vertex(&work, work.lab[pos], hook);
+                            refine_coloring(g, &work, init_color_class, -1, hook, hook);
+                        }
+                    }
+                    if (hook.expired) return -1.0;
+                    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                };
+
+                const dispatch default_dispatch = {g->dense, 1.0, 1.0};
+                dispatch best = default_dispatch;
+                double best_time = 0.9 * measure(best, -1); // only replace the default if it's clearly worse
+                const auto consider = [&](const dispatch& candidate) {
+                    const double time = measure(candidate, best_time);
+                    if (time >= 0 && time < best_time) {
+                        best      = candidate;
+                        best_time = time;
+                    }
+                };
+
+                consider({!g->dense, 1.0, 1.0});
+                if (best.dense) {
+                    for (const double factor : {0.25, 4.0}) consider({true, factor, 1.0});
+                    const double dense_dense_factor = best.dense_dense_factor;
+                    for (const double factor : {0.25, 4.0}) consider({true, dense_dense_factor, factor});
+                }
+
+                clear_bit_matrix();
+                g->dense              = best.dense;
+                g->dense_dense_factor = best.dense_dense_factor;
+                g->dense_cell_factor  = best.dense_cell_factor;
+                return best.dense != default_dispatch.dense ||
+                       best.dense_dense_factor != default_dispatch.dense_dense_factor ||
+                       best.dense_cell_factor  != default_dispatch.dense_cell_factor;
+            }
+
+            /**
+             * Releases the bit matrix built by \a build_bit_matrix.
+             */
+            void clear_bit_matrix() {
+                adjacency.clear();
+                adjacency_graph = nullptr;
+            }
+
+            /**
+             * @param g the graph
+             * @return whether a bit matrix of \p g was built using \a build_bit_matrix
+             */
+            [[nodiscard]] bool has_bit_matrix(const sgraph *g) const {
+                return g == adjacency_graph && g->v_size == adjacency.size();
             }
 
         private:
@@ -511,6 +948,21 @@ namespace dejavu {
             workset_t<int>  neighbour_sizes;
             worklist_t<int> old_color_classes;
             workspace       scratch;
+            workspace       neighbour_buffer;
+
+            // adjacency matrix of a dense graph, see build_bit_matrix
+            bit_matrix      adjacency;
+            const sgraph*   adjacency_graph = nullptr;
+            std::vector<uint64_t> cell_bits;
+
+            // (edge color, neighbour) pairs of a color class, see refine_color_class_edge_colored
+            std::vector<std::pair<int, int>> edge_color_hits;
+
+            // helper data structures for multi-threaded neighbour counting
+            int parallel_domain_size = 0;
+            std::unique_ptr<std::atomic<int>[]> parallel_count;
+            std::unique_ptr<std::atomic<int>[]> parallel_first_hit;
+            std::vector<std::vector<int>> parallel_hits;
 
             void assure_initialized(const sgraph *g) {
                 if (g->v_size > domain_size) {
@@ -524,17 +976,18 @@ namespace dejavu {
                     queue_pointer.initialize(n);
                     color_vertices_considered.initialize(n);
                     scratch.resize(n);
+                    neighbour_buffer.resize(n);
                     scratch_set.initialize(n);
                     cell_todo.initialize(n * 2);
                     domain_size = n;
                 }
             }
 
+            template<class split_policy>
             void refine_color_class_sparse(sgraph *g, coloring *c, int color_class,
-                                           int class_size) {
+                                           int class_size, split_policy& split_hook) {
                 // for all vertices of the color class...
-                int i, j, cc, end_cc, largest_color_class_size, acc;
-                int *vertex_to_lab = c->vertex_to_lab;
+                int i, cc, end_cc;
                 int *lab = c->lab;
                 int *ptn = c->ptn;
                 int *vertex_to_col = c->vertex_to_col;
@@ -570,8 +1023,24 @@ namespace dejavu {
                     cc += 1;
                 }
 
+                split_color_classes_sparse(g, c, split_hook);
+            }
+
+            /**
+             * Splitting phase of the sparse refinement methods: splits the color classes in `old_color_classes`
+             * according to the neighbour counts in `neighbours`, where `color_vertices_considered` and `scratch` contain
+             * the counted vertices of each color class.
+             */
+            template<class split_policy>
+            void split_color_classes_sparse(sgraph *g, coloring *c, split_policy& split_hook) {
+                int i, j, largest_color_class_size, acc;
+                int *vertex_to_lab = c->vertex_to_lab;
+                int *lab = c->lab;
+                int *ptn = c->ptn;
+                int *vertex_to_col = c->vertex_to_col;
+
                 // sort split color classes
-                old_color_classes.sort();
+                old_color_classes.sort(c->domain_size, h_radix_sort_min);
 
                 // split color classes according to neighbour count
                 while (!old_color_classes.empty()) {
@@ -599,7 +1068,7 @@ namespace dejavu {
                         continue;
                     }
 
-                    vertex_worklist.sort();
+                    vertex_worklist.sort(g->v_size + 1, h_radix_sort_min);
 
                     // enrich neighbour_sizes to accumulative counting array
                     acc = 0;
@@ -661,7 +1130,7 @@ namespace dejavu {
                     for (i = _col; i < _col + _col_sz;) {
                         const int i_sz = ptn[i] + 1;
                         const bool is_largest = i == largest_color_class;
-                        report_split_color_class(c, _col, i, i_sz, is_largest);
+                        report_split_color_class(c, _col, i, i_sz, is_largest, split_hook);
                         i += i_sz;
                     }
                 }
@@ -670,7 +1139,98 @@ namespace dejavu {
                 vertex_worklist.reset();
             }
 
-            void refine_color_class_dense(sgraph *g, coloring *c, int color_class, int class_size) {
+            /**
+             * Refinement of a color class on an edge-colored or directed graph (see \a sgraph::ec). Refines with
+             * respect to the half-edges of each color separately, in increasing order of colors, i.e., vertices are
+             * distinguished by the number of neighbours in the color class for each edge color. On directed graphs,
+             * vertices are thus distinguished by their number of in- and out-neighbours in the color class.
+             */
+            template<class split_policy>
+            void refine_color_class_edge_colored(sgraph *g, coloring *c, int color_class, int class_size,
+                                                 split_policy& split_hook) {
+                int *lab = c->lab;
+                int *ptn = c->ptn;
+                int *vertex_to_col = c->vertex_to_col;
+
+                // collect edges to non-singleton cells, grouped by edge color
+                edge_color_hits.clear();
+                for (int cc = color_class; cc < color_class + class_size; ++cc) {
+                    const int vc = lab[cc];
+                    const int end_i = g->v[vc] + g->d[vc];
+                    for (int i = g->v[vc]; i < end_i; ++i) {
+                        const int v = g->e[i];
+                        if (ptn[vertex_to_col[v]] == 0) continue;
+                        edge_color_hits.emplace_back(g->ec[i], v);
+                    }
+                }
+                std::sort(edge_color_hits.begin(), edge_color_hits.end());
+
+                old_color_classes.reset();
+                neighbours.reset();
+                color_vertices_considered.reset();
+
+                if (class_size == 1) {
+                    // every neighbour is hit by a single edge, so all edge colors can be split at once: instead of
+                    // counting, neighbours are distinguished by the rank of their edge color
+                    int rank = 0;
+                    for (size_t pos = 0; pos < edge_color_hits.size(); ++pos) {
+                        rank += (pos > 0 && edge_color_hits[pos].first != edge_color_hits[pos - 1].first);
+                        const int v   = edge_color_hits[pos].second;
+                        const int col = vertex_to_col[v];
+                        neighbours.set(v, rank);
+                        color_vertices_considered.inc_nr(col);
+                        scratch[col + color_vertices_considered.get(col)] = v; // hit vertices
+                        if (color_vertices_considered.get(col) == 0) old_color_classes.push_back(col);
+                    }
+                    split_color_classes_sparse(g, c, split_hook);
+                    return;
+                }
+
+                // count neighbours and split color classes for one edge color at a time
+                size_t pos = 0;
+                while (pos < edge_color_hits.size() && !g_early_out) {
+                    const int edge_color = edge_color_hits[pos].first;
+                    for (; pos < edge_color_hits.size() && edge_color_hits[pos].first == edge_color; ++pos) {
+                        const int v   = edge_color_hits[pos].second;
+                        const int col = vertex_to_col[v];
+                        if (ptn[col] == 0) continue; // became a singleton for a previous edge color
+                        neighbours.inc_nr(v);
+                        if (neighbours.get(v) == 0) {
+                            color_vertices_considered.inc_nr(col);
+                            scratch[col + color_vertices_considered.get(col)] = v; // hit vertices
+                            if (color_vertices_considered.get(col) == 0) old_color_classes.push_back(col);
+                        }
+                    }
+                    split_color_classes_sparse(g, c, split_hook);
+                }
+            }
+
+            /**
+             * Counting phase of the dense refinement methods, using the vectorized kernel of \a h_instruction_set:
+             * counts neighbours of the color class in non-singleton cells, and collects the cells of these neighbours
+             * in `old_color_classes`.
+             */
+            void count_neighbours_non_singleton(sgraph *g, coloring *c, int color_class, int class_size) {
+                const auto collect = simd::collect_non_singleton(h_instruction_set);
+                int* hit_vertices  = neighbour_buffer.get_array();
+                for (int cc = color_class; cc < color_class + class_size; ++cc) {
+                    const int vc   = c->lab[cc];
+                    const int hits = collect(g->e + g->v[vc], g->d[vc], c->vertex_to_col, c->ptn, hit_vertices);
+                    for (int i = 0; i < hits; ++i) {
+                        const int v   = hit_vertices[i];
+                        const int col = c->vertex_to_col[v];
+                        neighbours.inc(v);
+                        if (!scratch_set.get(col)) {
+                            scratch_set.set(col);
+                            old_color_classes.push_back(col);
+                        }
+                    }
+                }
+            }
+
+            template<class split_policy>
+            void refine_color_class_dense(sgraph *g, coloring *c, int color_class, int class_size,
+                                          split_policy& split_hook) {
                 int i, cc, acc, largest_color_class_size, pos;
                 cc = color_class; // iterate over color class
 
@@ -682,6 +1242,10 @@ namespace dejavu {
                 const int end_cc = color_class + class_size;
 
                 // for all vertices of the color class...
+                if (h_instruction_set != simd::is_scalar) {
+                    count_neighbours_non_singleton(g, c, color_class, class_size);
+                    cc = end_cc;
+                }
                 while (cc < end_cc) { // increment value of neighbours of vc by 1
                     const int vc = c->lab[cc];
                     const int pe = g->v[vc];
@@ -700,7 +1264,7 @@ namespace dejavu {
                     cc += 1;
                 }
 
-                old_color_classes.sort();
+                old_color_classes.sort(c->domain_size, h_radix_sort_min);
 
                 // for every cell to be split...
                 while (!old_color_classes.empty()) {
@@ -730,7 +1294,7 @@ namespace dejavu {
 
                     if (vertex_worklist.cur_pos == 1) continue;
 
-                    vertex_worklist.sort();
+                    vertex_worklist.sort(g->v_size + 1, h_radix_sort_min);
                     // enrich neighbour_sizes to accumulative counting array
                     acc = 0;
                     while (!vertex_worklist.empty()) {
@@ -783,7 +1347,7 @@ namespace dejavu {
                     // report splits
                     for (i = col; i < col + col_sz;) {
                         const int i_sz = c->ptn[i] + 1;
-                        report_split_color_class(c, col, i, i_sz, i == largest_color_class);
+                        report_split_color_class(c, col, i, i_sz, i == largest_color_class, split_hook);
                         i += i_sz;
                     }
                 }
@@ -791,7 +1355,9 @@ namespace dejavu {
                 neighbours.reset();
             }
 
-            void refine_color_class_dense_cell(sgraph *g, coloring *c, int color_class, int class_size) {
+            template<class split_policy>
+            void refine_color_class_dense_cell(sgraph *g, coloring *c, int color_class, int class_size,
+                                               split_policy& split_hook) {
                 int i, cc, acc, largest_color_class_size, pos;
                 cc = color_class; // iterate over color class
 
@@ -846,7 +1412,7 @@ namespace dejavu {
 
                     if (vertex_worklist.cur_pos == 1) continue;
 
-                    vertex_worklist.sort();
+                    vertex_worklist.sort(g->v_size + 1, h_radix_sort_min);
                     // enrich neighbour_sizes to accumulative counting array
                     acc = 0;
                     while (!vertex_worklist.empty()) {
@@ -898,7 +1464,7 @@ namespace dejavu {
                     // report splits
                     for (i = col; i < col + col_sz;) {
                         const int i_sz = c->ptn[i] + 1;
-                        report_split_color_class(c, col, i, i_sz, i == largest_color_class);
+                        report_split_color_class(c, col, i, i_sz, i == largest_color_class, split_hook);
                         i += i_sz;
                     }
                 }
@@ -906,7 +1472,44 @@ namespace dejavu {
                 neighbours.reset();
             }
 
-            void refine_color_class_dense_dense(sgraph *g, coloring *c, int color_class, int class_size) {
+            /**
+             * Counting phase of \a refine_color_class_dense_dense, using the bit matrix of \p g: the number of
+             * neighbours of a vertex in the color class is the popcount of its row AND-ed with the color class. As in
+             * the list-based counting, edges of universal vertices are not counted. Only vertices in non-singleton
+             * cells are counted, since only those are inspected afterwards.
+             *
+             * @return degree of the last vertex of the color class
+             */
+            int count_neighbours_bit_matrix(sgraph *g, coloring *c, int color_class, int class_size) {
+                const int words = adjacency.row_words();
+                cell_bits.assign(words, 0);
+                int deg = -1;
+                for (int cc = color_class; cc < color_class + class_size; ++cc) {
+                    const int vc = c->lab[cc];
+                    deg = g->d[vc];
+                    if (deg == g->v_size - 1) continue; // special code for universal vertices
+                    cell_bits[vc >> 6] |= uint64_t(1) << (vc & 63);
+                }
+
+                for (int col = 0; col < g->v_size;) {
+                    const int col_sz = c->ptn[col] + 1;
+                    if (col_sz > 1) {
+                        for (int i = col; i < col + col_sz; ++i) {
+                            const int v = c->lab[i];
+                            const uint64_t* row = adjacency.row(v);
+                            int count = 0;
+                            for (int w = 0; w < words; ++w) count += __builtin_popcountll(row[w] & cell_bits[w]);
+                            neighbours.set(v, count - 1);
+                        }
+                    }
+                    col += col_sz;
+                }
+                return deg;
+            }
+
+            template<class split_policy>
+            void refine_color_class_dense_dense(sgraph *g, coloring *c, int color_class, int class_size,
+                                                split_policy& split_hook) {
                 int i, j, acc, cc, largest_color_class_size;
                 int deg = -1;
                 cc = color_class; // iterate over color class
@@ -914,6 +1517,11 @@ namespace dejavu {
                 neighbours.reset();
 
                 const int end_cc = color_class + class_size;
+                if (has_bit_matrix(g) && static_cast<long>(class_size) * g->d[c->lab[color_class]] >
+                                         static_cast<long>(g->v_size) * adjacency.row_words()) {
+                    deg = count_neighbours_bit_matrix(g, c, color_class, class_size);
+                    cc  = end_cc;
+                }
                 while (cc < end_cc) { // increment value of neighbours of vc by 1
                     const int vc = c->lab[cc];
                     const int pe = g->v[vc];
@@ -957,7 +1565,7 @@ namespace dejavu {
 
                     if (vertex_worklist.cur_pos == 1) continue; // no split
 
-                    vertex_worklist.sort();
+                    vertex_worklist.sort(g->v_size + 1, h_radix_sort_min);
                     // enrich neighbour_sizes to accumulative counting array
                     acc = 0;
                     while (!vertex_worklist.empty()) {
@@ -1013,7 +1621,7 @@ namespace dejavu {
                     // report splits
                     for (i = col; i < col + col_sz;) {
                         const int i_sz = c->ptn[i] + 1;
-                        report_split_color_class(c, col, i, i_sz, i == largest_color_class);
+                        report_split_color_class(c, col, i, i_sz, i == largest_color_class, split_hook);
                         i += i_sz;
                     }
                 }
@@ -1021,7 +1629,9 @@ namespace dejavu {
                 neighbours.reset_hard();
             }
 
-            void __attribute__((noinline)) refine_color_class_singleton(sgraph *g, coloring *c, int color_class) {
+            template<class split_policy>
+            void __attribute__((noinline)) refine_color_class_singleton(sgraph *g, coloring *c, int color_class,
+                                                                        split_policy& split_hook) {
                 int i, cc, deg1_write_pos, deg1_read_pos;
                 cc = color_class; // iterate over color class
 
@@ -1053,7 +1663,7 @@ namespace dejavu {
                     neighbours.inc_nr(col); // we reset neighbours later, use old_color_classes for reset
                 }
 
-                old_color_classes.sort();
+                old_color_classes.sort(c->domain_size, h_radix_sort_min);
 
                 for(int j = 0; j < old_color_classes.cur_pos; ++j) {
                     const int deg0_col = old_color_classes[j];
@@ -1111,8 +1721,8 @@ namespace dejavu {
                     report_splits->push_back(std::pair<std::pair<int, int>, bool>(
                             std::pair<int, int>(deg0_col, deg1_col), leq));*/
 
-                    report_split_color_class(c, deg0_col, deg0_col, deg0_col_sz, !leq);
-                    report_split_color_class(c, deg0_col, deg1_col, deg1_col_sz, leq);
+                    report_split_color_class(c, deg0_col, deg0_col, deg0_col_sz, !leq, split_hook);
+                    report_split_color_class(c, deg0_col, deg1_col, deg1_col_sz, leq, split_hook);
 
                     // reset neighbours count to -1
                     neighbours.set(deg0_col, -1);
@@ -1215,6 +1825,10 @@ namespace dejavu {
                 old_color_classes.reset();
 
                 const int end_cc = color_class + class_size;
+                if (h_instruction_set != simd::is_scalar) {
+                    count_neighbours_non_singleton(g, c, color_class, class_size);
+                    cc = end_cc;
+                }
                 while (cc < end_cc) { // increment value of neighbours of vc by 1
                     const int vc = c->lab[cc];
                     const int pe = g->v[vc];
@@ -1432,6 +2046,90 @@ namespace dejavu {
                 neighbours.reset_hard();
             }
 
+            /**
+             * Counting phase of \a refine_color_class_sparse_first, using \a h_threads threads. The color class is
+             * split into contiguous blocks of vertices, each of which is scanned by one thread.
+             *
+             * Leaves `neighbours`, `scratch`, `color_vertices_considered` and `old_color_classes` in the same state as
+             * the sequential scan: each thread records the position of the first edge hitting a vertex in the overall
+             * scan order, and hit vertices are then collected in the order of these positions. Hence, the resulting
+             * coloring is the same for any number of threads.
+             */
+            void count_neighbours_parallel(sgraph *g, coloring *c, int color_class, int class_size) {
+                if(parallel_domain_size < g->v_size) {
+                    parallel_count     = std::make_unique<std::atomic<int>[]>(g->v_size);
+                    parallel_first_hit = std::make_unique<std::atomic<int>[]>(g->v_size);
+                    for(int v = 0; v < g->v_size; ++v) {
+                        parallel_count[v].store(0, std::memory_order_relaxed);
+                        parallel_first_hit[v].store(INT32_MAX, std::memory_order_relaxed);
+                    }
+                    parallel_domain_size = g->v_size;
+                }
+
+                const int threads = std::min(h_threads, class_size);
+                const int block   = (class_size + threads - 1) / threads;
+                parallel_hits.resize(threads);
+
+                // position of the first edge of each block in the overall scan order
+                std::vector<int> block_start(threads + 1, 0);
+                parallel_for(threads, 0, threads, [&](const int t) {
+                    const int block_end = std::min(color_class + (t + 1) * block, color_class + class_size);
+                    int degree_sum = 0;
+                    for(int cc = color_class + t * block; cc < block_end; ++cc) degree_sum += g->d[c->lab[cc]];
+                    block_start[t + 1] = degree_sum;
+                });
+                for(int t = 0; t < threads; ++t) block_start[t + 1] += block_start[t];
+
+                // counts neighbours, and determines which edge hits each vertex first
+                parallel_for(threads, 0, threads, [&](const int t) {
+                    const int block_end = std::min(color_class + (t + 1) * block, color_class + class_size);
+                    int pos = block_start[t];
+                    for(int cc = color_class + t * block; cc < block_end; ++cc) {
+                        const int vc = c->lab[cc];
+                        for(int i = g->v[vc]; i < g->v[vc] + g->d[vc]; ++i, ++pos) {
+                            const int v = g->e[i];
+                            if(c->ptn[c->vertex_to_col[v]] == 0) continue;
+                            parallel_count[v].fetch_add(1, std::memory_order_relaxed);
+                            int first_hit = parallel_first_hit[v].load(std::memory_order_relaxed);
+                            while(pos < first_hit && !parallel_first_hit[v].compare_exchange_weak(first_hit, pos,
+                                                                              std::memory_order_relaxed)) {}
+                        }
+                    }
+                });
+
+                // collects hit vertices of each block, in the order they were first hit
+                parallel_for(threads, 0, threads, [&](const int t) {
+                    const int block_end = std::min(color_class + (t + 1) * block, color_class + class_size);
+                    auto& hits = parallel_hits[t];
+                    hits.clear();
+                    int pos = block_start[t];
+                    for(int cc = color_class + t * block; cc < block_end; ++cc) {
+                        const int vc = c->lab[cc];
+                        for(int i = g->v[vc]; i < g->v[vc] + g->d[vc]; ++i, ++pos) {
+                            const int v = g->e[i];
+                            if(parallel_first_hit[v].load(std::memory_order_relaxed) == pos) hits.push_back(v);
+                        }
+                    }
+                });
+
+                for(int t = 0; t < threads; ++t) {
+                    for(const int v : parallel_hits[t]) {
+                        const int col = c->vertex_to_col[v];
+                        neighbours.set(v, parallel_count[v].load(std::memory_order_relaxed) - 1);
+                        parallel_count[v].store(0, std::memory_order_relaxed);
+                        parallel_first_hit[v].store(INT32_MAX, std::memory_order_relaxed);
+
+                        color_vertices_considered.inc_nr(col);
+                        assert(col + color_vertices_considered.get(col) < g->v_size);
+                        scratch[col + color_vertices_considered.get(col)] = v; // hit vertices
+                        if (!scratch_set.get(col)) {
+                            old_color_classes.push_back(col);
+                            scratch_set.set(col);
+                        }
+                    }
+                }
+            }
+
             void refine_color_class_sparse_first(sgraph *g, coloring *c, int color_class, int class_size) {
                 int v_new_color, cc, largest_color_class_size, acc;
                 cc = color_class; // iterate over color class
@@ -1442,6 +2140,12 @@ namespace dejavu {
                 color_vertices_considered.reset();
 
                 const int end_cc = color_class + class_size;
+                const bool use_threads = h_threads > 1 && g->v_size > 0 &&
+                        static_cast<long>(class_size) * (g->e_size / g->v_size) >= h_parallel_min_edges;
+                if (use_threads) {
+                    count_neighbours_parallel(g, c, color_class, class_size);
+                    cc = end_cc;
+                }
                 while (cc < end_cc) { // increment value of neighbours of vc by 1
                     const int vc = c->lab[cc];
                     const int pe = g->v[vc];
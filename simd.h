@@ -0,0 +1,148 @@
+// Copyright 2023 Markus Anders
+// This file is part of dejavu 2.0.
+// See LICENSE for extended copyright information.
+
+#ifndef DEJAVU_SIMD_H
+#define DEJAVU_SIMD_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DEJAVU_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace dejavu {
+
+    /**
+     * \brief Vectorized kernels for color refinement.
+     *
+     * Kernels come in a scalar variant, as well as AVX2 and AVX-512 variants. The vectorized variants are compiled for
+     * their respective instruction set regardless of compiler flags, and \a select_instruction_set determines at
+     * runtime which variant is used.
+     */
+    namespace simd {
+
+        enum instruction_set { is_scalar, is_avx2, is_avx512 };
+
+        /**
+         * @return the best instruction set supported by the CPU we are running on
+         */
+        inline instruction_set detect_instruction_set() {
+#ifdef DEJAVU_SIMD_X86
+            __builtin_cpu_init();
+            if(__builtin_cpu_supports("avx512f")) return is_avx512;
+            if(__builtin_cpu_supports("avx2"))    return is_avx2;
+#endif
+            return is_scalar;
+        }
+
+        /**
+         * Collects the vertices of \p e which are not contained in a singleton cell.
+         *
+         * @param e vertices (e.g., an adjacency list)
+         * @param len length of \p e
+         * @param vertex_to_col color of each vertex
+         * @param ptn partition array of the coloring
+         * @param out array of at least \p len elements, to which the vertices are written in the order of \p e
+         * @return number of vertices written to \p out
+         */
+        inline int collect_non_singleton_scalar(const int* e, const int len, const int* vertex_to_col, const int* ptn,
+                                                int* out) {
+            int hits = 0;
+            for(int i = 0; i < len; ++i) {
+                const int v = e[i];
+                out[hits] = v;
+                hits += (ptn[vertex_to_col[v]] > 0);
+            }
+            return hits;
+        }
+
+#ifdef DEJAVU_SIMD_X86
+        /**
+         * Permutations which move the lanes selected by an 8-bit mask to the front, used to compress vectors in AVX2.
+         */
+        struct avx2_compress_table {
+            alignas(32) int perm[256][8];
+            avx2_compress_table() {
+                for(int mask = 0; mask < 256; ++mask) {
+                    int pos = 0;
+                    for(int lane = 0; lane < 8; ++lane) if((mask >> lane) & 1) perm[mask][pos++] = lane;
+                    while(pos < 8) perm[mask][pos++] = 0;
+                }
+            }
+        };
+
+        /**
+         * AVX2 variant of \a collect_non_singleton_scalar.
+         */
+        __attribute__((target("avx2")))
+        inline int collect_non_singleton_avx2(const int* e, const int len, const int* vertex_to_col, const int* ptn,
+                                              int* out) {
+            static const avx2_compress_table table;
+            const __m256i zero = _mm256_setzero_si256();
+            int hits = 0;
+            int i = 0;
+            for(; i + 8 <= len; i += 8) {
+                const __m256i vertices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(e + i));
+                const __m256i colors   = _mm256_i32gather_epi32(vertex_to_col, vertices, 4);
+                const __m256i col_ptn  = _mm256_i32gather_epi32(ptn, colors, 4);
+                const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(col_ptn, zero)));
+                const __m256i perm = _mm256_load_si256(reinterpret_cast<const __m256i*>(table.perm[mask]));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + hits), _mm256_permutevar8x32_epi32(vertices, perm));
+                hits += __builtin_popcount(mask);
+            }
+            return hits + collect_non_singleton_scalar(e + i, len - i, vertex_to_col, ptn, out + hits);
+        }
+
+        /**
+         * AVX-512 variant of \a collect_non_singleton_scalar.
+         */
+        __attribute__((target("avx512f")))
+        inline int collect_non_singleton_avx512(const int* e, const int len, const int* vertex_to_col, const int* ptn,
+                                                int* out) {
+            const __m512i zero = _mm512_setzero_si512();
+            int hits = 0;
+            int i = 0;
+            for(; i + 16 <= len; i += 16) {
+                const __m512i vertices = _mm512_loadu_si512(e + i);
+                const __m512i colors   = _mm512_mask_i32gather_epi32(zero, 0xFFFF, vertices, vertex_to_col, 4);
+                const __m512i col_ptn  = _mm512_mask_i32gather_epi32(zero, 0xFFFF, colors, ptn, 4);
+                const __mmask16 mask   = _mm512_cmpgt_epi32_mask(col_ptn, zero);
+                _mm512_mask_compressstoreu_epi32(out + hits, mask, vertices);
+                hits += __builtin_popcount(mask);
+            }
+            return hits + collect_non_singleton_scalar(e + i, len - i, vertex_to_col, ptn, out + hits);
+        }
+#endif
+
+        typedef int collect_non_singleton_kernel(const int*, int, const int*, const int*, int*);
+
+        /**
+         * @param set instruction set
+         * @return variant of \a collect_non_singleton_scalar for the given instruction set
+         */
+        inline collect_non_singleton_kernel* collect_non_singleton(const instruction_set set) {
+#ifdef DEJAVU_SIMD_X86
+            switch(set) {
+                case is_avx512: return collect_non_singleton_avx512;
+                case is_avx2:   return collect_non_singleton_avx2;
+                default: break;
+            }
+#endif
+            return collect_non_singleton_scalar;
+        }
+
+        /**
+         * Determines the instruction set used by color refinement by default, once at runtime. The AVX2 kernels are
+         * only used if requested explicitly: gathers are slow on many AVX2 CPUs, and in benchmarks the AVX2 kernels
+         * did not outperform the scalar ones (see benchmarks/refinement_benchmark.cpp).
+         *
+         * @return the instruction set used by color refinement
+         */
+        inline instruction_set select_instruction_set() {
+            static const instruction_set set = detect_instruction_set() == is_avx512 ? is_avx512 : is_scalar;
+            return set;
+        }
+    }
+}
+
+#endif //DEJAVU_SIMD_H
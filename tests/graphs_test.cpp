@@ -186,4 +186,90 @@ TEST(graphs_test, graph_suite_ref) {
     test_graph_orbit_check(directory + "ransq_1000_a.bliss");
     test_graph_orbit_check(directory + "ran10_500_a.bliss");
     test_graph_orbit_check(directory + "ran2_200_a.bliss");
-}
\ No newline at end of file
+}
+
+TEST(graphs_test, cnf) {
+    // pigeonhole formula with 6 pigeons and 5 holes: symmetric group on pigeons times symmetric group on holes
+    const int pigeons = 6, holes = 5;
+    const auto var = [](int pigeon, int hole) { return pigeon * holes + hole + 1; };
+    const std::string filename = (std::filesystem::temp_directory_path() / "dejavu_php_6_5.cnf").string();
+    {
+        std::ofstream cnf(filename);
+        cnf << "c pigeonhole\np cnf " << pigeons * holes << " " << pigeons + holes * pigeons * (pigeons - 1) / 2
+            << std::endl;
+        for(int i = 0; i < pigeons; ++i) {
+            for(int j = 0; j < holes; ++j) cnf << var(i, j) << " ";
+            cnf << "0" << std::endl;
+        }
+        for(int j = 0; j < holes; ++j)
+            for(int a = 0; a < pigeons; ++a)
+                for(int b = a + 1; b < pigeons; ++b) cnf << -var(a, j) << " " << -var(b, j) << " 0" << std::endl;
+    }
+    EXPECT_TRUE(is_dimacs_cnf(filename));
+
+    dejavu::sgraph g;
+    int* colmap = nullptr;
+    const int variables = parse_dimacs_cnf(filename, &g, &colmap);
+    std::filesystem::remove(filename);
+    EXPECT_EQ(variables, pigeons * holes);
+    EXPECT_EQ(g.v_size, 2 * variables + pigeons + holes * pigeons * (pigeons - 1) / 2);
+    g.sanity_check();
+
+    // symmetries must map negated literals to negated literals
+    std::stringstream literal_output;
+    dejavu::hooks::literal_ostream_hook literal_hook(literal_output, variables);
+    auto test_hook = dejavu_hook([&](int n, const int *p, int nsupp, const int *supp) {
+        for(int l = 0; l < 2 * variables; ++l) EXPECT_EQ(p[l ^ 1], p[l] ^ 1);
+        (*literal_hook.get_hook())(n, p, nsupp, supp);
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.automorphisms(&g, colmap, &test_hook);
+    free(colmap);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 4);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 8.64, 0.001); // 6! * 5!
+    EXPECT_EQ(literal_output.str()[0], '(');
+
+    // invalid formulas are rejected
+    for(const std::string formula : {"p cnf 2 1\n1 -3 0\n", "1 2 0\n", "p dnf 2 1\n1 2 0\n"}) {
+        {
+            std::ofstream cnf(filename);
+            cnf << formula;
+        }
+        dejavu::sgraph invalid;
+        int* invalid_colmap = nullptr;
+        EXPECT_EQ(parse_dimacs_cnf(filename, &invalid, &invalid_colmap), -1);
+        EXPECT_EQ(invalid_colmap, nullptr);
+    }
+    std::filesystem::remove(filename);
+    EXPECT_EQ(parse_dimacs_cnf(filename, &g, &colmap), -1);
+}
+
+TEST(graphs_test, dimacs_arcs) {
+    // arcs in both directions between two vertices form a single edge
+    const std::string filename = (std::filesystem::temp_directory_path() / "dejavu_arcs.dimacs").string();
+    {
+        std::ofstream dimacs(filename);
+        dimacs << "p edge 3 3\na 1 2\na 2 1\na 2 3\n";
+    }
+    dejavu::sgraph g;
+    int* colmap = nullptr;
+    EXPECT_TRUE(parse_dimacs(filename, &g, &colmap));
+    EXPECT_EQ(g.v_size, 3);
+    EXPECT_EQ(g.e_size, 4);
+    ASSERT_NE(g.ec, nullptr);
+    EXPECT_EQ(g.ec[g.v[0]], dejavu::sgraph::arc_both);
+
+    // an arc given twice, or an arc and an edge between the same vertices, are rejected
+    for(const std::string duplicate : {"a 1 2\na 1 2\n", "e 1 2\na 2 1\n"}) {
+        {
+            std::ofstream dimacs(filename);
+            dimacs << "p edge 2 2\n" << duplicate;
+        }
+        dejavu::sgraph invalid;
+        int* invalid_colmap = nullptr;
+        EXPECT_FALSE(parse_dimacs(filename, &invalid, &invalid_colmap));
+    }
+    std::filesystem::remove(filename);
+}
@@ -10,13 +10,52 @@
 
 extern      dejavu::ir::refinement* dgtest_test_r;
 extern      dejavu::sgraph*         dgtest_graph;
-extern int* dgtest_col;
 
-static void gtest_certify_hook([[maybe_unused]] int n, [[maybe_unused]] const int *p, [[maybe_unused]] int nsupp,
-                      [[maybe_unused]] const int *supp) {
+[[maybe_unused]] static void gtest_certify_hook([[maybe_unused]] int n, [[maybe_unused]] const int *p,
+                                                [[maybe_unused]] int nsupp, [[maybe_unused]] const int *supp) {
     EXPECT_TRUE(dgtest_test_r->certify_automorphism_sparse(dgtest_graph, p, nsupp, supp));
-    EXPECT_TRUE(dgtest_test_r->certify_automorphism(dgtest_graph, dgtest_col, p));
-    EXPECT_TRUE(dgtest_test_r->certify_automorphism_sparse(dgtest_graph, dgtest_col, p, nsupp, supp));
+    EXPECT_TRUE(dgtest_test_r->certify_automorphism(dgtest_graph, p));
+}
+
+/**
+ * Constructs the k x k torus, i.e., the grid graph where the last row and column wrap around.
+ *
+ * @param g the graph to initialize
+ * @param k side length of the torus
+ * @param pendant whether a pendant vertex is attached to vertex 0, which breaks the vertex-transitivity
+ */
+[[maybe_unused]] static void make_torus(dejavu::static_graph& g, int k, bool pendant = false) {
+    g.initialize_graph(k * k + pendant, 2 * k * k + pendant);
+    for(int v = 0; v < k * k; ++v) g.add_vertex(0, (pendant && v == 0) ? 5 : 4);
+    if(pendant) g.add_vertex(0, 1);
+    for(int i = 0; i < k; ++i) {
+        for(int j = 0; j < k; ++j) {
+            const int v = i * k + j, right = i * k + (j + 1) % k, down = ((i + 1) % k) * k + j;
+            g.add_edge(std::min(v, right), std::max(v, right));
+            g.add_edge(std::min(v, down), std::max(v, down));
+        }
+    }
+    if(pendant) g.add_edge(0, k * k);
+}
+
+/**
+ * Saves the current state of \p state to \p root, walks to a leaf by always individualizing the last vertex of the
+ * last cell, and makes this walk the one \p state compares to. Leaves \p state in irreversible mode.
+ *
+ * @return the base of the walk
+ */
+[[maybe_unused]] static std::vector<int> walk_last_cell_base(dejavu::sgraph* g, dejavu::ir::controller& state,
+                                                             dejavu::ir::limited_save& root) {
+    state.save_reduced_state(root);
+    state.mode_write_base();
+    std::vector<int> base;
+    while(state.c->cells != g->v_size) {
+        base.push_back(state.c->lab[state.c->cells - 1]);
+        state.move_to_child(g, base.back());
+    }
+    state.compare_to_this();
+    state.use_reversible(false);
+    return base;
 }
 
 #endif //DEJAVU_HELPER_FUNCTIONS_TEST_H
@@ -3,6 +3,9 @@
 // See LICENSE for extended copyright information.
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <thread>
 #include "../ds.h"
 
 using dejavu::ds::markset;
@@ -66,4 +69,96 @@ TEST(markset_test, many_resets) {
         EXPECT_EQ(m.get(1), true);
         m.reset();
     }
-}
\ No newline at end of file
+}
+TEST(worklist_test, radix_sort) {
+    std::mt19937 rng(1);
+    for(const int bound : {1, 2, 255, 256, 257, 70000, 1 << 24, INT32_MAX}) {
+        for(const int sz : {0, 1, 5, 300, 2000}) {
+            dejavu::ds::worklist arr(sz);
+            std::vector<int> expected;
+            for(int i = 0; i < sz; ++i) {
+                const int k = static_cast<int>(rng() % bound);
+                arr.push_back(k);
+                expected.push_back(k);
+            }
+            std::sort(expected.begin(), expected.end());
+            arr.sort(bound, 0);
+            for(int i = 0; i < sz; ++i) EXPECT_EQ(arr[i], expected[i]);
+        }
+    }
+}
+
+TEST(arena_test, create_and_clear) {
+    static int destroyed = 0;
+    struct counted {
+        std::vector<int> data;
+        explicit counted(int n) : data(n, n) {}
+        ~counted() { ++destroyed; }
+    };
+
+    dejavu::ds::arena<counted> objects;
+    std::vector<counted*> created;
+    for(int i = 0; i < 1000; ++i) created.push_back(objects.create(i % 7));
+    EXPECT_EQ(objects.size(), 1000);
+    EXPECT_GE(objects.memory(), static_cast<long>(1000 * sizeof(counted)));
+
+    // objects keep their address and contents while the arena grows
+    for(int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(static_cast<int>(created[i]->data.size()), i % 7);
+    }
+
+    objects.clear();
+    EXPECT_EQ(destroyed, 1000);
+    EXPECT_EQ(objects.size(), 0);
+    EXPECT_EQ(objects.memory(), 0);
+
+    dejavu::ds::arena<int> ints;
+    int* small = ints.allocate(10);
+    int* large = ints.allocate(100000);
+    for(int i = 0; i < 10; ++i) small[i] = i;
+    for(int i = 0; i < 100000; ++i) large[i] = -i;
+    for(int i = 0; i < 10; ++i) EXPECT_EQ(small[i], i);
+    EXPECT_EQ(large[99999], -99999);
+    EXPECT_EQ(ints.size(), 100010);
+}
+
+TEST(hash_table_test, insert_and_find) {
+    dejavu::ds::hash_table<int> table;
+    std::vector<int> values(5000);
+    std::mt19937_64 rng(3);
+    std::vector<uint64_t> keys;
+    for(int i = 0; i < 5000; ++i) {
+        // consecutive keys, as used to resolve collisions of leaf hashes
+        const uint64_t key = (i % 4 == 0) ? rng() : keys.back() + 1;
+        keys.push_back(key);
+        EXPECT_TRUE(table.insert(key, &values[i]));
+        EXPECT_FALSE(table.insert(key, &values[0]));
+    }
+    EXPECT_EQ(table.size(), 5000);
+    for(int i = 0; i < 5000; ++i) EXPECT_EQ(table.find(keys[i]), &values[i]);
+    EXPECT_EQ(table.find(keys[0] ^ 0xF0F0F0F0F0F0F0F0ULL), nullptr);
+
+    table.clear();
+    EXPECT_EQ(table.size(), 0);
+    EXPECT_EQ(table.find(keys[0]), nullptr);
+}
+
+TEST(hash_table_test, concurrent_insert) {
+    dejavu::ds::hash_table<int> table;
+    int value = 0;
+    const int per_thread = 20000;
+    std::vector<std::thread> threads;
+    std::atomic<int> inserted = 0;
+    for(int t = 0; t < 4; ++t) {
+        threads.emplace_back([&table, &value, &inserted]() {
+            // all threads insert the same keys, each key must be inserted exactly once
+            for(int i = 0; i < per_thread; ++i) {
+                if(table.insert(0x9E3779B97F4A7C15ULL * (i + 1), &value)) ++inserted;
+                EXPECT_EQ(table.find(0x9E3779B97F4A7C15ULL * (i + 1)), &value);
+            }
+        });
+    }
+    for(auto& t : threads) t.join();
+    EXPECT_EQ(inserted, per_thread);
+    EXPECT_EQ(table.size(), per_thread);
+}
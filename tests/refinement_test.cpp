@@ -3,7 +3,9 @@
 // See LICENSE for extended copyright information.
 
 #include "gtest/gtest.h"
+#include <filesystem>
 #include "../dejavu.h"
+#include "helper_functions_test.h"
 
 using dejavu::ir::refinement;
 using dejavu::ds::coloring;
@@ -326,4 +328,879 @@ TEST(refinement_test, certify_test2) {
 
     ASSERT_NE(c.vertex_to_col[0], c.vertex_to_col[3]);
     ASSERT_NE(c.vertex_to_col[1], c.vertex_to_col[2]);
-}
\ No newline at end of file
+}
+
+TEST(refinement_test, threads_first_deterministic) {
+    // random graph with varying degrees, large enough to count neighbours in parallel
+    const int nv = 50000;
+    std::mt19937 rng(3);
+    std::set<std::pair<int, int>> edges;
+    while(edges.size() < 250000) {
+        const int v1 = static_cast<int>(rng() % nv);
+        const int v2 = static_cast<int>(rng() % nv);
+        if(v1 != v2) edges.insert({std::min(v1, v2), std::max(v1, v2)});
+    }
+    std::vector<int> degree(nv, 0);
+    for(auto& [v1, v2] : edges) {
+        ++degree[v1];
+        ++degree[v2];
+    }
+
+    dejavu::static_graph g1;
+    g1.initialize_graph(nv, static_cast<int>(edges.size()));
+    for(int v = 0; v < nv; ++v) g1.add_vertex(0, degree[v]);
+    for(auto& [v1, v2] : edges) g1.add_edge(v1, v2);
+
+    // sequential, multi-threaded, and multi-threaded for all color classes
+    std::vector<int> lab[3], ptn[3];
+    for(int run = 0; run < 3; ++run) {
+        refinement R;
+        R.h_threads = run == 0 ? 1 : 4;
+        if(run == 2) R.h_parallel_min_edges = 0;
+        coloring c;
+        g1.get_sgraph()->initialize_coloring(&c, g1.get_coloring());
+        R.refine_coloring_first(g1.get_sgraph(), &c);
+        c.check();
+        lab[run].assign(c.lab, c.lab + nv);
+        ptn[run].assign(c.ptn, c.ptn + nv);
+    }
+
+    EXPECT_EQ(lab[0], lab[1]);
+    EXPECT_EQ(ptn[0], ptn[1]);
+    EXPECT_EQ(lab[0], lab[2]);
+    EXPECT_EQ(ptn[0], ptn[2]);
+}
+
+
+TEST(refinement_test, simd_kernels) {
+    const int nv = 1000;
+    std::mt19937 rng(5);
+    std::vector<int> vertex_to_col(nv), ptn(nv, 0), e(nv);
+    for(int v = 0; v < nv; ++v) {
+        vertex_to_col[v] = static_cast<int>(rng() % nv);
+        ptn[v] = static_cast<int>(rng() % 3);
+        e[v] = static_cast<int>(rng() % nv);
+    }
+
+    // vectorized kernels agree with the scalar kernel
+    const auto supported = dejavu::simd::detect_instruction_set();
+    for(const auto set : {dejavu::simd::is_avx2, dejavu::simd::is_avx512}) {
+        if(set > supported) continue;
+        for(const int len : {0, 7, 16, 33, nv}) {
+            std::vector<int> out(nv);
+            const int hits = dejavu::simd::collect_non_singleton(set)(e.data(), len, vertex_to_col.data(), ptn.data(),
+                                                                      out.data());
+            std::vector<int> scalar_out(nv);
+            const int scalar_hits = dejavu::simd::collect_non_singleton_scalar(e.data(), len, vertex_to_col.data(),
+                                                                               ptn.data(), scalar_out.data());
+            ASSERT_EQ(hits, scalar_hits);
+            for(int i = 0; i < hits; ++i) EXPECT_EQ(out[i], scalar_out[i]);
+        }
+    }
+
+    // dense refinement gives the same coloring with and without vectorized kernels
+    dejavu::static_graph g1;
+    const int n = 2001;
+    std::vector<int> connection;
+    for(int d = 1; d <= n / 2; ++d) if((d * d) % 97 < 3) connection.push_back(d);
+    std::vector<std::pair<int, int>> edges;
+    for(int v = 0; v < n; ++v) {
+        for(const int d : connection) edges.emplace_back(std::min(v, (v + d) % n), std::max(v, (v + d) % n));
+    }
+    std::vector<int> degree(n, 0);
+    for(auto& [v1, v2] : edges) {
+        ++degree[v1];
+        ++degree[v2];
+    }
+    g1.initialize_graph(n, static_cast<int>(edges.size()));
+    for(int v = 0; v < n; ++v) g1.add_vertex(0, degree[v]);
+    for(auto& [v1, v2] : edges) g1.add_edge(v1, v2);
+    auto g = g1.get_sgraph();
+    g->dense = true;
+
+    std::vector<int> lab[2];
+    for(int run = 0; run < 2; ++run) {
+        refinement R;
+        R.h_instruction_set = run == 0 ? dejavu::simd::is_scalar : supported;
+        coloring c;
+        g->initialize_coloring(&c, g1.get_coloring());
+        R.refine_coloring_first(g, &c);
+        for(int v = 0; v < 3; ++v) {
+            if(c.ptn[c.vertex_to_col[v]] == 0) continue;
+            const int col = R.individualize_vertex(&c, v);
+            R.refine_coloring(g, &c, col);
+        }
+        c.check();
+        EXPECT_GT(c.cells, 3);
+        lab[run].assign(c.lab, c.lab + n);
+    }
+    EXPECT_EQ(lab[0], lab[1]);
+}
+
+
+TEST(refinement_test, bit_matrix) {
+    // circulant graph of density 1/2
+    const int n = 401;
+    std::vector<std::pair<int, int>> edges;
+    for(int v = 0; v < n; ++v) {
+        for(int d = 1; d <= n / 2; ++d) {
+            if((d * d) % 13 < 6) edges.emplace_back(std::min(v, (v + d) % n), std::max(v, (v + d) % n));
+        }
+    }
+    std::vector<int> degree(n, 0);
+    for(auto& [v1, v2] : edges) {
+        ++degree[v1];
+        ++degree[v2];
+    }
+    dejavu::static_graph g1;
+    g1.initialize_graph(n, static_cast<int>(edges.size()));
+    for(int v = 0; v < n; ++v) g1.add_vertex(0, degree[v]);
+    for(auto& [v1, v2] : edges) g1.add_edge(v1, v2);
+    auto g = g1.get_sgraph();
+    g->dense = true;
+
+    std::vector<int> lab[2];
+    for(int run = 0; run < 2; ++run) {
+        refinement R;
+        if(run == 1) {
+            EXPECT_TRUE(R.build_bit_matrix(g));
+        }
+        coloring c;
+        g->initialize_coloring(&c, g1.get_coloring());
+        R.refine_coloring_first(g, &c);
+        const int col = R.individualize_vertex(&c, 0);
+        R.refine_coloring(g, &c, col);
+        c.check();
+        EXPECT_GT(c.cells, 2);
+        lab[run].assign(c.lab, c.lab + n);
+
+        // rotation is an automorphism, swapping two vertices is not
+        std::vector<int> p(n);
+        for(int v = 0; v < n; ++v) p[v] = (v + 1) % n;
+        EXPECT_TRUE(R.certify_automorphism(g, p.data()));
+        for(int v = 0; v < n; ++v) p[v] = v;
+        p[0] = 2;
+        p[2] = 0;
+        const int supp[2] = {0, 2};
+        EXPECT_FALSE(R.certify_automorphism(g, p.data()));
+        EXPECT_FALSE(R.certify_automorphism_sparse(g, p.data(), 2, supp));
+    }
+    EXPECT_EQ(lab[0], lab[1]);
+}
+
+TEST(refinement_test, hook_policies) {
+    // cycle with a chord
+    const int n = 64;
+    dejavu::static_graph g1;
+    g1.initialize_graph(n, n + 1);
+    for(int v = 0; v < n; ++v) g1.add_vertex(0, (v == 0 || v == n / 2) ? 3 : 2);
+    for(int v = 0; v < n; ++v) g1.add_edge(std::min(v, (v + 1) % n), std::max(v, (v + 1) % n));
+    g1.add_edge(0, n / 2);
+    auto g = g1.get_sgraph();
+
+    struct counting_hook {
+        int splits = 0;
+        int cells  = 0;
+        bool operator()(const int, const int, const int) { ++splits; return true; }
+        bool operator()(const int, const int) { ++cells; return true; }
+    };
+
+    // policies and std::function hooks see the same calls, and lead to the same coloring
+    counting_hook policy;
+    int function_splits = 0;
+    int function_cells  = 0;
+    std::function<dejavu::ir::type_split_color_hook> split_hook = [&](const int, const int, const int) {
+        ++function_splits;
+        return true;
+    };
+    std::function<dejavu::ir::type_worklist_color_hook> worklist_hook = [&](const int, const int) {
+        ++function_cells;
+        return true;
+    };
+
+    std::vector<int> lab[3];
+    for(int run = 0; run < 3; ++run) {
+        refinement R;
+        coloring c;
+        g->initialize_coloring(&c, g1.get_coloring());
+        R.refine_coloring_first(g, &c);
+        if(run == 0) {
+            const int col = refinement::individualize_vertex(&c, 1, policy);
+            R.refine_coloring(g, &c, col, -1, policy, policy);
+        } else if(run == 1) {
+            const int col = refinement::individualize_vertex(&c, 1, split_hook);
+            R.refine_coloring(g, &c, col, -1, &split_hook, worklist_hook);
+        } else {
+            const int col = R.individualize_vertex(&c, 1);
+            R.refine_coloring(g, &c, col);
+        }
+        c.check();
+        EXPECT_EQ(c.cells, n);
+        lab[run].assign(c.lab, c.lab + n);
+    }
+    EXPECT_GT(policy.splits, 2);
+    EXPECT_EQ(policy.splits, function_splits);
+    EXPECT_EQ(policy.cells, function_cells);
+    EXPECT_EQ(lab[0], lab[1]);
+    EXPECT_EQ(lab[0], lab[2]);
+
+    // the split hook can stop refinement early
+    struct stopping_hook {
+        bool operator()(const int, const int, const int) const { return false; }
+        bool operator()(const int, const int) const { return true; }
+    } stop;
+    refinement R;
+    coloring c;
+    g->initialize_coloring(&c, g1.get_coloring());
+    R.refine_coloring_first(g, &c);
+    const int col = R.individualize_vertex(&c, 1);
+    R.refine_coloring(g, &c, col, -1, stop, stop);
+    c.check();
+    EXPECT_LT(c.cells, n);
+}
+
+TEST(refinement_test, profile) {
+    dejavu::ir::refinement_profile profile;
+    profile.record(dejavu::ir::rk_sparse, 10, 2, 100);
+    profile.record(dejavu::ir::rk_sparse, 5, 0, 50);
+    profile.record(dejavu::ir::rk_singleton, 3, 1, 50);
+    EXPECT_EQ(profile.calls[dejavu::ir::rk_sparse], 2);
+    EXPECT_EQ(profile.half_edges[dejavu::ir::rk_sparse], 15);
+    EXPECT_EQ(profile.cells_split[dejavu::ir::rk_sparse], 2);
+    EXPECT_EQ(profile.cycles[dejavu::ir::rk_singleton], 50);
+    EXPECT_EQ(profile.calls[dejavu::ir::rk_dense], 0);
+
+    // only kernels which were called are printed
+    std::stringstream out;
+    profile.print(out);
+    EXPECT_NE(out.str().find("sparse"), std::string::npos);
+    EXPECT_NE(out.str().find("75.0"), std::string::npos);
+    EXPECT_EQ(out.str().find("dense"), std::string::npos);
+
+    profile.reset();
+    EXPECT_EQ(profile.calls[dejavu::ir::rk_sparse], 0);
+}
+
+TEST(refinement_test, edge_colored) {
+    // path 0 - 1 - 2, where only edge colors distinguish 0 and 2
+    dejavu::static_graph g1;
+    g1.initialize_graph(3, 2);
+    g1.add_vertex(0, 1);
+    g1.add_vertex(0, 2);
+    g1.add_vertex(0, 1);
+    g1.add_edge(0, 1, 0);
+    g1.add_edge(1, 2, 1);
+    refinement R;
+    coloring c;
+    g1.get_sgraph()->initialize_coloring(&c, g1.get_coloring());
+    R.refine_coloring(g1.get_sgraph(), &c);
+    EXPECT_EQ(c.cells, 3);
+    coloring c_first;
+    g1.get_sgraph()->initialize_coloring(&c_first, g1.get_coloring());
+    R.refine_coloring_first(g1.get_sgraph(), &c_first);
+    EXPECT_EQ(c_first.cells, 3);
+
+    // cycle of length 6 with alternating edge colors
+    const int n = 6;
+    dejavu::static_graph g2;
+    g2.initialize_graph(n, n);
+    for(int v = 0; v < n; ++v) g2.add_vertex(0, 2);
+    for(int v = 0; v < n - 1; ++v) g2.add_edge(v, v + 1, v % 2);
+    g2.add_edge(0, n - 1, (n - 1) % 2);
+    dejavu::sgraph* g = g2.get_sgraph();
+
+    std::vector<int> p(n);
+    int supp[n];
+    for(int v = 0; v < n; ++v) supp[v] = v;
+    for(int v = 0; v < n; ++v) p[v] = (v + 2) % n; // rotation preserving edge colors
+    EXPECT_TRUE(R.certify_automorphism(g, p.data()));
+    EXPECT_TRUE(R.certify_automorphism_sparse(g, p.data(), n, supp));
+    for(int v = 0; v < n; ++v) p[v] = (n + 1 - v) % n; // reflection preserving edge colors
+    EXPECT_TRUE(R.certify_automorphism(g, p.data()));
+    EXPECT_TRUE(R.certify_automorphism_sparse(g, p.data(), n, supp));
+    for(int v = 0; v < n; ++v) p[v] = (v + 1) % n; // rotation swapping edge colors
+    EXPECT_FALSE(R.certify_automorphism(g, p.data()));
+    EXPECT_FALSE(R.certify_automorphism_sparse(g, p.data(), n, supp));
+}
+
+TEST(refinement_test, directed) {
+    // transitive tournament 0 -> 1 -> 2, 0 -> 2: vertices differ in their number of in- and out-neighbours
+    dejavu::static_graph g1;
+    g1.initialize_graph(3, 3);
+    for(int v = 0; v < 3; ++v) g1.add_vertex(0, 2);
+    g1.add_arc(0, 1);
+    g1.add_arc(1, 2);
+    g1.add_arc(0, 2);
+    refinement R;
+    coloring c;
+    g1.get_sgraph()->initialize_coloring(&c, g1.get_coloring());
+    R.refine_coloring(g1.get_sgraph(), &c);
+    EXPECT_EQ(c.cells, 3);
+
+    // directed cycle 0 -> 1 -> 2 -> 0, with arcs in both directions between 0 and 3
+    dejavu::static_graph g2;
+    g2.initialize_graph(4, 4);
+    g2.add_vertex(0, 3);
+    g2.add_vertex(0, 2);
+    g2.add_vertex(0, 2);
+    g2.add_vertex(1, 1);
+    g2.add_arc(0, 1);
+    g2.add_arc(1, 2);
+    g2.add_arc(2, 0);
+    g2.add_arc(0, 3);
+    g2.add_arc(3, 0);
+    dejavu::sgraph* g = g2.get_sgraph();
+    coloring c2;
+    g->initialize_coloring(&c2, g2.get_coloring());
+    R.refine_coloring(g, &c2);
+    EXPECT_EQ(c2.cells, 4);
+
+    int p[4]  = {0, 2, 1, 3}; // reverses the arcs between 1 and 2
+    int supp[2] = {1, 2};
+    EXPECT_FALSE(R.certify_automorphism(g, p));
+    EXPECT_FALSE(R.certify_automorphism_sparse(g, p, 2, supp));
+}
+
+TEST(refinement_test, refinement_cache) {
+    // 8x8 torus
+    dejavu::static_graph g1;
+    make_torus(g1, 8);
+    dejavu::sgraph* g = g1.get_sgraph();
+
+    // one controller with refinement cache, one without
+    refinement R;
+    coloring c[2];
+    std::vector<std::unique_ptr<dejavu::ir::controller>> state;
+    std::vector<dejavu::ir::limited_save> root(2);
+    for(int i = 0; i < 2; ++i) {
+        g->initialize_coloring(&c[i], g1.get_coloring());
+        state.emplace_back(new dejavu::ir::controller(&R, &c[i]));
+        state[i]->set_refinement_cache(2, 1 << 20);
+        walk_last_cell_base(g, *state[i], root[i]);
+        state[i]->use_trace_early_out(false);
+    }
+    state[0]->use_refinement_cache(true);
+
+    // random walks, which only pick among few vertices in order to revisit IR nodes
+    std::mt19937 rng(7);
+    for(int walk = 0; walk < 200; ++walk) {
+        for(int i = 0; i < 2; ++i) state[i]->load_reduced_state(root[i]);
+        while(c[0].cells != g->v_size) {
+            int col = 0;
+            while(c[0].ptn[col] == 0) col += 1;
+            const int v = c[0].lab[col + static_cast<int>(rng() % 2)];
+            for(int i = 0; i < 2; ++i) state[i]->move_to_child(g, v);
+
+            ASSERT_EQ(c[0].cells, c[1].cells);
+            for(int j = 0; j < g->v_size; ++j) {
+                ASSERT_EQ(c[0].lab[j], c[1].lab[j]);
+                ASSERT_EQ(c[0].ptn[j], c[1].ptn[j]);
+                ASSERT_EQ(c[0].vertex_to_col[j], c[1].vertex_to_col[j]);
+                ASSERT_EQ(c[0].vertex_to_lab[j], c[1].vertex_to_lab[j]);
+            }
+            ASSERT_EQ(state[0]->T->get_hash(), state[1]->T->get_hash());
+            ASSERT_EQ(state[0]->T->get_position(), state[1]->T->get_position());
+            ASSERT_EQ(state[0]->T->trace_equal(), state[1]->T->trace_equal());
+        }
+    }
+    EXPECT_GT(state[0]->get_refinement_cache().s_hits, 0);
+    EXPECT_EQ(state[1]->get_refinement_cache().s_hits, 0);
+}
+
+TEST(refinement_test, base_only_save) {
+    // 8x8 torus
+    dejavu::static_graph g1;
+    make_torus(g1, 8);
+    dejavu::sgraph* g = g1.get_sgraph();
+
+    refinement R;
+    coloring c;
+    g->initialize_coloring(&c, g1.get_coloring());
+    dejavu::ir::controller state(&R, &c);
+    dejavu::ir::limited_save root;
+    std::vector<int> base = walk_last_cell_base(g, state, root);
+    state.use_trace_early_out(true);
+    ASSERT_GE(base.size(), 2);
+
+    // full save after the first base vertex, base-only and full saves of the leaf of the base
+    dejavu::ir::limited_save checkpoint, leaf_full, leaf_base_only;
+    state.load_reduced_state(root);
+    state.move_to_child(g, base[0]);
+    state.save_reduced_state(checkpoint);
+    for(int i = 1; i < static_cast<int>(base.size()); ++i) state.move_to_child(g, base[i]);
+    state.save_reduced_state(leaf_full);
+    state.save_reduced_state_base_only(leaf_base_only, &checkpoint);
+    EXPECT_TRUE(leaf_base_only.is_base_only());
+    EXPECT_EQ(leaf_base_only.get_checkpoint(), &checkpoint);
+
+    // loading the base-only save recomputes the coloring from the checkpoint
+    state.load_reduced_state(root);
+    state.load_reduced_state(leaf_base_only, g);
+    const coloring* expected = leaf_full.get_coloring();
+    ASSERT_EQ(c.cells, expected->cells);
+    for(int j = 0; j < g->v_size; ++j) {
+        ASSERT_EQ(c.lab[j], expected->lab[j]);
+        ASSERT_EQ(c.ptn[j], expected->ptn[j]);
+        ASSERT_EQ(c.vertex_to_col[j], expected->vertex_to_col[j]);
+    }
+    EXPECT_EQ(state.T->get_hash(), leaf_full.get_invariant_hash());
+    EXPECT_EQ(state.T->get_position(), leaf_full.get_trace_position());
+    EXPECT_EQ(state.s_base_pos, static_cast<int>(base.size()));
+
+    // a base-only save whose stored invariant does not match its base fails to load
+    dejavu::ir::limited_save leaf_wrong;
+    dejavu::ir::hash128 wrong_invariant = leaf_full.get_invariant_hash128();
+    wrong_invariant.low += 1;
+    leaf_wrong.save_base_only(base, &checkpoint, wrong_invariant, leaf_full.get_trace_position(),
+                              static_cast<int>(base.size()));
+    state.load_reduced_state(root);
+    EXPECT_THROW(state.load_reduced_state(leaf_wrong, g), std::logic_error);
+}
+
+TEST(refinement_test, delta_save) {
+    // 8x8 torus
+    dejavu::static_graph g1;
+    make_torus(g1, 8);
+    dejavu::sgraph* g = g1.get_sgraph();
+
+    refinement R;
+    coloring c;
+    g->initialize_coloring(&c, g1.get_coloring());
+    dejavu::ir::controller state(&R, &c);
+    dejavu::ir::limited_save root;
+    const std::vector<int> base = walk_last_cell_base(g, state, root);
+    state.use_trace_early_out(true);
+
+    // every node on the base is saved as a delta to its parent
+    std::vector<dejavu::ir::limited_save> deltas(base.size());
+    dejavu::ir::limited_save leaf_full;
+    state.load_reduced_state(root);
+    state.use_delta_recording(true);
+    for(int i = 0; i < static_cast<int>(base.size()); ++i) {
+        state.move_to_child(g, base[i]);
+        state.save_reduced_state_delta(deltas[i], i == 0 ? &root : &deltas[i - 1]);
+        EXPECT_TRUE(deltas[i].is_delta());
+        EXPECT_FALSE(deltas[i].has_coloring());
+        EXPECT_LE(deltas[i].get_delta().lab.size(), static_cast<size_t>(g->v_size));
+    }
+    state.use_delta_recording(false);
+    state.save_reduced_state(leaf_full);
+
+    // loading the last delta applies all deltas on the base to the root
+    state.load_reduced_state(root);
+    state.load_reduced_state(deltas.back());
+    const coloring* expected = leaf_full.get_coloring();
+    ASSERT_EQ(c.cells, expected->cells);
+    for(int j = 0; j < g->v_size; ++j) {
+        ASSERT_EQ(c.lab[j], expected->lab[j]);
+        ASSERT_EQ(c.ptn[j], expected->ptn[j]);
+        ASSERT_EQ(c.vertex_to_col[j], expected->vertex_to_col[j]);
+        ASSERT_EQ(c.vertex_to_lab[j], expected->vertex_to_lab[j]);
+    }
+    EXPECT_EQ(state.T->get_hash(), leaf_full.get_invariant_hash());
+    EXPECT_EQ(state.s_base_pos, static_cast<int>(base.size()));
+}
+
+TEST(refinement_test, leaf_memory_policy) {
+    const int n = 1000;
+    dejavu::static_graph g1;
+    g1.initialize_graph(n, 0);
+    for(int v = 0; v < n; ++v) g1.add_vertex(0, 0);
+    dejavu::sgraph* g = g1.get_sgraph();
+    coloring c;
+    g->initialize_coloring(&c, g1.get_coloring());
+
+    // leaves differ from the first leaf in a few positions, except every fifth leaf
+    const int leaves = 100;
+    std::vector<std::vector<int>> labs(leaves);
+    std::mt19937 rng(1);
+    for(int i = 0; i < leaves; ++i) {
+        labs[i].resize(n);
+        std::iota(labs[i].begin(), labs[i].end(), 0);
+        if(i % 5 == 4) std::shuffle(labs[i].begin(), labs[i].end(), rng);
+        else for(int j = 0; j < i; ++j) std::swap(labs[i][j], labs[i][n - 1 - j]);
+    }
+
+    // budget for 10 dense colorings
+    dejavu::ir::shared_leaves storage;
+    storage.h_memory_budget = 10 * n * static_cast<long>(sizeof(int));
+    for(int i = 0; i < leaves; ++i) {
+        std::copy(labs[i].begin(), labs[i].end(), c.lab);
+        std::vector<int> base = {i};
+        storage.add_leaf(i, c, base);
+    }
+    EXPECT_EQ(storage.s_leaves, leaves);
+    EXPECT_LE(storage.lab_memory(), storage.h_memory_budget);
+
+    int dense = 0, compressed = 0, base_only = 0;
+    std::vector<int> lab(n);
+    for(int i = 0; i < leaves; ++i) {
+        auto leaf = storage.lookup_leaf(i);
+        ASSERT_NE(leaf, nullptr);
+        ASSERT_EQ(leaf->get_base_size(), 1);
+        EXPECT_EQ(leaf->get_base()[0], i);
+        switch(leaf->get_store_type()) {
+            case dejavu::ir::stored_leaf::STORE_LAB:        ++dense;      break;
+            case dejavu::ir::stored_leaf::STORE_COMPRESSED: ++compressed; break;
+            default:                                        ++base_only;  break;
+        }
+        if(leaf->get_store_type() == dejavu::ir::stored_leaf::STORE_BASE) continue;
+        storage.load_lab(leaf, lab.data());
+        EXPECT_EQ(lab, labs[i]);
+    }
+    EXPECT_EQ(dense, 5);
+    EXPECT_GT(compressed, 10);
+    EXPECT_GT(base_only, 0);
+
+    // hot leaves are promoted, demoting leaves which were not hit
+    const int hot = leaves - 1;
+    auto hot_leaf = storage.lookup_leaf(hot);
+    ASSERT_EQ(hot_leaf->get_store_type(), dejavu::ir::stored_leaf::STORE_BASE);
+    for(int k = 0; k < storage.h_promote_hits; ++k) storage.record_hit(hot_leaf, labs[hot].data(), n);
+    EXPECT_EQ(hot_leaf->get_store_type(), dejavu::ir::stored_leaf::STORE_BASE);
+    storage.apply_promotions();
+    EXPECT_NE(hot_leaf->get_store_type(), dejavu::ir::stored_leaf::STORE_BASE);
+    EXPECT_EQ(storage.s_promoted, 1);
+    EXPECT_GT(storage.s_demoted, 0);
+    EXPECT_LE(storage.lab_memory(), storage.h_memory_budget);
+    storage.load_lab(hot_leaf, lab.data());
+    EXPECT_EQ(lab, labs[hot]);
+
+    storage.clear();
+    EXPECT_EQ(storage.s_leaves, 0);
+    EXPECT_EQ(storage.lab_memory(), 0);
+    EXPECT_EQ(storage.lookup_leaf(0), nullptr);
+}
+
+TEST(refinement_test, spilled_save) {
+    // 8x8 torus
+    dejavu::static_graph g1;
+    make_torus(g1, 8);
+    dejavu::sgraph* g = g1.get_sgraph();
+
+    refinement R;
+    coloring c;
+    g->initialize_coloring(&c, g1.get_coloring());
+    dejavu::ir::controller state(&R, &c);
+    dejavu::ir::limited_save root;
+    const std::vector<int> base = walk_last_cell_base(g, state, root);
+    state.use_trace_early_out(true);
+
+    // every node on the base is saved fully, and spilled to a file
+    dejavu::ds::spill_file file;
+    ASSERT_TRUE(file.open(std::filesystem::temp_directory_path().string()));
+    std::vector<dejavu::ir::limited_save> full(base.size()), spilled(base.size());
+    state.load_reduced_state(root);
+    for(int i = 0; i < static_cast<int>(base.size()); ++i) {
+        state.move_to_child(g, base[i]);
+        state.save_reduced_state(full[i]);
+        int* storage = file.allocate(2 * g->v_size);
+        ASSERT_NE(storage, nullptr);
+        state.save_reduced_state_spilled(spilled[i], storage);
+        EXPECT_TRUE(spilled[i].is_spilled());
+        EXPECT_FALSE(spilled[i].has_coloring());
+    }
+    EXPECT_GE(file.size(), static_cast<long>(base.size() * 2 * g->v_size * sizeof(int)));
+
+    // a delta to a spilled parent
+    dejavu::ir::limited_save delta;
+    state.load_reduced_state(spilled[0]);
+    state.use_delta_recording(true);
+    state.move_to_child(g, base[1]);
+    state.save_reduced_state_delta(delta, &spilled[0]);
+    state.use_delta_recording(false);
+
+    // loading spilled states restores the complete coloring
+    for(int i = 0; i < static_cast<int>(base.size()); ++i) {
+        dejavu::ir::limited_save& load = i == 1 ? delta : spilled[i];
+        state.load_reduced_state(root);
+        state.load_reduced_state(load);
+        const coloring* expected = full[i].get_coloring();
+        ASSERT_EQ(c.cells, expected->cells);
+        for(int j = 0; j < g->v_size; ++j) {
+            ASSERT_EQ(c.lab[j], expected->lab[j]);
+            ASSERT_EQ(c.vertex_to_col[j], expected->vertex_to_col[j]);
+            ASSERT_EQ(c.vertex_to_lab[j], expected->vertex_to_lab[j]);
+        }
+        for(int j = 0; j < g->v_size; j += c.ptn[j] + 1) ASSERT_EQ(c.ptn[j], expected->ptn[j]);
+        EXPECT_EQ(state.T->get_hash(), full[i].get_invariant_hash());
+    }
+
+    file.clear();
+    EXPECT_EQ(file.size(), 0);
+}
+
+TEST(refinement_test, compact_trace) {
+    // a compacted trace still detects deviations, within at most one block
+    dejavu::ir::trace recorded;
+    recorded.set_record(true);
+    for(int i = 0; i < 3; ++i) {
+        recorded.op_individualize(i);
+        recorded.op_refine_start();
+        for(int j = 0; j < 20; ++j) recorded.op_additional_info(i * 100 + j);
+        recorded.op_refine_end();
+    }
+    const int size = recorded.size();
+    recorded.compact(8);
+    EXPECT_EQ(recorded.size(), size);
+    EXPECT_LT(recorded.memory(), static_cast<long>(size * sizeof(int)));
+
+    for(int deviation = -1; deviation < 3; ++deviation) {
+        dejavu::ir::trace t;
+        t.set_compare(true);
+        t.set_compare_trace(&recorded);
+        for(int i = 0; i < 3; ++i) {
+            t.op_individualize(i);
+            t.op_refine_start();
+            for(int j = 0; j < 20; ++j) t.op_additional_info(i * 100 + j + (i == deviation && j == 5));
+            t.op_refine_end();
+        }
+        EXPECT_EQ(t.trace_equal(), deviation == -1);
+    }
+
+    // 8x8 torus with a pendant vertex, walking the IR tree using a compacted comparison trace
+    dejavu::static_graph g1;
+    make_torus(g1, 8, true);
+    dejavu::sgraph* g = g1.get_sgraph();
+
+    refinement R;
+    coloring c;
+    g->initialize_coloring(&c, g1.get_coloring());
+    R.refine_coloring_first(g, &c);
+    dejavu::ir::controller state(&R, &c);
+    state.use_compact_trace(4);
+    dejavu::ir::limited_save root;
+    const std::vector<int> base = walk_last_cell_base(g, state, root);
+    state.use_trace_early_out(true);
+
+    // walking the base again matches the compacted trace
+    state.load_reduced_state(root);
+    for(const int v : base) {
+        state.move_to_child(g, v);
+        EXPECT_TRUE(state.T->trace_equal());
+    }
+    EXPECT_EQ(c.cells, g->v_size);
+
+    // individualizing a vertex of another color deviates
+    state.load_reduced_state(root);
+    int other = -1;
+    for(int v = 0; v < g->v_size && other == -1; ++v) {
+        const int col = c.vertex_to_col[v];
+        if(col != c.vertex_to_col[base[0]] && c.ptn[col] > 0) other = v;
+    }
+    ASSERT_NE(other, -1);
+    state.move_to_child(g, other);
+    EXPECT_FALSE(state.T->trace_equal());
+}
+
+TEST(refinement_test, trace_hash128) {
+    dejavu::ir::trace t1, t2;
+    for(int i = 0; i < 100; ++i) {
+        t1.op_additional_info(i);
+        t2.op_additional_info(i == 50 ? -1 : i);
+    }
+    const dejavu::ir::hash128 h1 = t1.get_hash128();
+    EXPECT_EQ(h1.low, t1.get_hash());
+    EXPECT_NE(h1.low, t2.get_hash());
+    if constexpr (dejavu::ir::hash_128) EXPECT_NE(h1.high, t2.get_hash128().high);
+    else EXPECT_EQ(h1.high, 0);
+
+    // the full hash is restored, setting only the lower bits clears the upper ones
+    t2.set_hash128(h1);
+    EXPECT_EQ(t2.get_hash128().low, h1.low);
+    EXPECT_EQ(t2.get_hash128().high, h1.high);
+    t2.op_additional_info(100);
+    t1.op_additional_info(100);
+    EXPECT_EQ(t2.get_hash128().high, t1.get_hash128().high);
+    t2.set_hash(0);
+    EXPECT_EQ(t2.get_hash128().high, 0);
+
+    // prism over a hexagon
+    dejavu::static_graph g1;
+    g1.initialize_graph(12, 18);
+    for(int v = 0; v < 12; ++v) g1.add_vertex(0, 3);
+    for(int i = 0; i < 6; ++i) {
+        g1.add_edge(std::min(i, (i + 1) % 6), std::max(i, (i + 1) % 6));
+        g1.add_edge(6 + std::min(i, (i + 1) % 6), 6 + std::max(i, (i + 1) % 6));
+        g1.add_edge(i, 6 + i);
+    }
+
+    // stored leaves keep the upper bits of their hash
+    coloring c;
+    g1.get_sgraph()->initialize_coloring(&c, g1.get_coloring());
+    std::vector<int> base = {0};
+    dejavu::ir::shared_leaves storage;
+    storage.add_leaf(h1.low, c, base, h1.high);
+    ASSERT_NE(storage.lookup_leaf(h1.low), nullptr);
+    EXPECT_EQ(storage.lookup_leaf(h1.low)->get_hash_high(), h1.high);
+
+    // leaves are only told apart by the upper bits of their hash if these are computed
+    dejavu::solver d;
+    d.set_print(false);
+    d.automorphisms(&g1);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 2.4, 0.01);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 1);
+    if constexpr (!dejavu::ir::hash_128) {
+        EXPECT_EQ(d.get_hash_collisions(), 0);
+    }
+    EXPECT_LE(d.get_strong_invariants(), 2 * d.get_certification_failures());
+
+    // collision: a leaf which is not automorphic to the leaves of the graph is stored under their hash
+    dejavu::sgraph* g = g1.get_sgraph();
+    refinement R;
+    coloring c_left;
+    dejavu::ir::controller state(&R, &c), state_left(&R, &c_left);
+    state.reserve();
+    dejavu::ir::limited_save root;
+    state.save_reduced_state(root);
+    std::function<dejavu::ir::type_selector_hook> selector = [](const coloring* col, int) {
+        for(int i = 0; i < col->domain_size; i += col->ptn[i] + 1) if(col->ptn[i] > 0) return i;
+        return -1;
+    };
+    state.mode_write_base();
+    while(c.cells != g->v_size) state.move_to_child(g, c.lab[selector(&c, state.s_base_pos)]);
+    state.compare_to_this();
+    std::vector<int> base_vertex = state.base_vertex, base_sizes, fixed;
+    for(auto& b : state.base) base_sizes.push_back(b.color_sz);
+
+    // the colliding leaf differs from the leaf of the base by a transposition of adjacent vertices
+    state.walk(g, root, base_vertex);
+    const dejavu::ir::hash128 leaf_hash = state.T->get_hash128();
+    coloring colliding;
+    colliding.copy_any(&c);
+    std::swap(colliding.lab[colliding.vertex_to_lab[0]], colliding.lab[colliding.vertex_to_lab[1]]);
+    dejavu::ir::shared_tree tree(g->v_size);
+    tree.reset(base_vertex, &root, false);
+    tree.stored_leaves.add_leaf(leaf_hash.low, colliding, base_vertex, leaf_hash.high + dejavu::ir::hash_128);
+
+    dejavu::timed_print printer;
+    printer.h_silent = true;
+    dejavu::groups::schreier_workspace schreierw(g->v_size);
+    dejavu::groups::automorphism_workspace automorphism(g->v_size);
+    dejavu::groups::compressed_schreier group;
+    group.reset(nullptr, g->v_size, schreierw, base_vertex, base_sizes, static_cast<int>(base_vertex.size()), false,
+                fixed);
+    dejavu::random_source rng(false, 0);
+    dejavu::search_strategy::random_ir random(printer, schreierw, automorphism, rng);
+    int found = 0;
+    dejavu_hook count = [&](int, const int*, int, const int*) { ++found; };
+    state.load_reduced_state(root);
+    random.random_walks(g, &count, &selector, tree, group, state, state_left, 8);
+    EXPECT_GT(found, 0);
+
+    // with 128-bit hashes, the leaves are told apart by their hash, otherwise certification fails
+    const auto& leaves = tree.stored_leaves;
+    if constexpr (dejavu::ir::hash_128) {
+        EXPECT_GT(leaves.s_collisions, 0);
+        EXPECT_EQ(leaves.s_cert_failures, 0);
+        EXPECT_EQ(leaves.s_strong_invariants, 0);
+    } else {
+        EXPECT_EQ(leaves.s_collisions, 0);
+        EXPECT_GT(leaves.s_cert_failures, 0);
+        EXPECT_GT(leaves.s_strong_invariants, 0);
+    }
+}
+
+TEST(refinement_test, checkpoint_resume) {
+    // values are read back as written, corrupted files are rejected
+    const std::string file = (std::filesystem::temp_directory_path() / "dejavu_checkpoint_test").string();
+    std::filesystem::remove(file);
+    dejavu::ds::binary_writer out;
+    out.value(-5);
+    out.value(1L << 40);
+    out.value(0.25);
+    out.value(std::string("ir"));
+    out.values(std::vector<int>{3, -1, 7});
+    ASSERT_TRUE(out.write_file(file));
+
+    dejavu::ds::binary_reader in;
+    ASSERT_TRUE(in.read_file(file));
+    int i; long l; double x; std::string s; std::vector<int> vec;
+    in.value(i); in.value(l); in.value(x); in.value(s); in.values(vec);
+    EXPECT_TRUE(in.good());
+    EXPECT_TRUE(in.at_end());
+    EXPECT_EQ(i, -5);
+    EXPECT_EQ(l, 1L << 40);
+    EXPECT_EQ(x, 0.25);
+    EXPECT_EQ(s, "ir");
+    EXPECT_EQ(vec, std::vector<int>({3, -1, 7}));
+    in.value(i);
+    EXPECT_FALSE(in.good());
+
+    {
+        std::fstream f(file, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(1);
+        f.put('x');
+    }
+    EXPECT_FALSE(in.read_file(file));
+
+    // 8x8 rook's graph
+    const int k = 8;
+    dejavu::static_graph g1;
+    g1.initialize_graph(k * k, k * k * (k - 1));
+    for(int v = 0; v < k * k; ++v) g1.add_vertex(0, 2 * (k - 1));
+    for(int v = 0; v < k * k; ++v) {
+        for(int w = v + 1; w < k * k; ++w) if(v / k == w / k || v % k == w % k) g1.add_edge(v, w);
+    }
+    // interrupt the search once a checkpoint is written
+    std::filesystem::remove(file);
+    EXPECT_EXIT({
+        dejavu_hook interrupt = [&](int, const int*, int, const int*) {
+            if(std::filesystem::exists(file)) std::_Exit(3);
+        };
+        dejavu::solver d;
+        d.set_print(false);
+        d.set_checkpoint(file, 0);
+        d.automorphisms(&g1, &interrupt);
+        std::_Exit(0);
+    }, ::testing::ExitedWithCode(3), "");
+    ASSERT_TRUE(std::filesystem::exists(file));
+
+    // the resumed search returns the automorphisms of the interrupted run again, and finishes the search
+    const auto adjacent = [&](int v, int w) { return v != w && (v / k == w / k || v % k == w % k); };
+    int calls = 0;
+    bool valid = true;
+    dejavu_hook collect = [&](int n, const int* p, int, const int*) {
+        ++calls;
+        for(int v = 0; v < n; ++v) {
+            for(int w = v + 1; w < n; ++w) valid = valid && adjacent(v, w) == adjacent(p[v], p[w]);
+        }
+    };
+    // a checkpoint which is incomplete, but carries a valid checksum, is detected while resuming, and the search
+    // starts over
+    const std::string truncated = file + "_truncated";
+    {
+        std::ifstream f(file, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+        data.resize(data.size() - sizeof(uint64_t) - 1);
+        const uint64_t check = dejavu::ds::binary_writer::checksum(data.data(), data.size());
+        std::ofstream t(truncated, std::ios::binary | std::ios::trunc);
+        t.write(data.data(), static_cast<std::streamsize>(data.size()));
+        t.write(reinterpret_cast<const char*>(&check), sizeof(check));
+    }
+    dejavu::solver d;
+    d.set_print(false);
+    d.set_resume(truncated);
+    d.automorphisms(&g1, &collect);
+    EXPECT_FALSE(d.get_resumed());
+    EXPECT_TRUE(valid);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 3.2514, 0.001);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 9);
+    std::filesystem::remove(truncated);
+
+    calls = 0;
+    d.set_resume(file);
+    d.set_checkpoint(file, 0);
+    d.automorphisms(&g1, &collect);
+    EXPECT_TRUE(d.get_resumed());
+    EXPECT_GT(calls, 0);
+    EXPECT_TRUE(valid);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 3.2514, 0.001); // 2 * 8!^2
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 9);
+    EXPECT_FALSE(std::filesystem::exists(file));
+
+    // without a checkpoint, the search starts from scratch
+    d.automorphisms(&g1);
+    EXPECT_FALSE(d.get_resumed());
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 9);
+}
@@ -81,4 +81,317 @@ TEST(simple_graphs_test, trivial_graphs5) {
     d.automorphisms(&g1, &test_hook);
     EXPECT_EQ(d.get_automorphism_group_size().exponent, 0);
     EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 2.0, 0.001);
-}
\ No newline at end of file
+}
+TEST(simple_graphs_test, isomorphic_components) {
+    // five differently labeled copies of the Petersen graph, |Aut| = 120^5 * 5!
+    const int copies = 5;
+    const int petersen_edges[15][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 4}, {0, 4}, {0, 5}, {1, 6}, {2, 7}, {3, 8},
+                                       {4, 9}, {5, 7}, {6, 8}, {7, 9}, {5, 8}, {6, 9}};
+
+    dejavu::static_graph g1;
+    g1.initialize_graph(10 * copies, 15 * copies);
+    for(int i = 0; i < 10 * copies; ++i) g1.add_vertex(0, 3);
+    for(int k = 0; k < copies; ++k) {
+        for(auto edge : petersen_edges) {
+            const int v1 = 10 * k + (edge[0] + 3 * k) % 10;
+            const int v2 = 10 * k + (edge[1] + 3 * k) % 10;
+            g1.add_edge(std::min(v1, v2), std::max(v1, v2));
+        }
+    }
+
+    dejavu::sgraph test_graph;
+    test_graph.copy_graph(g1.get_sgraph());
+    dejavu::ir::refinement test_r;
+    auto test_hook = dejavu_hook([&test_r, &test_graph](int n, const int *p, int nsupp, const int *supp) {
+        EXPECT_EQ(n, test_graph.v_size);
+        EXPECT_TRUE(test_r.certify_automorphism_sparse(&test_graph, p, nsupp, supp));
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.automorphisms(&g1, &test_hook);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 12);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 2.985984, 0.001);
+}
+
+TEST(simple_graphs_test, isomorphic_components_cycles) {
+    // cycles of different lengths, the graph is regular and hence not preprocessed,
+    // |Aut| = 10^3 * 3! * 12^2 * 2! * 14
+    const int lengths[6] = {5, 5, 5, 6, 6, 7};
+    dejavu::static_graph g1;
+    g1.initialize_graph(34, 34);
+    for(int i = 0; i < 34; ++i) g1.add_vertex(0, 2);
+    int offset = 0;
+    for(const int length : lengths) {
+        for(int i = 0; i < length; ++i) {
+            const int v1 = offset + i, v2 = offset + (i + 1) % length;
+            g1.add_edge(std::min(v1, v2), std::max(v1, v2));
+        }
+        offset += length;
+    }
+
+    dejavu::sgraph test_graph;
+    test_graph.copy_graph(g1.get_sgraph());
+    dejavu::ir::refinement test_r;
+    auto test_hook = dejavu_hook([&test_r, &test_graph](int n, const int *p, int nsupp, const int *supp) {
+        EXPECT_EQ(n, test_graph.v_size);
+        EXPECT_TRUE(test_r.certify_automorphism_sparse(&test_graph, p, nsupp, supp));
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.automorphisms(&g1, &test_hook);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 7);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 2.4192, 0.001);
+}
+
+TEST(simple_graphs_test, isomorphic_components_rigid) {
+    // four differently labeled copies of a rigid graph, which is discrete after color refinement, |Aut| = 4!
+    const int copies = 4;
+    const int rigid_edges[13][2] = {{0, 1}, {0, 3}, {0, 4}, {0, 5}, {0, 6}, {1, 3}, {1, 4}, {1, 6}, {2, 4}, {2, 5},
+                                    {2, 6}, {3, 5}, {5, 6}};
+    int degrees[7] = {0, 0, 0, 0, 0, 0, 0};
+    for(auto edge : rigid_edges) {
+        ++degrees[edge[0]];
+        ++degrees[edge[1]];
+    }
+
+    dejavu::static_graph g1;
+    g1.initialize_graph(7 * copies, 13 * copies);
+    for(int k = 0; k < copies; ++k) {
+        for(int i = 0; i < 7; ++i) g1.add_vertex(0, degrees[(i + 7 - 2 * k) % 7]);
+    }
+    for(int k = 0; k < copies; ++k) {
+        for(auto edge : rigid_edges) {
+            const int v1 = 7 * k + (edge[0] + 2 * k) % 7;
+            const int v2 = 7 * k + (edge[1] + 2 * k) % 7;
+            g1.add_edge(std::min(v1, v2), std::max(v1, v2));
+        }
+    }
+
+    dejavu::sgraph test_graph;
+    test_graph.copy_graph(g1.get_sgraph());
+    dejavu::ir::refinement test_r;
+    auto test_hook = dejavu_hook([&test_r, &test_graph](int n, const int *p, int nsupp, const int *supp) {
+        EXPECT_EQ(n, test_graph.v_size);
+        EXPECT_TRUE(test_r.certify_automorphism_sparse(&test_graph, p, nsupp, supp));
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.automorphisms(&g1, &test_hook);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 1);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 2.4, 0.001);
+}
+
+TEST(simple_graphs_test, pipeline_sifting) {
+    // Johnson graph J(9,3), |Aut| = 9!, requires random search
+    std::vector<int> subsets;
+    for(int s = 0; s < (1 << 9); ++s) if(__builtin_popcount(s) == 3) subsets.push_back(s);
+    const int nv = static_cast<int>(subsets.size());
+
+    dejavu::static_graph g1;
+    g1.initialize_graph(nv, nv * 18 / 2);
+    for(int i = 0; i < nv; ++i) g1.add_vertex(0, 18);
+    for(int i = 0; i < nv; ++i) {
+        for(int j = i + 1; j < nv; ++j) {
+            if(__builtin_popcount(subsets[i] & subsets[j]) == 2) g1.add_edge(i, j);
+        }
+    }
+
+    dejavu::sgraph test_graph;
+    test_graph.copy_graph(g1.get_sgraph());
+    dejavu::ir::refinement test_r;
+    auto test_hook = dejavu_hook([&test_r, &test_graph](int, const int *p, int nsupp, const int *supp) {
+        EXPECT_TRUE(test_r.certify_automorphism_sparse(&test_graph, p, nsupp, supp));
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.set_pipeline_sifting();
+    d.automorphisms(&g1, &test_hook);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 5);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 3.6288, 0.001);
+}
+
+TEST(simple_graphs_test, threads_deterministic) {
+    // random cubic graph, large enough to compute invariants in parallel
+    const int nv = 4096;
+    std::mt19937 rng(7);
+    std::vector<std::pair<int, int>> edges;
+    std::vector<int> points;
+    bool simple = false;
+    while(!simple) {
+        points.clear();
+        edges.clear();
+        for(int v = 0; v < nv; ++v) for(int j = 0; j < 3; ++j) points.push_back(v);
+        std::shuffle(points.begin(), points.end(), rng);
+        std::set<std::pair<int, int>> seen;
+        simple = true;
+        for(int i = 0; i < static_cast<int>(points.size()) && simple; i += 2) {
+            const int v1 = std::min(points[i], points[i + 1]);
+            const int v2 = std::max(points[i], points[i + 1]);
+            simple = v1 != v2 && seen.insert({v1, v2}).second;
+            edges.emplace_back(v1, v2);
+        }
+    }
+
+    std::vector<std::vector<int>> generators[2];
+    dejavu::big_number grp_sz[2];
+    for(int run = 0; run < 2; ++run) {
+        dejavu::static_graph g1;
+        g1.initialize_graph(nv, static_cast<int>(edges.size()));
+        for(int v = 0; v < nv; ++v) g1.add_vertex(0, 3);
+        for(auto& [v1, v2] : edges) g1.add_edge(v1, v2);
+
+        auto& gens = generators[run];
+        auto test_hook = dejavu_hook([&gens](int n, const int *p, int, const int *) {
+            gens.emplace_back(p, p + n);
+        });
+
+        dejavu::solver d;
+        d.set_print(false);
+        d.set_threads(run == 0 ? 1 : 4);
+        d.automorphisms(&g1, &test_hook);
+        grp_sz[run] = d.get_automorphism_group_size();
+    }
+
+    EXPECT_EQ(generators[0], generators[1]);
+    EXPECT_EQ(grp_sz[0], grp_sz[1]);
+}
+
+TEST(simple_graphs_test, twins_threads_deterministic) {
+    // cycle of vertex groups, where groups are alternately independent sets (open twins) and triangles (closed twins),
+    // large enough to search for twins in parallel
+    const int groups = 2048;
+    const int group_sz = 3;
+    const int nv = groups * group_sz;
+    std::vector<std::pair<int, int>> edges;
+    for(int i = 0; i < groups; ++i) {
+        const int next = (i + 1) % groups;
+        for(int j = 0; j < group_sz; ++j) {
+            for(int k = 0; k < group_sz; ++k) edges.emplace_back(i * group_sz + j, next * group_sz + k);
+            if(i % 2 == 1) for(int k = j + 1; k < group_sz; ++k) edges.emplace_back(i * group_sz + j, i * group_sz + k);
+        }
+    }
+    std::vector<int> degree(nv, 0);
+    for(auto& [v1, v2] : edges) {
+        ++degree[v1];
+        ++degree[v2];
+    }
+
+    std::vector<std::vector<int>> generators[2];
+    dejavu::big_number grp_sz[2];
+    for(int run = 0; run < 2; ++run) {
+        dejavu::static_graph g1;
+        g1.initialize_graph(nv, static_cast<int>(edges.size()));
+        for(int v = 0; v < nv; ++v) g1.add_vertex(0, degree[v]);
+        for(auto& [v1, v2] : edges) g1.add_edge(std::min(v1, v2), std::max(v1, v2));
+
+        auto& gens = generators[run];
+        auto test_hook = dejavu_hook([&gens](int n, const int *p, int, const int *) {
+            gens.emplace_back(p, p + n);
+        });
+
+        dejavu::solver d;
+        d.set_print(false);
+        d.set_threads(run == 0 ? 1 : 4);
+        d.automorphisms(&g1, &test_hook);
+        grp_sz[run] = d.get_automorphism_group_size();
+    }
+
+    EXPECT_EQ(generators[0], generators[1]);
+    EXPECT_EQ(grp_sz[0], grp_sz[1]);
+}
+
+TEST(simple_graphs_test, autotune_refinement) {
+    // Paley graph of order 101, |Aut| = 101 * 50
+    const int q = 101;
+    std::vector<bool> square(q, false);
+    for(int x = 1; x < q; ++x) square[(x * x) % q] = true;
+    std::vector<std::pair<int, int>> edges;
+    for(int v1 = 0; v1 < q; ++v1) for(int v2 = v1 + 1; v2 < q; ++v2) if(square[v2 - v1]) edges.emplace_back(v1, v2);
+
+    dejavu::static_graph g1;
+    g1.initialize_graph(q, static_cast<int>(edges.size()));
+    for(int v = 0; v < q; ++v) g1.add_vertex(0, (q - 1) / 2);
+    for(auto& [v1, v2] : edges) g1.add_edge(v1, v2);
+
+    dejavu::sgraph test_graph;
+    test_graph.copy_graph(g1.get_sgraph());
+    dejavu::ir::refinement test_r;
+    auto test_hook = dejavu_hook([&test_r, &test_graph](int n, const int *p, int nsupp, const int *supp) {
+        EXPECT_EQ(n, test_graph.v_size);
+        EXPECT_TRUE(test_r.certify_automorphism_sparse(&test_graph, p, nsupp, supp));
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.set_autotune_refinement(true);
+    d.automorphisms(&g1, &test_hook);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 3);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 5.05, 0.001);
+}
+
+TEST(simple_graphs_test, edge_colored) {
+    // k x k torus, where horizontal and vertical edges have different colors: |Aut| = 4 * k^2 (instead of 8 * k^2)
+    const int k = 10;
+    dejavu::static_graph g1;
+    g1.initialize_graph(k * k, 2 * k * k);
+    for(int v = 0; v < k * k; ++v) g1.add_vertex(0, 4);
+    for(int x = 0; x < k; ++x) {
+        for(int y = 0; y < k; ++y) {
+            const int v = x * k + y;
+            const int right = x * k + (y + 1) % k;
+            const int down  = ((x + 1) % k) * k + y;
+            g1.add_edge(std::min(v, right), std::max(v, right), 1);
+            g1.add_edge(std::min(v, down),  std::max(v, down),  2);
+        }
+    }
+
+    dejavu::sgraph test_graph;
+    test_graph.copy_graph(g1.get_sgraph());
+    dejavu::ir::refinement test_r;
+    int generators = 0;
+    auto test_hook = dejavu_hook([&](int n, const int *p, int nsupp, const int *supp) {
+        EXPECT_EQ(n, test_graph.v_size);
+        EXPECT_TRUE(test_r.certify_automorphism_sparse(&test_graph, p, nsupp, supp));
+        ++generators;
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.automorphisms(&g1, &test_hook);
+    EXPECT_GT(generators, 0);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 2);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 4.0, 0.001);
+}
+
+TEST(simple_graphs_test, directed) {
+    // directed cycle of length n with a pendant vertex at every vertex, where arcs to the pendant vertices go in both
+    // directions: |Aut| = n (instead of 2n for the undirected graph)
+    const int n = 100;
+    dejavu::static_graph g1;
+    g1.initialize_graph(2 * n, 2 * n);
+    for(int v = 0; v < n; ++v) g1.add_vertex(0, 3);
+    for(int v = 0; v < n; ++v) g1.add_vertex(0, 1);
+    for(int v = 0; v < n; ++v) {
+        g1.add_arc(v, (v + 1) % n);
+        g1.add_arc(v, n + v);
+        g1.add_arc(n + v, v);
+    }
+
+    dejavu::sgraph test_graph;
+    test_graph.copy_graph(g1.get_sgraph());
+    dejavu::ir::refinement test_r;
+    auto test_hook = dejavu_hook([&](int n, const int *p, int nsupp, const int *supp) {
+        EXPECT_EQ(n, test_graph.v_size);
+        EXPECT_TRUE(test_r.certify_automorphism_sparse(&test_graph, p, nsupp, supp));
+    });
+
+    dejavu::solver d;
+    d.set_print(false);
+    d.automorphisms(&g1, &test_hook);
+    EXPECT_EQ(d.get_automorphism_group_size().exponent, 2);
+    EXPECT_NEAR(d.get_automorphism_group_size().mantissa, 1.0, 0.001);
+}
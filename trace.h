@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include "utility.h"
 
 namespace dejavu {
     namespace ir {
@@ -12,6 +15,24 @@ namespace dejavu {
 #define TRACE_MARKER_REFINE_CELL_START (INT32_MAX-4)
 #define TRACE_MARKER_REFINE_CELL_END   (INT32_MAX-5)
 
+#ifdef DEJAVU_HASH_128
+        constexpr bool hash_128 = true;  /**< whether traces compute 128-bit hashes */
+#else
+        constexpr bool hash_128 = false; /**< whether traces compute 128-bit hashes */
+#endif
+
+        /**
+         * \brief Hash of a trace
+         *
+         * The lower 64 bits are the hash used throughout, e.g., as keys of leaves. The upper 64 bits are only
+         * computed if dejavu is compiled with `DEJAVU_HASH_128` (and are 0 otherwise), using an independent lane. They
+         * tell apart most leaves whose lower 64 bits collide, without certifying an automorphism.
+         */
+        struct hash128 {
+            unsigned long low  = 0; /**< lower 64 bits */
+            unsigned long high = 0; /**< upper 64 bits */
+        };
+
         /**
          * \brief The trace invariant.
          *
@@ -24,6 +45,13 @@ namespace dejavu {
          *
          * While comparing to a stored trace (2, 3), the class facilitates the use of the blueprint heuristic, which
          * enables skipping of non-splitting cells in the stored trace.
+         *
+         * A recorded trace can be compacted (see \a compact), after which it only keeps a hash for each block of
+         * consecutive operations, rather than the operations themselves. Blocks end every few operations, before
+         * each individualization, and after each refinement. Traces comparing to a compacted trace hash their
+         * operations in the same manner, and detect a deviation at the end of the block it occurs in, i.e., slightly
+         * later than when comparing to a full trace. Deviations within a block which is only partially compared
+         * (e.g., since the position was moved to the middle of a block) can go unnoticed.
         */
         class trace {
         private:
@@ -32,6 +60,7 @@ namespace dejavu {
 
             trace *compare_trace = nullptr; /**< link to a stored trace to compare to */
             unsigned long hash = 0; /**< hash value to summarize all operations performed on this trace */
+            unsigned long hash_high = 0; /**< upper 64 bits of the hash, only computed if \a hash_128 */
 
             // mode
             bool compare = false; /**< whether to compare operations to a stored trace*/
@@ -47,11 +76,69 @@ namespace dejavu {
             int position = 0;
             bool comp = true;
 
+            /**
+             * \brief Hash of a block of operations in a compacted trace
+             */
+            struct checkpoint {
+                int      position; /**< the block ends right before this position */
+                uint32_t hash;     /**< hash of the operations in the block       */
+            };
+
+            // compacted trace
+            bool compacted = false;                 /**< whether this trace only keeps the following hashes      */
+            int  compacted_size = 0;                /**< number of operations in the compacted trace             */
+            std::vector<checkpoint> checkpoints;    /**< hashes of blocks, ordered by position                   */
+            std::vector<int> individualizations;    /**< positions of individualizations                         */
+            std::vector<int> non_splitting_cells;   /**< positions of non-splitting cells, if kept for blueprints */
+            bool compacted_blueprint = false;       /**< whether \a non_splitting_cells were kept                */
+
+            // comparison variables, if the comparison trace is compacted
+            int      cp_next  = 0;     /**< next block of the comparison trace                          */
+            uint32_t cp_hash  = 0;     /**< hash of the operations since the last block ended            */
+            bool     cp_valid = true;  /**< whether the current block is hashed from its start           */
+            int      cell_start = 0;   /**< position of the current refinement with respect to a color   */
+
+            static uint32_t block_hash(uint32_t h, int d) {
+                return (h ^ static_cast<uint32_t>(d)) * 0x01000193u;
+            }
+
+            /**
+             * Compares an operation to the compacted comparison trace.
+             */
+            void compare_compacted(int d) {
+                const auto& cps = compare_trace->checkpoints;
+                // individualizations always start a new block
+                if (d == TRACE_MARKER_INDIVIDUALIZE)
+                    comp = comp && (position == 0 || (cp_next > 0 && cps[cp_next - 1].position == position));
+
+                cp_hash = block_hash(cp_hash, d);
+                if (cp_next < static_cast<int>(cps.size()) && cps[cp_next].position == position + 1) {
+                    comp = comp && (!cp_valid || cps[cp_next].hash == cp_hash);
+                    ++cp_next;
+                    cp_hash  = 0;
+                    cp_valid = true;
+                } else {
+                    // the end of a refinement always ends a block
+                    comp = comp && cp_next < static_cast<int>(cps.size()) && d != TRACE_MARKER_REFINE_END;
+                }
+            }
+
+            /**
+             * Moves to the block of the compacted comparison trace containing \a position.
+             */
+            void sync_compacted() {
+                if (compare_trace == nullptr || !compare_trace->compacted) return;
+                const auto& cps = compare_trace->checkpoints;
+                cp_next = static_cast<int>(std::upper_bound(cps.begin(), cps.end(), position,
+                                            [](int pos, const checkpoint& cp) { return pos < cp.position; })
+                                           - cps.begin());
+                cp_hash  = 0;
+                cp_valid = position == 0 || (cp_next > 0 && cps[cp_next - 1].position == position);
+            }
+
             void inline add_to_hash(int d) {
-                unsigned long ho = hash & 0xff00000000000000; // extract high-order 8 bits from hash
-                hash    = hash << 8;                    // shift hash left by 5 bits
-                hash    = hash ^ (ho >> 56);            // move the highorder 5 bits to the low-order
-                hash    = hash ^ d;                     // XOR into hash
+                hash = ::add_to_hash(hash, d);
+                if constexpr (hash_128) hash_high = mix_into_hash(hash_high, d, 0xc2b2ae3d27d4eb4fUL);
             }
 
             void write_compare(int d) {
@@ -64,8 +151,11 @@ namespace dejavu {
             void write_compare_no_limit(int d) {
                 add_to_hash(d);
                 if (record)  data.push_back(d);
-                if (compare) comp = comp && (position < ((int) compare_trace->data.size()))
-                                    && (compare_trace->data[position] == d);
+                if (compare) {
+                    if (compare_trace->compacted) compare_compacted(d);
+                    else comp = comp && (position < ((int) compare_trace->data.size()))
+                                && (compare_trace->data[position] == d);
+                }
                 ++position;
             }
 
@@ -107,6 +197,7 @@ namespace dejavu {
              */
             void op_refine_cell_start([[maybe_unused]] int color) {
                 assert(!comp || !assert_cell_act);
+                cell_start = position;
                 write_compare_no_limit(TRACE_MARKER_REFINE_CELL_START);
                 //write_compare(color);
                 // cell_old_color = color;
@@ -156,7 +247,12 @@ namespace dejavu {
              * (i.e., whether the next color is splitting).
              */
             [[maybe_unused]] bool blueprint_is_next_cell_active() {
-                if (!compare || !comp || position > static_cast<int>(compare_trace->data.size())) return true;
+                if (!compare || !comp || position > compare_trace->size()) return true;
+                if (compare_trace->compacted) {
+                    const auto& cells = compare_trace->non_splitting_cells;
+                    return !compare_trace->compacted_blueprint ||
+                           !std::binary_search(cells.begin(), cells.end(), cell_start);
+                }
 
                 assert(compare_trace);
                 size_t read_pt = position;
@@ -177,6 +273,13 @@ namespace dejavu {
              * \a blueprint_is_next_cell_active() determined the current color to be non-splitting.
              */
             [[maybe_unused]] void blueprint_skip_to_next_cell() {
+                if (compare_trace->compacted) {
+                    // non-splitting cells consist of their start, their size, and their end
+                    position = cell_start + 3;
+                    sync_compacted();
+                    assert_cell_act = false;
+                    return;
+                }
                 while (position < static_cast<int>(compare_trace->data.size()) &&
                        compare_trace->data[position] != TRACE_MARKER_REFINE_CELL_END) {
                     assert(compare_trace->data.size() > (size_t) position);
@@ -200,7 +303,12 @@ namespace dejavu {
                     data.resize(read_pt);
                     position = read_pt;
                 }
-                if (compare) {
+                if (compare && compare_trace->compacted) {
+                    const auto& inds = compare_trace->individualizations;
+                    const auto it = std::upper_bound(inds.begin(), inds.end(), std::max(position - 1, 0));
+                    position = it == inds.begin() ? 0 : *(it - 1);
+                    sync_compacted();
+                } else if (compare) {
                     int read_pt = std::max(position - 1, 0);
                     while (read_pt > 0 && compare_trace->data[read_pt] != TRACE_MARKER_INDIVIDUALIZE) {
                         --read_pt;
@@ -217,7 +325,12 @@ namespace dejavu {
             void skip_to_individualization() {
                 assert_cell_act = false;
                 assert_refine_act = false;
-                if (compare) {
+                if (compare && compare_trace->compacted) {
+                    const auto& inds = compare_trace->individualizations;
+                    const auto it = std::lower_bound(inds.begin(), inds.end(), position - 1);
+                    position = it == inds.end() ? compare_trace->size() : *it;
+                    sync_compacted();
+                } else if (compare) {
                     int read_pt = position - 1;
                     while ((size_t) read_pt < compare_trace->data.size() &&
                             compare_trace->data[read_pt] != TRACE_MARKER_INDIVIDUALIZE) {
@@ -234,6 +347,7 @@ namespace dejavu {
              */
             void set_compare_trace(trace *new_compare_trace) {
                 this->compare_trace = new_compare_trace;
+                sync_compacted();
             }
 
             /**
@@ -253,12 +367,29 @@ namespace dejavu {
                 return hash;
             }
 
+            /**
+             * @return The full hash value, of which the upper 64 bits are only computed if \a hash_128.
+             */
+            [[nodiscard]] hash128 get_hash128() const {
+                return {hash, hash_high};
+            }
+
             /**
              * Sets the hash value to a pre-determined value.
              * @param hash The hash value.
              */
             void set_hash(unsigned long new_hash) {
-                this->hash = new_hash;
+                this->hash      = new_hash;
+                this->hash_high = 0;
+            }
+
+            /**
+             * Sets the full hash value to a pre-determined value.
+             * @param new_hash The hash value, as returned by \a get_hash128.
+             */
+            void set_hash128(const hash128 new_hash) {
+                this->hash      = new_hash.low;
+                this->hash_high = new_hash.high;
             }
 
             /**
@@ -283,9 +414,16 @@ namespace dejavu {
 
             void reset() {
                 data.clear();
+                compacted = false;
+                compacted_size = 0;
+                checkpoints.clear();
+                individualizations.clear();
+                non_splitting_cells.clear();
+                compacted_blueprint = false;
                 compare_trace = nullptr;
                 position = 0;
                 hash = 0;
+                hash_high = 0;
                 assert(record?static_cast<int>(data.size())==position:true);
                 reset_trace_equal();
             }
@@ -306,11 +444,72 @@ namespace dejavu {
                 this->position = new_position;
                 if(record) data.resize(position);
                 assert(record?static_cast<int>(data.size())==position:true);
+                sync_compacted();
             }
 
             [[nodiscard]] int get_position() const {
                 return position;
             }
+
+            /**
+             * @return Number of operations stored in this trace.
+             */
+            [[nodiscard]] int size() const {
+                return compacted ? compacted_size : static_cast<int>(data.size());
+            }
+
+            /**
+             * Compacts a recorded trace, such that it only keeps hashes of blocks of operations (see \a trace). Other
+             * traces can still compare to the trace, but no further operations can be recorded into it.
+             *
+             * @param stride blocks contain at most this many operations
+             * @param blueprint whether to keep the positions of non-splitting cells, which are needed for the
+             * blueprint heuristic
+             */
+            void compact(const int stride, const bool blueprint = false) {
+                assert(stride > 0);
+                checkpoints.clear();
+                individualizations.clear();
+                non_splitting_cells.clear();
+
+                const int sz = static_cast<int>(data.size());
+                int      block_start = 0;
+                uint32_t h = 0;
+                const auto end_block = [&](const int end) {
+                    if (end == block_start) return;
+                    checkpoints.push_back({end, h});
+                    block_start = end;
+                    h = 0;
+                };
+
+                for (int i = 0; i < sz; ++i) {
+                    const int d = data[i];
+                    if (d == TRACE_MARKER_INDIVIDUALIZE) {
+                        end_block(i);
+                        individualizations.push_back(i);
+                    }
+                    if (blueprint && d == TRACE_MARKER_REFINE_CELL_START && i + 2 < sz &&
+                        data[i + 2] == TRACE_MARKER_REFINE_CELL_END) non_splitting_cells.push_back(i);
+                    h = block_hash(h, d);
+                    if (d == TRACE_MARKER_REFINE_END || i + 1 - block_start == stride) end_block(i + 1);
+                }
+                end_block(sz);
+
+                compacted           = true;
+                compacted_size      = sz;
+                compacted_blueprint = blueprint;
+                record              = false;
+                std::vector<int>().swap(data);
+            }
+
+            /**
+             * @return Bytes of memory used to store this trace.
+             */
+            [[nodiscard]] long memory() const {
+                return static_cast<long>(data.capacity() * sizeof(int) + checkpoints.capacity() * sizeof(checkpoint) +
+                                         (individualizations.capacity() + non_splitting_cells.capacity()) *
+                                         sizeof(int));
+            }
         };
     }
 }
@@ -14,6 +14,8 @@
 #include <memory>
 #include <chrono>
 #include <iomanip>
+#include <sstream>
+#include <thread>
 #include "ds.h"
 
 #ifndef DEJAVU_UTILITY_H
@@ -49,19 +51,38 @@ static unsigned int hash(unsigned int x) {
 }
 
 /**
- * Accumulate a hash, for example to be used to hash strings of integers.
+ * Accumulate an integer into one 64-bit lane of a hash, using a multiply-xorshift step. Different odd multipliers
+ * \p mult lead to (practically) independent lanes.
  *
  * @param hash hash computed so far
  * @param d integer to accumulate to \p hash
+ * @param mult odd multiplier of the lane
  * @return the new hash
  */
-static unsigned long add_to_hash(unsigned long hash, const int d) {
+static inline unsigned long mix_into_hash(unsigned long hash, const int d, const unsigned long mult) {
+    hash = (hash ^ static_cast<unsigned int>(d)) * mult;
+    return hash ^ (hash >> 29);
+}
+
+/**
+ * Accumulate a hash, for example to be used to hash strings of integers. If dejavu is compiled with
+ * `DEJAVU_HASH_128`, a multiply-xorshift step is used instead of the default rotate-xor.
+ *
+ * @param hash hash computed so far
+ * @param d integer to accumulate to \p hash
+ * @return the new hash
+ */
+static inline unsigned long add_to_hash(unsigned long hash, const int d) {
+#ifdef DEJAVU_HASH_128
+    return mix_into_hash(hash, d, 0x9e3779b97f4a7c15UL);
+#else
     const unsigned long ho = hash & 0xff00000000000000; // extract high-order 8 bits from hash
     hash    = hash << 8;                    // shift hash left by 5 bits
     hash    = hash ^ (ho >> 56);            // move the highorder 5 bits to the low-order
     hash    = hash ^ d;                     // XOR into hash
 
     return hash;
+#endif
 }
 
 /**
@@ -75,7 +96,18 @@ static inline bool file_exists(const std::string& name) {
     return f.good();
 }
 
-static void parse_dimacs(const std::string& filename, dejavu::sgraph* g, int** colmap, bool silent=true,
+/**
+ * Reads a graph in DIMACS format from \p filename, and writes it to \p g. Lines `e v1 v2` may carry an edge color as a
+ * third field, and lines `a v1 v2` are arcs from `v1` to `v2`.
+ *
+ * @param filename the file
+ * @param g the graph to write to, must not be initialized
+ * @param colmap is set to a vertex coloring of \p g if the file contains vertex colors, allocated using `calloc`
+ * @param silent whether to print the parse time
+ * @param seed_permute if not 0, vertices are randomly permuted using this seed
+ * @return whether the graph is valid, otherwise an error is printed (e.g., for an arc given more than once)
+ */
+static bool parse_dimacs(const std::string& filename, dejavu::sgraph* g, int** colmap, bool silent=true,
                                    int seed_permute=0) {
     std::chrono::high_resolution_clock::time_point timer = std::chrono::high_resolution_clock::now();
     std::ifstream infile(filename);
@@ -83,12 +115,14 @@ static void parse_dimacs(const std::string& filename, dejavu::sgraph* g, int** c
     std::vector<int> reshuffle;
 
     std::vector<std::vector<int>> incidence_list;
+    std::vector<std::vector<int>> edge_color_list; /*< only used if some edge has a color, parallel to incidence_list */
     std::set<int> degrees;
     std::set<int> colors;
     std::string line;
     std::string nv_str, ne_str;
-    std::string nv1_string, nv2_string;
+    std::string nv1_string, nv2_string, ec_string;
     int nv1, nv2;
+    bool has_arcs = false;
     size_t i;
     int nv = 0;
     int ne = 0;
@@ -123,6 +157,7 @@ static void parse_dimacs(const std::string& filename, dejavu::sgraph* g, int** c
                     incidence_list[incidence_list.size() - 1].reserve(average_d);
                 }
                 break;
+            case 'a':
             case 'e':
                 nv1_string = "";
                 nv2_string = "";
@@ -134,11 +169,34 @@ static void parse_dimacs(const std::string& filename, dejavu::sgraph* g, int** c
                     nv2_string += line[i];
                 }
 
+                // optional edge color
+                ec_string = "";
+                ++i;
+                for(; i < line.size() && line[i] != ' '; ++i) {
+                    ec_string += line[i];
+                }
+
                 nv1 = reshuffle[std::stoi(nv1_string)-1];
                 nv2 = reshuffle[std::stoi(nv2_string)-1];
 
+                if((m == 'a' || !ec_string.empty()) && edge_color_list.empty()) {
+                    // first colored edge or arc, all previous edges have color 0
+                    edge_color_list.reserve(nv);
+                    for(auto& incidence : incidence_list) edge_color_list.emplace_back(incidence.size(), 0);
+                }
+                has_arcs = has_arcs || m == 'a';
+
                 incidence_list[nv1 - 1].push_back(nv2 - 1);
                 incidence_list[nv2 - 1].push_back(nv1 - 1);
+                if(m == 'a') {
+                    edge_color_list[nv1 - 1].push_back(dejavu::sgraph::arc_out);
+                    edge_color_list[nv2 - 1].push_back(dejavu::sgraph::arc_in);
+                } else if(!edge_color_list.empty()) {
+                    const int edge_color = ec_string.empty() ? 0 : std::stoi(ec_string);
+                    assert(edge_color >= 0);
+                    edge_color_list[nv1 - 1].push_back(edge_color);
+                    edge_color_list[nv2 - 1].push_back(edge_color);
+                }
                 break;
             case 'n':
                 if(*colmap == nullptr)
@@ -162,6 +220,32 @@ static void parse_dimacs(const std::string& filename, dejavu::sgraph* g, int** c
         }
     }
 
+    // arcs in both directions between two vertices form a single edge
+    if(has_arcs) {
+        for(size_t v = 0; v < incidence_list.size(); ++v) {
+            std::vector<std::pair<int, int>> edges;
+            for(size_t j = 0; j < incidence_list[v].size(); ++j)
+                edges.emplace_back(incidence_list[v][j], edge_color_list[v][j]);
+            std::sort(edges.begin(), edges.end());
+            incidence_list[v].clear();
+            edge_color_list[v].clear();
+            for(auto& [neighbour, color] : edges) {
+                if(!incidence_list[v].empty() && incidence_list[v].back() == neighbour) {
+                    // only an arc in each direction may join the same pair of vertices
+                    if(edge_color_list[v].back() != dejavu::sgraph::arc_in || color != dejavu::sgraph::arc_out) {
+                        std::cerr << "duplicate edge or arc between vertices " << v + 1 << " and " << neighbour + 1
+                                  << " in '" << filename << "'" << std::endl;
+                        return false;
+                    }
+                    edge_color_list[v].back() = dejavu::sgraph::arc_both;
+                    continue;
+                }
+                incidence_list[v].push_back(neighbour);
+                edge_color_list[v].push_back(color);
+            }
+        }
+    }
+
     int epos = 0;
     int vpos = 0;
 
@@ -181,12 +265,190 @@ static void parse_dimacs(const std::string& filename, dejavu::sgraph* g, int** c
     }
 
     g->v_size = nv;
-    g->e_size = 2 * ne;
+    g->e_size = epos;
+
+    if(!edge_color_list.empty()) {
+        g->initialize_edge_colors();
+        epos = 0;
+        for(auto& edge_colors : edge_color_list) {
+            for(int edge_color : edge_colors) g->ec[epos++] = edge_color;
+        }
+    }
 
     assert(nv == g->v_size);
-    assert(2 * ne == g->e_size);
+    assert(2 * ne == g->e_size || has_arcs);
     const double parse_time = (double) (std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - timer).count());
     if(!silent) std::cout << std::setprecision(2) << "parse_time=" << parse_time / 1000000.0 << "ms";
+    return true;
+}
+
+/**
+ * Is \p filename a formula in DIMACS CNF format, i.e., does its problem line start with `p cnf`?
+ *
+ * @param filename the file
+ * @return whether \p filename contains a CNF formula
+ */
+static inline bool is_dimacs_cnf(const std::string& filename) {
+    std::ifstream infile(filename);
+    std::string line;
+    while (std::getline(infile, line)) {
+        if(line.empty() || line[0] == 'c') continue;
+        return line.compare(0, 5, "p cnf") == 0;
+    }
+    return false;
+}
+
+/**
+ * Reads a formula in DIMACS CNF format from \p filename, and writes its literal-clause graph to \p g, in a single
+ * pass over the file. The literals of variable `x` (counted from 1) are the vertices `2(x-1)` (positive literal) and
+ * `2(x-1)+1` (negative literal), which are joined by an edge. Clauses are the vertices from `2 * variables` on, in the
+ * order of the file, and are adjacent to their literals. Literals have color 0 and clauses have color 1 in \p colmap.
+ * Hence, the automorphisms of \p g restricted to the literals are the syntactic symmetries of the formula.
+ *
+ * @param filename the file
+ * @param g the graph to write to, must not be initialized
+ * @param colmap is set to a vertex coloring of \p g, allocated using `calloc`
+ * @param silent whether to print the parse time
+ * @return the number of variables of the formula, or -1 if the file is not a valid formula (\p g is then left
+ *         untouched, and an error is printed)
+ */
+[[maybe_unused]] static int parse_dimacs_cnf(const std::string& filename, dejavu::sgraph* g, int** colmap,
+                                             bool silent=true) {
+    std::chrono::high_resolution_clock::time_point timer = std::chrono::high_resolution_clock::now();
+    std::ifstream infile(filename, std::ios::binary);
+    if(!infile) {
+        std::cerr << "could not open file '" << filename << "'" << std::endl;
+        return -1;
+    }
+
+    // buffered reading of characters
+    std::vector<char> buffer(1 << 20);
+    std::streamsize buffer_pos = 0;
+    std::streamsize buffer_end = 0;
+    const auto next_char = [&]() -> int {
+        if(buffer_pos == buffer_end) {
+            infile.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer_end = infile.gcount();
+            buffer_pos = 0;
+            if(buffer_end == 0) return EOF;
+        }
+        return buffer[buffer_pos++];
+    };
+    const auto skip_line = [&]() {
+        int ch = next_char();
+        while(ch != EOF && ch != '\n') ch = next_char();
+    };
+
+    int variables = -1;              /*< -1 until the problem line was read */
+    std::vector<int> literals;       /*< literals of all clauses, as vertices of the graph */
+    std::vector<int> clause_start = {0}; /*< clause i consists of literals[clause_start[i]...clause_start[i+1]-1] */
+    std::vector<int> occurrences;    /*< number of clauses containing each literal */
+
+    int ch = next_char();
+    while(ch != EOF) {
+        if(ch == 'c' || ch == 'p') {
+            if(ch == 'p') {
+                std::string problem_line;
+                for(ch = next_char(); ch != EOF && ch != '\n'; ch = next_char()) problem_line += static_cast<char>(ch);
+                std::istringstream problem(problem_line);
+                std::string format;
+                int clauses = 0;
+                int problem_variables = -1;
+                problem >> format >> problem_variables >> clauses;
+                if(variables >= 0 || !problem || format != "cnf" || problem_variables < 0 || clauses < 0 ||
+                   problem_variables > (INT32_MAX - clauses) / 2) {
+                    std::cerr << "invalid problem line 'p" << problem_line << "' in '" << filename << "'" << std::endl;
+                    return -1;
+                }
+                variables = problem_variables;
+                occurrences.assign(2 * variables, 0);
+                literals.reserve(3 * clauses);
+                clause_start.reserve(clauses + 1);
+            } else {
+                skip_line();
+            }
+            ch = next_char();
+        } else if(ch == '%') {
+            break; // end of formula in some benchmark libraries
+        } else if(ch == '-' || (ch >= '0' && ch <= '9')) {
+            const bool negative = ch == '-';
+            if(negative) ch = next_char();
+            long variable = 0;
+            for(; ch >= '0' && ch <= '9'; ch = next_char()) {
+                variable = std::min(10 * variable + (ch - '0'), static_cast<long>(INT32_MAX) + 1);
+            }
+            if(variables < 0) {
+                std::cerr << "missing problem line before the clauses in '" << filename << "'" << std::endl;
+                return -1;
+            }
+            if(variable > variables) {
+                std::cerr << "variable " << variable << " in '" << filename << "' exceeds the " << variables
+                          << " variables of the problem line" << std::endl;
+                return -1;
+            }
+            if(variable != 0) {
+                literals.push_back(2 * static_cast<int>(variable - 1) + negative);
+                continue;
+            }
+
+            // end of clause, remove repeated literals
+            const auto begin = literals.begin() + clause_start.back();
+            std::sort(begin, literals.end());
+            literals.erase(std::unique(begin, literals.end()), literals.end());
+            for(auto it = begin; it != literals.end(); ++it) ++occurrences[*it];
+            clause_start.push_back(static_cast<int>(literals.size()));
+        } else {
+            ch = next_char();
+        }
+    }
+
+    if(variables < 0) {
+        std::cerr << "missing problem line in '" << filename << "'" << std::endl;
+        return -1;
+    }
+
+    // a last clause may not be terminated
+    if(clause_start.back() != static_cast<int>(literals.size())) {
+        const auto begin = literals.begin() + clause_start.back();
+        std::sort(begin, literals.end());
+        literals.erase(std::unique(begin, literals.end()), literals.end());
+        for(auto it = begin; it != literals.end(); ++it) ++occurrences[*it];
+        clause_start.push_back(static_cast<int>(literals.size()));
+    }
+
+    // write graph
+    const int clauses = static_cast<int>(clause_start.size()) - 1;
+    const int nv = 2 * variables + clauses;
+    const int ne = variables + static_cast<int>(literals.size());
+    g->initialize(nv, 2 * ne);
+    g->v_size = nv;
+    g->e_size = 2 * ne;
+    *colmap = (int *) calloc(nv, sizeof(int));
+
+    int epos = 0;
+    for(int l = 0; l < 2 * variables; ++l) {
+        g->v[l] = epos;
+        g->d[l] = occurrences[l] + 1;
+        g->e[epos] = l ^ 1; // boolean consistency
+        epos += g->d[l];
+        occurrences[l] = 1; // now used as the number of edges written
+    }
+    for(int j = 0; j < clauses; ++j) {
+        const int clause = 2 * variables + j;
+        g->v[clause] = epos;
+        g->d[clause] = clause_start[j + 1] - clause_start[j];
+        (*colmap)[clause] = 1;
+        for(int k = clause_start[j]; k < clause_start[j + 1]; ++k) {
+            const int l = literals[k];
+            g->e[epos++] = l;
+            g->e[g->v[l] + occurrences[l]++] = clause;
+        }
+    }
+    assert(epos == 2 * ne);
+
+    const double parse_time = (double) (std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - timer).count());
+    if(!silent) std::cout << std::setprecision(2) << "parse_time=" << parse_time / 1000000.0 << "ms";
+    return variables;
 }
 
 typedef void type_dejavu_hook(int, const int*, int, const int*);
@@ -194,6 +456,36 @@ typedef std::function<void(int, const int*, int, const int*)> dejavu_hook;
 
 namespace dejavu {
 
+    /**
+     * Calls \p work for every `i` in `from, ..., to - 1`. The range is split into contiguous blocks, which are processed
+     * by \p threads threads (including the calling thread). Returns once all calls have finished.
+     *
+     * @param threads number of threads to use
+     * @param from first index
+     * @param to index after the last index
+     * @param work function called with each index
+     */
+    template<class F>
+    void parallel_for(int threads, const int from, const int to, F&& work) {
+        threads = std::max(std::min(threads, to - from), 1);
+        if(threads == 1) {
+            for(int i = from; i < to; ++i) work(i);
+            return;
+        }
+
+        const int block = (to - from + threads - 1) / threads;
+        auto run_block = [&work, from, to, block](const int t) {
+            const int block_end = std::min(from + (t + 1) * block, to);
+            for(int i = from + t * block; i < block_end; ++i) work(i);
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for(int t = 1; t < threads; ++t) pool.emplace_back(run_block, t);
+        run_block(0);
+        for(auto& thread : pool) thread.join();
+    }
+
     /**
      * \brief Random number generation
      *
@@ -216,6 +508,24 @@ namespace dejavu {
             pseudo_random_device.seed(set_seed);
         }
 
+        /**
+         * Re-initializes this random source with the given parameters.
+         *
+         * @param set_true_random use random device of OS if true, or pseudo random if false
+         * @param set_seed sets seed of pseudo random number generator
+         */
+        void seed(bool set_true_random, int set_seed) {
+            true_random = set_true_random;
+            pseudo_random_device.seed(set_seed);
+        }
+
+        /**
+         * @return whether the random device of the OS is used
+         */
+        [[nodiscard]] bool is_true_random() const {
+            return true_random;
+        }
+
         /**
          * Returns a random number
          * @return
@@ -224,6 +534,25 @@ namespace dejavu {
             return true_random?static_cast<int>(true_random_device()&INT32_MAX):
                                static_cast<int>(pseudo_random_device()&INT32_MAX);
         }
+
+        /**
+         * Stores or restores the state of the pseudo random number generator.
+         */
+        template<class A>
+        void serialize(A& ar) {
+            ar.value(true_random);
+            std::string state;
+            if constexpr (!A::reading) {
+                std::ostringstream out;
+                out << pseudo_random_device;
+                state = out.str();
+            }
+            ar.value(state);
+            if constexpr (A::reading) {
+                std::istringstream in(state);
+                in >> pseudo_random_device;
+            }
+        }
     };
 
     /**
@@ -256,6 +585,12 @@ namespace dejavu {
             exponent = set_exponent;
         }
 
+        template<class A>
+        void serialize(A& ar) {
+            ar.value(mantissa);
+            ar.value(exponent);
+        }
+
         /**
          * Multiply a \p number to this big_number.
          *